@@ -10,6 +10,7 @@
 #include "threads-model.h"
 #include "nodestack.h"
 #include "wildcard.h"
+#include "checkpoint.h"
 
 #define ACTION_INITIAL_CLOCK 0
 
@@ -19,6 +20,45 @@
 /** @brief A special value to represent a failed trylock */
 #define VALUE_TRYFAILED 0
 
+/*
+ * ModelActions are allocated for every atomic operation, but most of them are
+ * freed again as soon as the execution finds the one the NodeStack already
+ * holds from an earlier execution. So freed actions are kept on a free list,
+ * in model memory, rather than going back to the allocator each time.
+ */
+static void *action_freelist;
+static uint64_t num_actions_allocated;
+static uint64_t num_actions_reused;
+
+/** @brief Allocate a ModelAction, reusing a freed one if there is one */
+void * ModelAction::operator new(size_t size)
+{
+	ASSERT(size == sizeof(ModelAction));
+	void *p = action_freelist;
+	if (p) {
+		action_freelist = *(void **)p;
+		num_actions_reused++;
+	} else {
+		p = model_malloc(sizeof(ModelAction));
+		num_actions_allocated++;
+	}
+	return p;
+}
+
+/** @brief Free a ModelAction onto the free list */
+void ModelAction::operator delete(void *p, size_t size)
+{
+	*(void **)p = action_freelist;
+	action_freelist = p;
+}
+
+/** @brief Print statistics on the ModelAction free list */
+void ModelAction::print_pool_stats()
+{
+	model_print("ModelActions:      %" PRIu64 " allocated, %" PRIu64 " reused\n",
+			num_actions_allocated, num_actions_reused);
+}
+
 /**
  * @brief Construct a new ModelAction
  *
@@ -43,6 +83,7 @@ ModelAction::ModelAction(action_type_t type, memory_order order, void *loc,
 	last_fence_release(NULL),
 	node(NULL),
 	seq_number(ACTION_INITIAL_CLOCK),
+	state_id(0),
 	cv(NULL),
 	sleep_flag(false)
 {
@@ -53,6 +94,32 @@ ModelAction::ModelAction(action_type_t type, memory_order order, void *loc,
 	this->tid = t->get_id();
 }
 
+/**
+ * @brief Restore a ModelAction written by ModelAction::checkpoint()
+ *
+ * The action belongs to the run which wrote the checkpoint: its location and
+ * value may be addresses in that run, until it is replayed (see relocate()).
+ *
+ * @param reader The checkpoint
+ */
+ModelAction::ModelAction(CheckpointReader *reader) :
+	type((action_type)reader->get()),
+	order((memory_order)reader->get()),
+	original_order((memory_order)reader->get()),
+	location((void *)(uintptr_t)reader->get()),
+	tid(int_to_id(reader->get())),
+	value(reader->get()),
+	reads_from(NULL),
+	reads_from_promise(NULL),
+	last_fence_release(NULL),
+	node(NULL),
+	seq_number(reader->get()),
+	state_id(reader->get()),
+	cv(NULL),
+	sleep_flag(reader->get())
+{
+}
+
 /** @brief ModelAction destructor */
 ModelAction::~ModelAction()
 {
@@ -73,6 +140,49 @@ void ModelAction::copy_from_new(ModelAction *newaction)
 	seq_number = newaction->seq_number;
 }
 
+/**
+ * @brief Take the addresses of an action restored from a checkpoint from the
+ * same action in this run
+ *
+ * The user program's memory, its thread stacks and the model checker's own
+ * objects may all be mapped elsewhere in the run that resumes from a
+ * checkpoint, so the first replay of a restored action updates its location
+ * (and that of the ATOMIC_UNINIT action created with it) and, unless it is a
+ * read, its value, which may be an address too (e.g., for THREAD_CREATE).
+ *
+ * @param newaction The action just created by the program for this step
+ */
+void ModelAction::relocate(const ModelAction *newaction)
+{
+	location = newaction->location;
+	if (!newaction->is_read())
+		value = newaction->value;
+	ModelAction *uninit = node ? node->get_uninit_action() : NULL;
+	if (uninit)
+		uninit->location = location;
+}
+
+/**
+ * @brief Write this action to a checkpoint
+ *
+ * Only the fields which outlive an execution are written; the action's
+ * last_fence_release is written by its Node, as a reference.
+ *
+ * @param writer The checkpoint
+ */
+void ModelAction::checkpoint(CheckpointWriter *writer) const
+{
+	writer->put(type);
+	writer->put(order);
+	writer->put(original_order);
+	writer->put((uintptr_t)location);
+	writer->put(id_to_int(tid));
+	writer->put(value);
+	writer->put(seq_number);
+	writer->put(state_id);
+	writer->put(sleep_flag);
+}
+
 void ModelAction::set_seq_number(modelclock_t num)
 {
 	/* ATOMIC_UNINIT actions should never have non-zero clock */
@@ -532,9 +642,10 @@ bool ModelAction::happens_before(const ModelAction *act) const
 	return act->cv->synchronized_since(this);
 }
 
-const char * ModelAction::get_type_str() const
+/** @return The name of an action type */
+const char * ModelAction::get_type_str(action_type type)
 {
-	switch (this->type) {
+	switch (type) {
 		case MODEL_FIXUP_RELSEQ: return "relseq fixup";
 		case THREAD_CREATE: return "thread create";
 		case THREAD_START: return "thread start";
@@ -560,9 +671,10 @@ const char * ModelAction::get_type_str() const
 	};
 }
 
-const char * ModelAction::get_mo_str() const
+/** @return The name of a memory order */
+const char * ModelAction::get_mo_str(memory_order order)
 {
-	switch (this->order) {
+	switch (order) {
 		case std::memory_order_relaxed: return "relaxed";
 		case std::memory_order_acquire: return "acquire";
 		case std::memory_order_release: return "release";
@@ -572,6 +684,16 @@ const char * ModelAction::get_mo_str() const
 	}
 }
 
+const char * ModelAction::get_type_str() const
+{
+	return get_type_str(type);
+}
+
+const char * ModelAction::get_mo_str() const
+{
+	return get_mo_str(order);
+}
+
 /** @brief Print nicely-formatted info about this ModelAction */
 void ModelAction::print() const
 {
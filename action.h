@@ -16,6 +16,8 @@
 class ClockVector;
 class Thread;
 class Promise;
+class CheckpointWriter;
+class CheckpointReader;
 
 namespace std {
 	class mutex;
@@ -90,6 +92,7 @@ class ClockVector;
 class ModelAction {
 public:
 	ModelAction(action_type_t type, memory_order order, void *loc, uint64_t value = VALUE_NONE, Thread *thread = NULL);
+	ModelAction(CheckpointReader *reader);
 	~ModelAction();
 	void print() const;
 
@@ -98,8 +101,11 @@ public:
 	memory_order get_mo() const { return order; }
 	memory_order get_original_mo() const { return original_order; }
 	void set_mo(memory_order order) { this->order = order; }
+	void set_tid(thread_id_t id) { tid = id; }
 	void * get_location() const { return location; }
 	modelclock_t get_seq_number() const { return seq_number; }
+	uint64_t get_state_id() const { return state_id; }
+	void set_state_id(uint64_t id) { state_id = id; }
 	uint64_t get_value() const { return value; }
 	uint64_t get_reads_from_value() const;
 	uint64_t get_write_value() const;
@@ -121,6 +127,8 @@ public:
 	const ModelAction * get_last_fence_release() const { return last_fence_release; }
 
 	void copy_from_new(ModelAction *newaction);
+	void relocate(const ModelAction *newaction);
+	void checkpoint(CheckpointWriter *writer) const;
 	void set_seq_number(modelclock_t num);
 	void set_try_lock(bool obtainedlock);
 	bool is_thread_start() const;
@@ -184,7 +192,13 @@ public:
 
 	bool may_read_from(const ModelAction *write) const;
 	bool may_read_from(const Promise *promise) const;
-	MEMALLOC
+
+	void * operator new(size_t size);
+	void operator delete(void *p, size_t size);
+	static void print_pool_stats();
+
+	static const char * get_type_str(action_type type);
+	static const char * get_mo_str(memory_order order);
 private:
 
 	const char * get_type_str() const;
@@ -241,6 +255,16 @@ private:
 	 */
 	modelclock_t seq_number;
 
+	/**
+	 * @brief An identifier for this action which does not depend on the
+	 * interleaving that produced it
+	 *
+	 * Derived from the thread and the thread's history before this
+	 * action; only maintained when state pruning is enabled.
+	 * @see ModelExecution::get_state_fingerprint()
+	 */
+	uint64_t state_id;
+
 	/**
 	 * @brief The clock vector for this operation
 	 *
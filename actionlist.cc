@@ -0,0 +1,225 @@
+#include <string.h>
+
+#include "actionlist.h"
+#include "action.h"
+#include "common.h"
+
+/** @return The capacity for a block added next to a block of capacity cap */
+static unsigned int grow_capacity(unsigned int cap)
+{
+	cap = cap * 2 + 4;
+	return cap > ACTIONLIST_MAX_SLOTS ? ACTIONLIST_MAX_SLOTS : cap;
+}
+
+/** @return The size of a block with the given capacity */
+static size_t block_size(unsigned int capacity)
+{
+	return sizeof(struct action_block) + capacity * sizeof(ModelAction *);
+}
+
+/** @brief Widen a block's sequence number bounds to cover an action */
+static void note_seq(struct action_block *blk, const ModelAction *act)
+{
+	modelclock_t seq = act->get_seq_number();
+	if (seq < blk->minseq)
+		blk->minseq = seq;
+	if (seq > blk->maxseq)
+		blk->maxseq = seq;
+}
+
+/** @brief Copy constructor; the copy is packed into as few blocks as possible */
+ActionList::ActionList(const ActionList &other) :
+	head(NULL),
+	tail(NULL),
+	count(0)
+{
+	for (const_iterator it = other.begin(); it != other.end(); it++)
+		push_back(*it);
+}
+
+/** @brief Move constructor, so that vectors of lists can grow cheaply */
+ActionList::ActionList(ActionList &&other) noexcept :
+	head(other.head),
+	tail(other.tail),
+	count(other.count)
+{
+	other.head = other.tail = NULL;
+	other.count = 0;
+}
+
+ActionList::~ActionList()
+{
+	clear();
+}
+
+ActionList & ActionList::operator=(const ActionList &other)
+{
+	if (this != &other) {
+		clear();
+		for (const_iterator it = other.begin(); it != other.end(); it++)
+			push_back(*it);
+	}
+	return *this;
+}
+
+struct action_block * ActionList::new_block(unsigned int capacity)
+{
+	struct action_block *blk = (struct action_block *)arena_malloc(block_size(capacity));
+	blk->prev = blk->next = NULL;
+	blk->begin = blk->end = 0;
+	blk->capacity = capacity;
+	blk->minseq = ~(modelclock_t)0;
+	blk->maxseq = 0;
+	return blk;
+}
+
+void ActionList::free_block(struct action_block *blk)
+{
+	arena_free(blk, block_size(blk->capacity));
+}
+
+/** @brief Remove a block from the chain of blocks and free it */
+void ActionList::unlink_block(struct action_block *blk)
+{
+	if (blk->prev)
+		blk->prev->next = blk->next;
+	else
+		head = blk->next;
+	if (blk->next)
+		blk->next->prev = blk->prev;
+	else
+		tail = blk->prev;
+	free_block(blk);
+}
+
+/** @brief Append an action to the list */
+void ActionList::push_back(ModelAction *act)
+{
+	struct action_block *blk = tail;
+	if (!blk || blk->end == blk->capacity) {
+		blk = new_block(tail ? grow_capacity(tail->capacity) : ACTIONLIST_MIN_SLOTS);
+		blk->prev = tail;
+		if (tail)
+			tail->next = blk;
+		else
+			head = blk;
+		tail = blk;
+	}
+	blk->acts[blk->end++] = act;
+	note_seq(blk, act);
+	count++;
+}
+
+/** @brief Prepend an action to the list */
+void ActionList::push_front(ModelAction *act)
+{
+	struct action_block *blk = head;
+	if (!blk || blk->begin == 0) {
+		blk = new_block(head ? grow_capacity(head->capacity) : ACTIONLIST_MIN_SLOTS);
+		blk->begin = blk->end = blk->capacity;
+		blk->next = head;
+		if (head)
+			head->prev = blk;
+		else
+			tail = blk;
+		head = blk;
+	}
+	blk->acts[--blk->begin] = act;
+	note_seq(blk, act);
+	count++;
+}
+
+/** @brief Remove the last action of a non-empty list */
+void ActionList::pop_back()
+{
+	ASSERT(count > 0);
+	if (--tail->end == tail->begin)
+		unlink_block(tail);
+	count--;
+}
+
+/** @brief Remove the first action of a non-empty list */
+void ActionList::pop_front()
+{
+	ASSERT(count > 0);
+	if (++head->begin == head->end)
+		unlink_block(head);
+	count--;
+}
+
+/**
+ * @brief Remove an action from the list
+ * @param it An iterator to the action
+ * @return An iterator to the following action
+ */
+ActionList::iterator ActionList::erase(iterator it)
+{
+	struct action_block *blk = it.blk;
+	unsigned int idx = it.idx;
+	memmove(&blk->acts[idx], &blk->acts[idx + 1], (blk->end - idx - 1) * sizeof(ModelAction *));
+	blk->end--;
+	count--;
+	if (idx == blk->end) {
+		struct action_block *next = blk->next;
+		if (blk->begin == blk->end)
+			unlink_block(blk);
+		return iterator(this, next, next ? next->begin : 0);
+	}
+	return iterator(this, blk, idx);
+}
+
+/** @brief Remove every action from the list */
+void ActionList::clear()
+{
+	struct action_block *blk = head;
+	while (blk) {
+		struct action_block *next = blk->next;
+		free_block(blk);
+		blk = next;
+	}
+	head = tail = NULL;
+	count = 0;
+}
+
+/**
+ * @brief Find the last occurrence of an action, skipping any block whose
+ * sequence number bounds rule it out
+ * @param act The action to find
+ * @param idx Returns the slot of the action within the block
+ * @return The block which holds the action, or NULL if it is not in the list
+ */
+struct action_block * ActionList::find_block(const ModelAction *act, unsigned int *idx) const
+{
+	modelclock_t seq = act->get_seq_number();
+	for (struct action_block *blk = tail; blk; blk = blk->prev) {
+		if (seq < blk->minseq || seq > blk->maxseq)
+			continue;
+		for (unsigned int i = blk->end; i > blk->begin; i--) {
+			if (blk->acts[i - 1] == act) {
+				*idx = i - 1;
+				return blk;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Find the last occurrence of an action in the list
+ * @param act The action to find
+ * @return A reverse iterator to the action, or rend() if it is not in the list
+ */
+ActionList::reverse_iterator ActionList::rfind(const ModelAction *act)
+{
+	unsigned int idx = 0;
+	struct action_block *blk = find_block(act, &idx);
+	return reverse_iterator(this, blk, idx);
+}
+
+/** @copydoc ActionList::rfind(const ModelAction *) */
+ActionList::const_reverse_iterator ActionList::rfind(const ModelAction *act) const
+{
+	unsigned int idx = 0;
+	struct action_block *blk = find_block(act, &idx);
+	return const_reverse_iterator(this, blk, idx);
+}
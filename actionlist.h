@@ -0,0 +1,212 @@
+/** @file actionlist.h
+ *  @brief Chunked sequence of ModelAction pointers.
+ */
+
+#ifndef __ACTIONLIST_H__
+#define __ACTIONLIST_H__
+
+#include <cstddef>
+#include <inttypes.h>
+#include <iterator>
+
+#include "mymemory.h"
+#include "modeltypes.h"
+
+class ModelAction;
+class ActionList;
+
+/** @brief Number of slots in the first block of a list */
+#define ACTIONLIST_MIN_SLOTS 4
+/**
+ * @brief Maximum number of slots in a block; together with the header, this
+ * keeps every block within the arena's largest size class (240 bytes)
+ */
+#define ACTIONLIST_MAX_SLOTS 26
+
+/**
+ * @brief A block of contiguous action pointers
+ *
+ * The occupied slots are acts[begin, end). Blocks grow from the middle of the
+ * list outwards: a block added at the tail fills from slot 0, one added at the
+ * head fills from its last slot. minseq and maxseq bound the sequence numbers
+ * of the actions which have been stored in the block, so that a search for a
+ * particular action can skip whole blocks.
+ */
+struct action_block {
+	struct action_block *prev;
+	struct action_block *next;
+	uint16_t begin;
+	uint16_t end;
+	uint16_t capacity;
+	modelclock_t minseq;
+	modelclock_t maxseq;
+	ModelAction *acts[];
+};
+
+/**
+ * @brief Bidirectional iterator over an ActionList
+ *
+ * A forward iterator moves from head to tail and a reverse iterator from tail
+ * to head; either one is past its last element when it has no block. Ref is
+ * the reference type, which makes the difference between an iterator and a
+ * const_iterator.
+ */
+template <typename Ref, bool reverse>
+class action_list_iterator {
+public:
+	typedef std::bidirectional_iterator_tag iterator_category;
+	typedef ModelAction * value_type;
+	typedef ptrdiff_t difference_type;
+	typedef value_type * pointer;
+	typedef Ref reference;
+
+	action_list_iterator() : list(NULL), blk(NULL), idx(0) { }
+	action_list_iterator(const ActionList *list, struct action_block *blk, unsigned int idx) :
+		list(list), blk(blk), idx(idx)
+	{ }
+	/** @brief Allows conversion from an iterator to a const_iterator */
+	template <typename R>
+	action_list_iterator(const action_list_iterator<R, reverse> &it) :
+		list(it.list), blk(it.blk), idx(it.idx)
+	{ }
+
+	Ref operator*() const { return blk->acts[idx]; }
+
+	action_list_iterator & operator++() {
+		if (reverse)
+			toward_head();
+		else
+			toward_tail();
+		return *this;
+	}
+	action_list_iterator operator++(int) {
+		action_list_iterator tmp = *this;
+		++*this;
+		return tmp;
+	}
+	action_list_iterator & operator--() {
+		if (reverse)
+			toward_tail();
+		else
+			toward_head();
+		return *this;
+	}
+	action_list_iterator operator--(int) {
+		action_list_iterator tmp = *this;
+		--*this;
+		return tmp;
+	}
+
+	bool operator==(const action_list_iterator &other) const {
+		return blk == other.blk && idx == other.idx;
+	}
+	bool operator!=(const action_list_iterator &other) const {
+		return !(*this == other);
+	}
+
+private:
+	inline void toward_tail();
+	inline void toward_head();
+
+	const ActionList *list;
+	struct action_block *blk;
+	unsigned int idx;
+
+	template <typename R, bool rev> friend class action_list_iterator;
+	friend class ActionList;
+};
+
+/**
+ * @brief A sequence of ModelAction pointers, stored in linked blocks
+ *
+ * This provides the part of the std::list interface which the model checker
+ * uses, but keeps the actions in arrays of up to ACTIONLIST_MAX_SLOTS
+ * pointers, so that scanning a list (most often backwards, from the latest
+ * action) reads consecutive memory instead of chasing one node per action.
+ * The blocks are allocated from the per-execution arena.
+ *
+ * As with std::list, erasing an action invalidates only iterators to it and,
+ * here, to the actions after it in the same block.
+ */
+class ActionList {
+public:
+	typedef action_list_iterator<ModelAction *&, false> iterator;
+	typedef action_list_iterator<ModelAction * const &, false> const_iterator;
+	typedef action_list_iterator<ModelAction *&, true> reverse_iterator;
+	typedef action_list_iterator<ModelAction * const &, true> const_reverse_iterator;
+
+	ActionList() : head(NULL), tail(NULL), count(0) { }
+	ActionList(const ActionList &other);
+	ActionList(ActionList &&other) noexcept;
+	~ActionList();
+	ActionList & operator=(const ActionList &other);
+
+	iterator begin() { return iterator(this, head, head ? head->begin : 0); }
+	iterator end() { return iterator(this, NULL, 0); }
+	const_iterator begin() const { return const_iterator(this, head, head ? head->begin : 0); }
+	const_iterator end() const { return const_iterator(this, NULL, 0); }
+	reverse_iterator rbegin() { return reverse_iterator(this, tail, tail ? tail->end - 1 : 0); }
+	reverse_iterator rend() { return reverse_iterator(this, NULL, 0); }
+	const_reverse_iterator rbegin() const { return const_reverse_iterator(this, tail, tail ? tail->end - 1 : 0); }
+	const_reverse_iterator rend() const { return const_reverse_iterator(this, NULL, 0); }
+
+	size_t size() const { return count; }
+	bool empty() const { return count == 0; }
+	ModelAction * front() const { return head->acts[head->begin]; }
+	ModelAction * back() const { return tail->acts[tail->end - 1]; }
+
+	void push_back(ModelAction *act);
+	void push_front(ModelAction *act);
+	void pop_back();
+	void pop_front();
+	iterator erase(iterator it);
+	void clear();
+
+	reverse_iterator rfind(const ModelAction *act);
+	const_reverse_iterator rfind(const ModelAction *act) const;
+
+	ARENAALLOC
+private:
+	struct action_block * new_block(unsigned int capacity);
+	void free_block(struct action_block *blk);
+	void unlink_block(struct action_block *blk);
+	struct action_block * find_block(const ModelAction *act, unsigned int *idx) const;
+
+	struct action_block *head;
+	struct action_block *tail;
+	size_t count;
+
+	template <typename R, bool rev> friend class action_list_iterator;
+};
+
+/** @brief Step to the next action toward the tail (or from rend() to the head) */
+template <typename Ref, bool reverse>
+void action_list_iterator<Ref, reverse>::toward_tail()
+{
+	if (!blk) {
+		blk = list->head;
+		idx = blk->begin;
+	} else if (++idx == blk->end) {
+		blk = blk->next;
+		idx = blk ? blk->begin : 0;
+	}
+}
+
+/** @brief Step to the next action toward the head (or from end() to the tail) */
+template <typename Ref, bool reverse>
+void action_list_iterator<Ref, reverse>::toward_head()
+{
+	if (!blk) {
+		blk = list->tail;
+		idx = blk->end - 1;
+	} else if (idx == blk->begin) {
+		blk = blk->prev;
+		idx = blk ? blk->end - 1 : 0;
+	} else {
+		idx--;
+	}
+}
+
+typedef ActionList action_list_t;
+
+#endif /* __ACTIONLIST_H__ */
@@ -0,0 +1,209 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "checkpoint.h"
+#include "common.h"
+
+CheckpointWriter::CheckpointWriter() :
+	buf(),
+	num_actions(0),
+	action_refs(1024)
+{
+	buf.insert(buf.end(), CHECKPOINT_MAGIC, CHECKPOINT_MAGIC + 8);
+	put(CHECKPOINT_VERSION);
+}
+
+/** @brief Append an unsigned LEB128 varint */
+void CheckpointWriter::put(uint64_t value)
+{
+	while (value >= 0x80) {
+		buf.push_back((uint8_t)value | 0x80);
+		value >>= 7;
+	}
+	buf.push_back((uint8_t)value);
+}
+
+/** @brief Append a signed value, zigzag-encoded */
+void CheckpointWriter::put_int(int64_t value)
+{
+	put(((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/** @brief Append a string, as its length and its bytes */
+void CheckpointWriter::put_string(const char *str)
+{
+	size_t len = strlen(str);
+	put(len);
+	buf.insert(buf.end(), str, str + len);
+}
+
+/** @brief Give an action the next reference number */
+void CheckpointWriter::add_action(const ModelAction *act)
+{
+	action_refs.put(act, ++num_actions);
+}
+
+/** @brief Append a reference to a registered action, or to NULL */
+void CheckpointWriter::put_action(const ModelAction *act)
+{
+	unsigned int ref = act ? action_refs.get(act) : 0;
+	ASSERT(!act || ref);
+	put(ref);
+}
+
+/**
+ * @brief Replace a checkpoint file with the checkpoint encoded so far
+ *
+ * The checkpoint goes to a temporary file next to the old one, which is
+ * synced and then renamed over it, so a crash at any point leaves one
+ * complete checkpoint behind.
+ *
+ * @param filename The checkpoint file
+ * @return False if the checkpoint could not be written
+ */
+bool CheckpointWriter::commit(const char *filename)
+{
+	char tmpname[PATH_MAX];
+	if (snprintf(tmpname, sizeof(tmpname), "%s.tmp", filename) >= (int)sizeof(tmpname)) {
+		model_print("Checkpoint file name too long: %s\n", filename);
+		return false;
+	}
+
+	int fd = open(tmpname, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		perror(tmpname);
+		return false;
+	}
+	const uint8_t *p = &buf[0];
+	size_t left = buf.size();
+	while (left) {
+		ssize_t n = write(fd, p, left);
+		if (n < 0) {
+			perror(tmpname);
+			close(fd);
+			unlink(tmpname);
+			return false;
+		}
+		p += n;
+		left -= n;
+	}
+	if (fsync(fd) || close(fd) || rename(tmpname, filename)) {
+		perror(filename);
+		unlink(tmpname);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Read a checkpoint file and check its header
+ * @param filename The checkpoint file
+ */
+CheckpointReader::CheckpointReader(const char *filename) :
+	data(NULL),
+	pos(NULL),
+	end(NULL),
+	error(true),
+	actions()
+{
+	int fd = open(filename, O_RDONLY);
+	struct stat st;
+	if (fd < 0 || fstat(fd, &st)) {
+		perror(filename);
+		if (fd >= 0)
+			close(fd);
+		return;
+	}
+	data = (uint8_t *)model_malloc(st.st_size + 1);
+	size_t len = 0;
+	ssize_t n;
+	while (len < (size_t)st.st_size && (n = read(fd, data + len, st.st_size - len)) > 0)
+		len += n;
+	close(fd);
+
+	pos = data;
+	end = data + len;
+	if (len < 8 || memcmp(data, CHECKPOINT_MAGIC, 8)) {
+		model_print("%s is not a checkpoint file\n", filename);
+		return;
+	}
+	pos += 8;
+	error = false;
+	if (get() != CHECKPOINT_VERSION) {
+		model_print("%s was written by a different version of the model checker\n", filename);
+		error = true;
+	}
+}
+
+CheckpointReader::~CheckpointReader()
+{
+	if (data)
+		model_free(data);
+}
+
+/** @return The next unsigned varint */
+uint64_t CheckpointReader::get()
+{
+	uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (pos == end) {
+			error = true;
+			return 0;
+		}
+		uint8_t byte = *pos++;
+		value |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return value;
+	}
+	error = true;
+	return 0;
+}
+
+/** @return The next signed, zigzag-encoded value */
+int64_t CheckpointReader::get_int()
+{
+	uint64_t value = get();
+	return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/**
+ * @return The next string, in a copy which the caller frees with
+ * model_free()
+ */
+char * CheckpointReader::get_string()
+{
+	uint64_t len = get();
+	if (len > (uint64_t)(end - pos)) {
+		error = true;
+		len = 0;
+	}
+	char *str = (char *)model_malloc(len + 1);
+	if (len) {
+		memcpy(str, pos, len);
+		pos += len;
+	}
+	str[len] = '\0';
+	return str;
+}
+
+/** @brief Give a restored action the next reference number */
+void CheckpointReader::add_action(ModelAction *act)
+{
+	actions.push_back(act);
+}
+
+/** @return The next action reference, resolved */
+ModelAction * CheckpointReader::get_action()
+{
+	uint64_t ref = get();
+	if (ref > actions.size()) {
+		error = true;
+		return NULL;
+	}
+	return ref ? actions[ref - 1] : NULL;
+}
@@ -0,0 +1,81 @@
+/** @file checkpoint.h
+ *  @brief Saving and restoring the exploration frontier of a run.
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <inttypes.h>
+
+#include "mymemory.h"
+#include "stl-model.h"
+#include "swisstable.h"
+
+class ModelAction;
+
+/** @brief The first eight bytes of a checkpoint file */
+#define CHECKPOINT_MAGIC "C11CHKPT"
+#define CHECKPOINT_VERSION 2
+
+/**
+ * @brief Encodes a checkpoint and writes it to a file
+ *
+ * A checkpoint is the magic string and version followed by a stream of
+ * unsigned LEB128 varints (signed fields are zigzag-encoded first). The
+ * model checker, the NodeStack and the analysis plugins each append their
+ * own fields; see ModelChecker::write_checkpoint() for the layout.
+ *
+ * ModelActions are written by reference: every action that the NodeStack
+ * holds is registered with add_action() before anything refers to it, and a
+ * reference is then 1 + the order of registration, or 0 for NULL.
+ */
+class CheckpointWriter {
+public:
+	CheckpointWriter();
+
+	void put(uint64_t value);
+	void put_int(int64_t value);
+	void put_string(const char *str);
+	void add_action(const ModelAction *act);
+	void put_action(const ModelAction *act);
+
+	bool commit(const char *filename);
+
+	MEMALLOC
+private:
+	ModelVector<uint8_t> buf;
+	unsigned int num_actions;
+	SwissTable<const ModelAction *, unsigned int, uintptr_t, 4, model_malloc, model_calloc, model_free> action_refs;
+};
+
+/**
+ * @brief Decodes a checkpoint written by CheckpointWriter
+ *
+ * A truncated or malformed file does not stop the reader: every read past
+ * the end returns 0 and marks the reader failed, which the caller checks
+ * once it is done.
+ */
+class CheckpointReader {
+public:
+	CheckpointReader(const char *filename);
+	~CheckpointReader();
+
+	bool failed() const { return error; }
+	bool at_end() const { return pos == end; }
+
+	uint64_t get();
+	int64_t get_int();
+	char * get_string();
+	void add_action(ModelAction *act);
+	ModelAction * get_action();
+
+	MEMALLOC
+private:
+	uint8_t *data;
+	const uint8_t *pos;
+	const uint8_t *end;
+	bool error;
+	ModelVector<ModelAction *> actions;
+};
+
+#endif /* __CHECKPOINT_H__ */
@@ -6,10 +6,181 @@
 #include "common.h"
 #include "threads-model.h"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CV_X86_KERNELS 1
+#endif
+
+/**
+ * @brief A reference-counted block of clocks
+ *
+ * The clocks come first so that they share the block's alignment.
+ */
+struct cv_block {
+	modelclock_t clock[CV_BLOCK_CLOCKS];
+	unsigned int refcount;
+};
+
+/** @brief A block of zeros, for comparing against absent (NULL) blocks */
+static const modelclock_t zero_clocks[CV_BLOCK_CLOCKS] __attribute__((aligned(CV_BLOCK_CLOCKS * sizeof(modelclock_t)))) = { 0 };
+
+/** @brief The number of blocks needed to hold a number of threads */
+static int cv_num_blocks(int threads)
+{
+	return (threads + CV_BLOCK_CLOCKS - 1) / CV_BLOCK_CLOCKS;
+}
+
+/** @brief Allocate a block; its clocks are left to the caller to fill */
+static struct cv_block * block_alloc()
+{
+	struct cv_block *b = (struct cv_block *)arena_malloc(sizeof(struct cv_block));
+	ASSERT(((uintptr_t)b->clock & (CV_BLOCK_CLOCKS * sizeof(modelclock_t) - 1)) == 0);
+	b->refcount = 1;
+	return b;
+}
+
+static struct cv_block * block_ref(struct cv_block *b)
+{
+	if (b)
+		b->refcount++;
+	return b;
+}
+
+static void block_unref(struct cv_block *b)
+{
+	if (b && --b->refcount == 0)
+		arena_free(b, sizeof(struct cv_block));
+}
+
+/** @return The clocks in a block, treating NULL as a block of zeros */
+static const modelclock_t * block_clocks(const struct cv_block *b)
+{
+	return b ? b->clock : zero_clocks;
+}
+
+/*
+ * Kernels over whole blocks of clocks. Each takes two block-aligned arrays
+ * and a length n which is a multiple of CV_BLOCK_CLOCKS.
+ *
+ * merge: dst[i] = max(dst[i], src[i]); returns true if any dst[i] changed
+ * dominates: returns true if a[i] >= b[i] for every i
+ */
+
+static bool merge_scalar(modelclock_t *dst, const modelclock_t *src, int n)
+{
+	bool changed = false;
+	for (int i = 0; i < n; i++)
+		if (src[i] > dst[i]) {
+			dst[i] = src[i];
+			changed = true;
+		}
+	return changed;
+}
+
+static bool dominates_scalar(const modelclock_t *a, const modelclock_t *b, int n)
+{
+	for (int i = 0; i < n; i++)
+		if (b[i] > a[i])
+			return false;
+	return true;
+}
+
+#ifdef CV_X86_KERNELS
+__attribute__((target("sse4.1")))
+static bool merge_sse4(modelclock_t *dst, const modelclock_t *src, int n)
+{
+	__m128i diff = _mm_setzero_si128();
+	for (int i = 0; i < n; i += 4) {
+		__m128i a = _mm_load_si128((const __m128i *)(dst + i));
+		__m128i b = _mm_load_si128((const __m128i *)(src + i));
+		__m128i m = _mm_max_epu32(a, b);
+		diff = _mm_or_si128(diff, _mm_xor_si128(m, a));
+		_mm_store_si128((__m128i *)(dst + i), m);
+	}
+	return !_mm_testz_si128(diff, diff);
+}
+
+__attribute__((target("sse4.1")))
+static bool dominates_sse4(const modelclock_t *a, const modelclock_t *b, int n)
+{
+	__m128i diff = _mm_setzero_si128();
+	for (int i = 0; i < n; i += 4) {
+		__m128i x = _mm_load_si128((const __m128i *)(a + i));
+		__m128i y = _mm_load_si128((const __m128i *)(b + i));
+		diff = _mm_or_si128(diff, _mm_xor_si128(_mm_max_epu32(x, y), x));
+	}
+	return _mm_testz_si128(diff, diff);
+}
+
+__attribute__((target("avx2")))
+static bool merge_avx2(modelclock_t *dst, const modelclock_t *src, int n)
+{
+	__m256i diff = _mm256_setzero_si256();
+	for (int i = 0; i < n; i += 8) {
+		__m256i a = _mm256_load_si256((const __m256i *)(dst + i));
+		__m256i b = _mm256_load_si256((const __m256i *)(src + i));
+		__m256i m = _mm256_max_epu32(a, b);
+		diff = _mm256_or_si256(diff, _mm256_xor_si256(m, a));
+		_mm256_store_si256((__m256i *)(dst + i), m);
+	}
+	return !_mm256_testz_si256(diff, diff);
+}
+
+__attribute__((target("avx2")))
+static bool dominates_avx2(const modelclock_t *a, const modelclock_t *b, int n)
+{
+	__m256i diff = _mm256_setzero_si256();
+	for (int i = 0; i < n; i += 8) {
+		__m256i x = _mm256_load_si256((const __m256i *)(a + i));
+		__m256i y = _mm256_load_si256((const __m256i *)(b + i));
+		diff = _mm256_or_si256(diff, _mm256_xor_si256(_mm256_max_epu32(x, y), x));
+	}
+	return _mm256_testz_si256(diff, diff);
+}
+#endif /* CV_X86_KERNELS */
+
+static bool merge_select(modelclock_t *dst, const modelclock_t *src, int n);
+static bool dominates_select(const modelclock_t *a, const modelclock_t *b, int n);
+
+/** @brief The merge kernel for this CPU; chosen on first use */
+static bool (*merge_kernel)(modelclock_t *, const modelclock_t *, int) = merge_select;
+/** @brief The dominance kernel for this CPU; chosen on first use */
+static bool (*dominates_kernel)(const modelclock_t *, const modelclock_t *, int) = dominates_select;
+
+/** @brief Pick the widest kernels the CPU supports */
+static void select_kernels()
+{
+	merge_kernel = merge_scalar;
+	dominates_kernel = dominates_scalar;
+#ifdef CV_X86_KERNELS
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		merge_kernel = merge_avx2;
+		dominates_kernel = dominates_avx2;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		merge_kernel = merge_sse4;
+		dominates_kernel = dominates_sse4;
+	}
+#endif
+}
+
+static bool merge_select(modelclock_t *dst, const modelclock_t *src, int n)
+{
+	select_kernels();
+	return merge_kernel(dst, src, n);
+}
+
+static bool dominates_select(const modelclock_t *a, const modelclock_t *b, int n)
+{
+	select_kernels();
+	return dominates_kernel(a, b, n);
+}
+
 /**
  * Constructs a new ClockVector, given a parent ClockVector and a first
  * ModelAction. This constructor can assign appropriate default settings if no
- * parent and/or action is supplied.
+ * parent and/or action is supplied. The new vector shares all of the parent's
+ * blocks, except the one holding @a act's clock.
  * @param parent is the previous ClockVector to inherit (i.e., clock from the
  * same thread or the parent that created this thread)
  * @param act is an action with which to update the ClockVector
@@ -21,45 +192,124 @@ ClockVector::ClockVector(ClockVector *parent, ModelAction *act)
 	if (parent && parent->num_threads > num_threads)
 		num_threads = parent->num_threads;
 
-	clock = (modelclock_t *)snapshot_calloc(num_threads, sizeof(int));
-	if (parent)
-		std::memcpy(clock, parent->clock, parent->num_threads * sizeof(modelclock_t));
+	num_blocks = cv_num_blocks(num_threads);
+	if (num_blocks == 1)
+		blocks = &first_block;
+	else
+		blocks = (struct cv_block **)arena_malloc(num_blocks * sizeof(struct cv_block *));
+	int inherited = parent ? parent->num_blocks : 0;
+	for (int i = 0; i < inherited; i++)
+		blocks[i] = block_ref(parent->blocks[i]);
+	for (int i = inherited; i < num_blocks; i++)
+		blocks[i] = NULL;
 
-	clock[id_to_int(act->get_tid())] = act->get_seq_number();
+	int tid = id_to_int(act->get_tid());
+	writable_block(tid / CV_BLOCK_CLOCKS)->clock[tid % CV_BLOCK_CLOCKS] = act->get_seq_number();
 }
 
 /** @brief Destructor */
 ClockVector::~ClockVector()
 {
-	snapshot_free(clock);
+	for (int i = 0; i < num_blocks; i++)
+		block_unref(blocks[i]);
+	if (blocks != &first_block)
+		arena_free(blocks, num_blocks * sizeof(struct cv_block *));
+}
+
+/**
+ * @brief Get block @a i for writing, copying it first if it is shared
+ * @return The block, which is referenced only by this vector
+ */
+struct cv_block * ClockVector::writable_block(int i)
+{
+	struct cv_block *b = blocks[i];
+	if (b && b->refcount == 1)
+		return b;
+
+	struct cv_block *copy = block_alloc();
+	std::memcpy(copy->clock, block_clocks(b), sizeof(copy->clock));
+	block_unref(b);
+	blocks[i] = copy;
+	return copy;
+}
+
+/**
+ * @brief Extend this vector to record at least @a threads threads
+ *
+ * The new clocks are zero. The table is only reallocated when the new length
+ * crosses a block boundary.
+ */
+void ClockVector::grow(int threads)
+{
+	int newblocks = cv_num_blocks(threads);
+	if (newblocks > num_blocks) {
+		struct cv_block **table = (struct cv_block **)arena_malloc(newblocks * sizeof(struct cv_block *));
+		std::memcpy(table, blocks, num_blocks * sizeof(struct cv_block *));
+		for (int i = num_blocks; i < newblocks; i++)
+			table[i] = NULL;
+		if (blocks != &first_block)
+			arena_free(blocks, num_blocks * sizeof(struct cv_block *));
+		blocks = table;
+		num_blocks = newblocks;
+	}
+	num_threads = threads;
 }
 
 /**
  * Merge a clock vector into this vector, using a pairwise comparison. The
  * resulting vector length will be the maximum length of the two being merged.
+ * Blocks which the two vectors share are skipped, and where @a cv's block
+ * dominates ours we share it rather than copying it.
  * @param cv is the ClockVector being merged into this vector.
+ * @return True if any clock in this vector changed
  */
 bool ClockVector::merge(const ClockVector *cv)
 {
 	ASSERT(cv != NULL);
-	bool changed = false;
-	if (cv->num_threads > num_threads) {
-		clock = (modelclock_t *)snapshot_realloc(clock, cv->num_threads * sizeof(modelclock_t));
-		for (int i = num_threads; i < cv->num_threads; i++)
-			clock[i] = 0;
-		num_threads = cv->num_threads;
-	}
+	if (cv->num_threads > num_threads)
+		grow(cv->num_threads);
 
-	/* Element-wise maximum */
-	for (int i = 0; i < cv->num_threads; i++)
-		if (cv->clock[i] > clock[i]) {
-			clock[i] = cv->clock[i];
-			changed = true;
+	bool changed = false;
+	for (int i = 0; i < cv->num_blocks; i++) {
+		struct cv_block *src = cv->blocks[i];
+		struct cv_block *dst = blocks[i];
+		if (src == dst || src == NULL)
+			continue;
+		if (dominates_kernel(block_clocks(dst), src->clock, CV_BLOCK_CLOCKS))
+			continue;
+		changed = true;
+		if (dominates_kernel(src->clock, block_clocks(dst), CV_BLOCK_CLOCKS)) {
+			blocks[i] = block_ref(src);
+			block_unref(dst);
+		} else {
+			merge_kernel(writable_block(i)->clock, src->clock, CV_BLOCK_CLOCKS);
 		}
-	
+	}
 	return changed;
 }
 
+/**
+ * Check whether this vector dominates another; that is, whether every clock
+ * in @a cv is less than or equal to the corresponding clock here. If so, every
+ * action which happens before @a cv's action also happens before this one's,
+ * and merging @a cv in would change nothing.
+ * @param cv The ClockVector to compare against
+ * @return True if this vector dominates @a cv
+ */
+bool ClockVector::dominates(const ClockVector *cv) const
+{
+	ASSERT(cv != NULL);
+	for (int i = 0; i < cv->num_blocks; i++) {
+		const struct cv_block *b = cv->blocks[i];
+		const struct cv_block *mine = i < num_blocks ? blocks[i] : NULL;
+		if (b == mine || b == NULL)
+			continue;
+		if (!dominates_kernel(block_clocks(mine), b->clock, CV_BLOCK_CLOCKS))
+			return false;
+	}
+	return true;
+}
+
 /**
  * Check whether this vector's thread has synchronized with another action's
  * thread. This effectively checks the happens-before relation (or actually,
@@ -77,7 +327,7 @@ bool ClockVector::synchronized_since(const ModelAction *act) const
 	int i = id_to_int(act->get_tid());
 
 	if (i < num_threads)
-		return act->get_seq_number() <= clock[i];
+		return act->get_seq_number() <= block_clocks(blocks[i / CV_BLOCK_CLOCKS])[i % CV_BLOCK_CLOCKS];
 	return false;
 }
 
@@ -86,7 +336,7 @@ modelclock_t ClockVector::getClock(thread_id_t thread) {
 	int threadid = id_to_int(thread);
 
 	if (threadid < num_threads)
-		return clock[threadid];
+		return block_clocks(blocks[threadid / CV_BLOCK_CLOCKS])[threadid % CV_BLOCK_CLOCKS];
 	else
 		return 0;
 }
@@ -97,5 +347,6 @@ void ClockVector::print() const
 	int i;
 	model_print("(");
 	for (i = 0; i < num_threads; i++)
-		model_print("%2u%s", clock[i], (i == num_threads - 1) ? ")\n" : ", ");
+		model_print("%2u%s", block_clocks(blocks[i / CV_BLOCK_CLOCKS])[i % CV_BLOCK_CLOCKS],
+				(i == num_threads - 1) ? ")\n" : ", ");
 }
@@ -10,24 +10,57 @@
 
 /* Forward declaration */
 class ModelAction;
+struct cv_block;
 
+/**
+ * @brief The number of clocks in one block of a ClockVector
+ *
+ * Blocks are aligned and zero-padded (32 bytes of clocks), so that the merge
+ * and comparison kernels can work a full vector register at a time without
+ * any remainder handling.
+ */
+#define CV_BLOCK_CLOCKS 8
+
+/**
+ * @brief A vector clock, stored as a table of shared, copy-on-write blocks
+ *
+ * Each block holds CV_BLOCK_CLOCKS consecutive clocks and is reference
+ * counted, so a ClockVector built from a parent shares every block the
+ * parent has except the one holding its own thread's clock, and a merge
+ * adopts the other vector's block outright whenever that block dominates
+ * ours. A block is only copied when it is written while shared. A NULL
+ * entry in the table stands for a block of zeros.
+ */
 class ClockVector {
 public:
 	ClockVector(ClockVector *parent = NULL, ModelAction *act = NULL);
 	~ClockVector();
 	bool merge(const ClockVector *cv);
+	bool dominates(const ClockVector *cv) const;
 	bool synchronized_since(const ModelAction *act) const;
 
 	void print() const;
 	modelclock_t getClock(thread_id_t thread);
 
-	SNAPSHOTALLOC
+	ARENAALLOC
 private:
-	/** @brief Holds the actual clock data, as an array. */
-	modelclock_t *clock;
+	void grow(int threads);
+	struct cv_block * writable_block(int i);
 
-	/** @brief The number of threads recorded in clock (i.e., its length).  */
+	/**
+	 * @brief Holds the actual clock data, as a table of num_blocks blocks.
+	 * Clocks from num_threads up to the end of the last block are zero.
+	 */
+	struct cv_block **blocks;
+
+	/** @brief Storage for the table when it holds only one block */
+	struct cv_block *first_block;
+
+	/** @brief The number of threads recorded (i.e., the vector's length) */
 	int num_threads;
+
+	/** @brief The length of the blocks table */
+	int num_blocks;
 };
 
 #endif /* __CLOCKVECTOR_H__ */
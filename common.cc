@@ -57,7 +57,7 @@ void model_assert(bool expr, const char *file, int line)
 
 #ifndef CONFIG_DEBUG
 
-static int fd_user_out; /**< @brief File descriptor from which to read user program output */
+static int fd_user_out = -1; /**< @brief File descriptor from which to read user program output */
 
 /**
  * @brief Setup output redirecting
@@ -88,6 +88,21 @@ void redirect_output()
 		exit(EXIT_FAILURE);
 	}
 
+	redirect_program_output();
+}
+
+/**
+ * @brief Connect the user program's stdout to a fresh pipe
+ *
+ * Any previously-redirected pipe is closed first. Besides the initial setup
+ * in redirect_output(), this is used by forked exploration workers so that
+ * they do not share (and steal from) their parent's program output pipe.
+ */
+void redirect_program_output()
+{
+	if (fd_user_out >= 0)
+		close(fd_user_out);
+
 	/* Redirect program output to a pipe */
 	int pipefd[2];
 	if (pipe(pipefd) < 0) {
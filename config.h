@@ -19,6 +19,10 @@
  *  printed summary.*/
 #define SUPPORT_MOD_ORDER_DUMP 0
 
+/** Turn on recording every SwissTable operation to the file named by the
+ *  SWISSTABLE_TRACE environment variable, for replay by test/hashbench. */
+/*		#define CONFIG_SWISSTABLE_TRACE */
+
 /** Do we have a 48 bit virtual address (64 bit machine) or 32 bit addresses.
  * Set to 1 for 48-bit, 0 for 32-bit. */
 #ifndef BIT48
@@ -32,10 +36,16 @@
 /** Snapshotting configurables */
 
 /** 
+ * If USE_MPROTECT_SNAPSHOT=4, then snapshot by sealing the snapshotted
+ * regions into memfds mapped copy-on-write, and roll back with madvise()
+ * If USE_MPROTECT_SNAPSHOT=3, then snapshot by tracking dirty pages with
+ * asynchronous userfaultfd write-protection (Linux 6.7 or later)
  * If USE_MPROTECT_SNAPSHOT=2, then snapshot by tuned mmap() algorithm
  * If USE_MPROTECT_SNAPSHOT=1, then snapshot by using mmap() and mprotect()
  * If USE_MPROTECT_SNAPSHOT=0, then snapshot by using fork() */
+#ifndef USE_MPROTECT_SNAPSHOT
 #define USE_MPROTECT_SNAPSHOT 2
+#endif
 
 /** Size of signal stack */
 #define SIGSTACKSIZE 65536
@@ -48,9 +58,73 @@
 /* Size of stack to allocate for a thread. */
 #define STACK_SIZE (1024 * 1024)
 
+/** Number of thread IDs whose stacks are kept in the stack pool, which
+ *  persists across executions (see stack_pool_get()). Threads with larger
+ *  IDs get a stack from the snapshotting heap. */
+#define STACK_POOL_THREADS 256
+
+/** Size of the inaccessible guard region below each pooled stack */
+#define STACK_GUARD_SIZE PAGESIZE
+
+/** If WIDE_SHADOW=1, the data race detector keeps two 64-bit words of shadow
+ *  memory per byte, which hold 16-bit thread IDs and 48-bit clocks inline.
+ *  If WIDE_SHADOW=0, it keeps one word, which only holds 8-bit thread IDs
+ *  and 23-bit clocks; larger values need a separately allocated record. */
+#ifndef WIDE_SHADOW
+#define WIDE_SHADOW 0
+#endif
+
+/** If ADAPTIVE_SHADOW=1, the data race detector starts each 64 KiB region
+ *  with one shadow word per aligned 8 bytes, and only falls back to 4-byte
+ *  and then byte granularity once the region sees an access which needs
+ *  it. If ADAPTIVE_SHADOW=0, every region has one shadow word per byte. */
+#ifndef ADAPTIVE_SHADOW
+#define ADAPTIVE_SHADOW 1
+#endif
+
 /** How many shadow tables of memory to preallocate for data race detector. */
 #define SHADOWBASETABLES 4
 
+/** Number of entries in each thread's cache of shadow base tables used by
+ *  the data race detector; must be a power of two. */
+#define SHADOW_CACHE_ENTRIES 8
+
+/** Size of the address space reserved for the per-execution arena, which
+ *  holds clock vectors and action lists (see arena_malloc()). Pages are
+ *  only committed as they are used. */
+#define ARENA_SIZE (1UL << 30)
+
+/** Size of the address space reserved for mapping the binary trace file
+ *  (see --trace), which bounds the size of the file. */
+#define TRACE_MAX_SIZE (1UL << 36)
+
+/** The binary trace file is extended in steps of this many bytes. */
+#define TRACE_GROW_SIZE (16UL << 20)
+
+/** Size of the address space reserved for the node spill file (see
+ *  --spill), which bounds the memory the NodeStack can hold. The file is
+ *  sparse, so only the space actually used reaches the disk. */
+#define SPILL_FILE_SIZE (1UL << 36)
+
+/** When spilling, the Nodes this close to the head of the NodeStack are
+ *  never paged out. */
+#define SPILL_HOT_NODES 4096
+
+/** When spilling, resident memory is checked after this many new Nodes,
+ *  as well as at the end of each execution. */
+#define SPILL_CHECK_INTERVAL 4096
+
+/** Default number of seconds between checkpoints (see --checkpoint). */
+#define CHECKPOINT_INTERVAL 300
+
+/** At most this many distinct bug reports are carried over from one
+ *  checkpointed run to the run that resumes it. */
+#define CHECKPOINT_MAX_BUGS 256
+
+/** A state explored with -P is only cached if at most this many distinct
+ *  visible operations were reached below it. */
+#define STATE_SUMMARY_MAX 256
+
 /** Enable debugging assertions (via ASSERT()) */
 #define CONFIG_ASSERT
 
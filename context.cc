@@ -1,3 +1,5 @@
+#include <stdint.h>
+
 #include "context.h"
 
 #ifdef MAC
@@ -25,3 +27,183 @@ int model_swapcontext(ucontext_t *oucp, ucontext_t *ucp)
 }
 
 #endif /* MAC */
+
+#if FAST_CONTEXT_SWITCH
+
+/**
+ * The first code run by a new context. model_makecontext() arranges for the
+ * function to call and the context to link to to be in callee-saved
+ * registers; if the function returns, the link context is restored just as
+ * if model_context_switch() had switched to it.
+ */
+extern "C" void model_context_start();
+
+#if defined(__x86_64__)
+
+/*
+ * A suspended context's stack holds, from its saved stack pointer up: MXCSR
+ * and the x87 control word (8 bytes), r15, r14, r13, r12, rbx, rbp, and the
+ * return address.
+ */
+asm(
+"	.text\n"
+"	.globl model_context_switch\n"
+"	.hidden model_context_switch\n"
+"	.type model_context_switch, @function\n"
+"model_context_switch:\n"
+"	pushq %rbp\n"
+"	pushq %rbx\n"
+"	pushq %r12\n"
+"	pushq %r13\n"
+"	pushq %r14\n"
+"	pushq %r15\n"
+"	subq $8, %rsp\n"
+"	stmxcsr (%rsp)\n"
+"	fnstcw 4(%rsp)\n"
+"	movq %rsp, (%rdi)\n"
+"	movq %rsi, %rsp\n"
+".Lmodel_context_restore:\n"
+"	ldmxcsr (%rsp)\n"
+"	fldcw 4(%rsp)\n"
+"	addq $8, %rsp\n"
+"	popq %r15\n"
+"	popq %r14\n"
+"	popq %r13\n"
+"	popq %r12\n"
+"	popq %rbx\n"
+"	popq %rbp\n"
+"	ret\n"
+"	.size model_context_switch, .-model_context_switch\n"
+"\n"
+"	.globl model_context_start\n"
+"	.hidden model_context_start\n"
+"	.type model_context_start, @function\n"
+"model_context_start:\n"
+"	.cfi_startproc\n"
+"	.cfi_undefined %rip\n"
+"	callq *%r12\n"
+"	testq %r13, %r13\n"
+"	jz 1f\n"
+"	movq (%r13), %rsp\n"
+"	jmp .Lmodel_context_restore\n"
+"1:	ud2\n"
+"	.cfi_endproc\n"
+"	.size model_context_start, .-model_context_start\n"
+);
+
+int model_makecontext(model_context_t *ctx, void *stack, size_t size, void (*func)(), model_context_t *link)
+{
+	uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+	uint64_t *frame = (uint64_t *)top - 8;
+
+	/* Default MXCSR and x87 control word */
+	frame[0] = 0x1f80 | ((uint64_t)0x37f << 32);
+	frame[1] = 0;				/* r15 */
+	frame[2] = 0;				/* r14 */
+	frame[3] = (uintptr_t)link;		/* r13 */
+	frame[4] = (uintptr_t)func;		/* r12 */
+	frame[5] = 0;				/* rbx */
+	frame[6] = 0;				/* rbp */
+	/* The return address; it sits where a call would have put it, so
+	 * model_context_start() starts with a 16-byte aligned stack */
+	frame[7] = (uintptr_t)&model_context_start;
+	ctx->sp = frame;
+	return 0;
+}
+
+#elif defined(__aarch64__)
+
+/*
+ * A suspended context's stack holds, from its saved stack pointer up:
+ * x19-x30 (x30 being the return address), d8-d15, FPCR and 8 bytes of
+ * padding.
+ */
+asm(
+"	.text\n"
+"	.globl model_context_switch\n"
+"	.hidden model_context_switch\n"
+"	.type model_context_switch, %function\n"
+"model_context_switch:\n"
+"	sub sp, sp, #176\n"
+"	stp x19, x20, [sp, #0]\n"
+"	stp x21, x22, [sp, #16]\n"
+"	stp x23, x24, [sp, #32]\n"
+"	stp x25, x26, [sp, #48]\n"
+"	stp x27, x28, [sp, #64]\n"
+"	stp x29, x30, [sp, #80]\n"
+"	stp d8, d9, [sp, #96]\n"
+"	stp d10, d11, [sp, #112]\n"
+"	stp d12, d13, [sp, #128]\n"
+"	stp d14, d15, [sp, #144]\n"
+"	mrs x9, fpcr\n"
+"	str x9, [sp, #160]\n"
+"	mov x9, sp\n"
+"	str x9, [x0]\n"
+"	mov sp, x1\n"
+".Lmodel_context_restore:\n"
+"	ldr x9, [sp, #160]\n"
+"	msr fpcr, x9\n"
+"	ldp x19, x20, [sp, #0]\n"
+"	ldp x21, x22, [sp, #16]\n"
+"	ldp x23, x24, [sp, #32]\n"
+"	ldp x25, x26, [sp, #48]\n"
+"	ldp x27, x28, [sp, #64]\n"
+"	ldp x29, x30, [sp, #80]\n"
+"	ldp d8, d9, [sp, #96]\n"
+"	ldp d10, d11, [sp, #112]\n"
+"	ldp d12, d13, [sp, #128]\n"
+"	ldp d14, d15, [sp, #144]\n"
+"	add sp, sp, #176\n"
+"	ret\n"
+"	.size model_context_switch, .-model_context_switch\n"
+"\n"
+"	.globl model_context_start\n"
+"	.hidden model_context_start\n"
+"	.type model_context_start, %function\n"
+"model_context_start:\n"
+"	.cfi_startproc\n"
+"	.cfi_undefined x30\n"
+"	blr x19\n"
+"	cbz x20, 1f\n"
+"	ldr x9, [x20]\n"
+"	mov sp, x9\n"
+"	b .Lmodel_context_restore\n"
+"1:	brk #0\n"
+"	.cfi_endproc\n"
+"	.size model_context_start, .-model_context_start\n"
+);
+
+int model_makecontext(model_context_t *ctx, void *stack, size_t size, void (*func)(), model_context_t *link)
+{
+	uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+	uint64_t *frame = (uint64_t *)top - 22;
+
+	for (int i = 0; i < 22; i++)
+		frame[i] = 0;
+	frame[0] = (uintptr_t)func;		/* x19 */
+	frame[1] = (uintptr_t)link;		/* x20 */
+	frame[11] = (uintptr_t)&model_context_start;	/* x30 */
+	ctx->sp = frame;
+	return 0;
+}
+
+#else
+#error "FAST_CONTEXT_SWITCH is not supported on this architecture"
+#endif
+
+#else /* !FAST_CONTEXT_SWITCH */
+
+int model_makecontext(model_context_t *ctx, void *stack, size_t size, void (*func)(), model_context_t *link)
+{
+	int ret = getcontext(ctx);
+	if (ret)
+		return ret;
+	ctx->uc_stack.ss_sp = stack;
+	ctx->uc_stack.ss_size = size;
+	ctx->uc_stack.ss_flags = 0;
+	ctx->uc_link = link;
+	makecontext(ctx, func, 0);
+	return 0;
+}
+
+#endif /* !FAST_CONTEXT_SWITCH */
@@ -1,15 +1,25 @@
+#include <algorithm>
+#include <limits.h>
+
 #include "cyclegraph.h"
 #include "action.h"
 #include "common.h"
 #include "promise.h"
 #include "threads-model.h"
+#include "statecache.h"
 
 /** Initializes a CycleGraph object. */
 CycleGraph::CycleGraph() :
-	discovered(new HashTable<const CycleNode *, const CycleNode *, uintptr_t, 4, model_malloc, model_calloc, model_free>(16)),
+	discovered(new SwissTable<const CycleNode *, const CycleNode *, uintptr_t, 4, model_malloc, model_calloc, model_free>(16)),
 	queue(new ModelVector<const CycleNode *>()),
+	affected(new ModelVector<CycleNode *>()),
+	orders(new ModelVector<unsigned int>()),
 	hasCycles(false),
-	oldCycles(false)
+	oldCycles(false),
+	nextOrder(0),
+	orderValid(true),
+	hasPromises(false),
+	edgeHash(0)
 {
 }
 
@@ -17,6 +27,8 @@ CycleGraph::CycleGraph() :
 CycleGraph::~CycleGraph()
 {
 	delete queue;
+	delete affected;
+	delete orders;
 	delete discovered;
 }
 
@@ -28,9 +40,7 @@ CycleGraph::~CycleGraph()
 void CycleGraph::putNode(const ModelAction *act, CycleNode *node)
 {
 	actionToNode.put(act, node);
-#if SUPPORT_MOD_ORDER_DUMP
 	nodeList.push_back(node);
-#endif
 }
 
 /**
@@ -41,9 +51,7 @@ void CycleGraph::putNode(const ModelAction *act, CycleNode *node)
 void CycleGraph::putNode(const Promise *promise, CycleNode *node)
 {
 	promiseToNode.put(promise, node);
-#if SUPPORT_MOD_ORDER_DUMP
 	nodeList.push_back(node);
-#endif
 }
 
 /**
@@ -52,8 +60,6 @@ void CycleGraph::putNode(const Promise *promise, CycleNode *node)
  */
 void CycleGraph::erasePromiseNode(const Promise *promise)
 {
-	promiseToNode.put(promise, NULL);
-#if SUPPORT_MOD_ORDER_DUMP
 	/* Remove the promise node from nodeList */
 	CycleNode *node = getNode_noCreate(promise);
 	for (unsigned int i = 0; i < nodeList.size(); )
@@ -61,7 +67,7 @@ void CycleGraph::erasePromiseNode(const Promise *promise)
 			nodeList.erase(nodeList.begin() + i);
 		else
 			i++;
-#endif
+	promiseToNode.put(promise, NULL);
 }
 
 /** @return The corresponding CycleNode, if exists; otherwise NULL */
@@ -76,6 +82,18 @@ CycleNode * CycleGraph::getNode_noCreate(const Promise *promise) const
 	return promiseToNode.get(promise);
 }
 
+/**
+ * @brief Get a write's own entry in its reach clock vector
+ *
+ * This is the write's sequence number, except for the uninitialized writes,
+ * which have none. They belong to the model thread, which performs no other
+ * writes, and there is only one per location, so they can all use clock 1.
+ */
+static modelclock_t reach_clock(const ModelAction *act)
+{
+	return act->is_uninitialized() ? 1 : act->get_seq_number();
+}
+
 /**
  * @brief Returns the CycleNode corresponding to a given ModelAction
  *
@@ -89,6 +107,8 @@ CycleNode * CycleGraph::getNode(const ModelAction *action)
 	CycleNode *node = getNode_noCreate(action);
 	if (node == NULL) {
 		node = new CycleNode(action);
+		node->setOrder(nextOrder++);
+		node->setReach(id_to_int(action->get_tid()), reach_clock(action));
 		putNode(action, node);
 	}
 	return node;
@@ -108,6 +128,8 @@ CycleNode * CycleGraph::getNode(const Promise *promise)
 	CycleNode *node = getNode_noCreate(promise);
 	if (node == NULL) {
 		node = new CycleNode(promise);
+		node->setOrder(nextOrder++);
+		hasPromises = true;
 		putNode(promise, node);
 	}
 	return node;
@@ -189,6 +211,212 @@ bool CycleGraph::mergeNodes(CycleNode *w_node, CycleNode *p_node)
 	return !hasCycles;
 }
 
+/**
+ * @brief Identify an edge for CycleGraph::edgeHash
+ * @return A hash of the state IDs of the edge's endpoints, or 0 if either end
+ * is a Promise
+ */
+static uint64_t edgeId(const CycleNode *fromnode, const CycleNode *tonode)
+{
+	if (fromnode->is_promise() || tonode->is_promise())
+		return 0;
+	return state_hash_combine(fromnode->getAction()->get_state_id(),
+			tonode->getAction()->get_state_id());
+}
+
+/**
+ * @brief Add a single edge between two CycleNodes
+ *
+ * Tracks the edge's hash, and either keeps the topological order up to date
+ * or, if the edge closes a cycle, flags the graph as cyclic.
+ *
+ * @return True if the edge is new; false if it already existed
+ */
+bool CycleGraph::addGraphEdge(CycleNode *fromnode, CycleNode *tonode)
+{
+	if (!fromnode->addEdge(tonode))
+		return false;
+	edgeHash ^= edgeId(fromnode, tonode);
+	if (hasCycles)
+		return true;
+
+	if (!hasPromises) {
+		/* The edge closes a cycle iff tonode already reaches fromnode */
+		const ModelAction *act = tonode->getAction();
+		if (reach_clock(act) <= fromnode->getReach(id_to_int(act->get_tid())))
+			hasCycles = true;
+		else
+			propagateReach(fromnode, tonode);
+		orderValid = false;
+	} else if (!orderValid) {
+		hasCycles = !computeOrder();
+	} else if (fromnode->getOrder() >= tonode->getOrder()) {
+		hasCycles = !reorder(fromnode, tonode);
+	}
+	return true;
+}
+
+/**
+ * @brief Compute a topological order of the whole graph from scratch
+ *
+ * Uses each node's label as its count of unprocessed predecessors until it is
+ * placed (Kahn's algorithm).
+ *
+ * @return False if the graph has a cycle (in which case the labels are
+ * meaningless); true otherwise
+ */
+bool CycleGraph::computeOrder()
+{
+	affected->clear();
+	for (unsigned int i = 0; i < nodeList.size(); i++) {
+		CycleNode *node = nodeList[i];
+		node->setOrder(node->getNumBackEdges());
+		if (node->getOrder() == 0)
+			affected->push_back(node);
+	}
+	for (unsigned int i = 0; i < affected->size(); i++) {
+		CycleNode *node = (*affected)[i];
+		for (unsigned int j = 0; j < node->getNumEdges(); j++) {
+			CycleNode *next = node->getEdge(j);
+			next->setOrder(next->getOrder() - 1);
+			if (next->getOrder() == 0)
+				affected->push_back(next);
+		}
+	}
+	if (affected->size() < nodeList.size())
+		return false;
+
+	for (unsigned int i = 0; i < affected->size(); i++)
+		(*affected)[i]->setOrder(i);
+	nextOrder = affected->size();
+	orderValid = true;
+	return true;
+}
+
+/**
+ * @brief Merge one node's reach clock vector into another's, logging changes
+ * @return True if @a tonode's vector changed
+ */
+bool CycleGraph::mergeReach(const CycleNode *fromnode, CycleNode *tonode)
+{
+	bool changed = false;
+	for (unsigned int i = 0; i < fromnode->getNumReach(); i++) {
+		modelclock_t clock = fromnode->getReach(i);
+		if (clock > tonode->getReach(i)) {
+			struct reach_change change = { tonode, i, tonode->getReach(i) };
+			reachrollbackvector.push_back(change);
+			tonode->setReach(i, clock);
+			changed = true;
+		}
+	}
+	return changed;
+}
+
+/**
+ * @brief Update the reach clock vectors for a new edge
+ *
+ * Everything which reaches @a fromnode now also reaches @a tonode, and every
+ * node downstream of it whose vector is not already up to date.
+ */
+void CycleGraph::propagateReach(CycleNode *fromnode, CycleNode *tonode)
+{
+	if (!mergeReach(fromnode, tonode))
+		return;
+	queue->clear();
+	queue->push_back(tonode);
+	while (!queue->empty()) {
+		CycleNode *node = const_cast<CycleNode *>(queue->back());
+		queue->pop_back();
+		for (unsigned int i = 0; i < node->getNumEdges(); i++) {
+			CycleNode *next = node->getEdge(i);
+			if (mergeReach(node, next))
+				queue->push_back(next);
+		}
+	}
+}
+
+
+
+/** @brief Order CycleNodes by their topological order labels */
+static bool order_less(const CycleNode *a, const CycleNode *b)
+{
+	return a->getOrder() < b->getOrder();
+}
+
+/**
+ * @brief Restore the topological order after adding an edge against it
+ *
+ * The edge @a fromnode -> @a tonode has just been added, with @a tonode
+ * labelled no later than @a fromnode. Only the nodes labelled between the two
+ * can be out of order: those reachable from @a tonode, and those which reach
+ * @a fromnode. The first set is moved after the second, reusing the same
+ * labels, which leaves every other node untouched.
+ *
+ * @return False if the new edge closes a cycle (in which case the labels are
+ * left unchanged); true otherwise
+ */
+bool CycleGraph::reorder(CycleNode *fromnode, CycleNode *tonode)
+{
+	unsigned int lower = tonode->getOrder();
+	unsigned int upper = fromnode->getOrder();
+	unsigned int num_forward;
+
+	affected->clear();
+	orders->clear();
+
+	/* Nodes reachable from tonode, labelled before fromnode */
+	discovered->reset();
+	queue->clear();
+	queue->push_back(tonode);
+	discovered->put(tonode, tonode);
+	while (!queue->empty()) {
+		CycleNode *node = const_cast<CycleNode *>(queue->back());
+		queue->pop_back();
+		if (node == fromnode)
+			return false;
+		affected->push_back(node);
+		for (unsigned int i = 0; i < node->getNumEdges(); i++) {
+			CycleNode *next = node->getEdge(i);
+			if (next->getOrder() <= upper && !discovered->contains(next)) {
+				discovered->put(next, next);
+				queue->push_back(next);
+			}
+		}
+	}
+	num_forward = affected->size();
+
+	/* Nodes which reach fromnode, labelled after tonode */
+	discovered->reset();
+	queue->push_back(fromnode);
+	discovered->put(fromnode, fromnode);
+	while (!queue->empty()) {
+		CycleNode *node = const_cast<CycleNode *>(queue->back());
+		queue->pop_back();
+		affected->push_back(node);
+		for (unsigned int i = 0; i < node->getNumBackEdges(); i++) {
+			CycleNode *prev = node->getBackEdge(i);
+			if (prev->getOrder() > lower && !discovered->contains(prev)) {
+				discovered->put(prev, prev);
+				queue->push_back(prev);
+			}
+		}
+	}
+
+	/* Relabel: backward set first, then forward set, each in its old order */
+	for (unsigned int i = 0; i < affected->size(); i++)
+		orders->push_back((*affected)[i]->getOrder());
+	std::sort(orders->begin(), orders->end());
+	std::sort(affected->begin(), affected->begin() + num_forward, order_less);
+	std::sort(affected->begin() + num_forward, affected->end(), order_less);
+
+	unsigned int next = 0;
+	for (unsigned int i = num_forward; i < affected->size(); i++)
+		(*affected)[i]->setOrder((*orders)[next++]);
+	for (unsigned int i = 0; i < num_forward; i++)
+		(*affected)[i]->setOrder((*orders)[next++]);
+	return true;
+}
+
 /**
  * Adds an edge between two CycleNodes.
  * @param fromnode The edge comes from this CycleNode
@@ -197,11 +425,9 @@ bool CycleGraph::mergeNodes(CycleNode *w_node, CycleNode *p_node)
  */
 bool CycleGraph::addNodeEdge(CycleNode *fromnode, CycleNode *tonode)
 {
-	if (fromnode->addEdge(tonode)) {
+	if (addGraphEdge(fromnode, tonode))
 		rollbackvector.push_back(fromnode);
-		if (!hasCycles)
-			hasCycles = checkReachable(tonode, fromnode);
-	} else
+	else
 		return false; /* No new edge */
 
 	/*
@@ -215,12 +441,8 @@ bool CycleGraph::addNodeEdge(CycleNode *fromnode, CycleNode *tonode)
 			rmwnode = rmwnode->getRMW();
 
 		if (rmwnode != tonode) {
-			if (rmwnode->addEdge(tonode)) {
-				if (!hasCycles)
-					hasCycles = checkReachable(tonode, rmwnode);
-
+			if (addGraphEdge(rmwnode, tonode))
 				rollbackvector.push_back(rmwnode);
-			}
 		}
 	}
 	return true;
@@ -266,7 +488,7 @@ void CycleGraph::addRMWEdge(const T *from, const ModelAction *rmw)
 	for (unsigned int i = 0; i < fromnode->getNumEdges(); i++) {
 		CycleNode *tonode = fromnode->getEdge(i);
 		if (tonode != rmwnode) {
-			if (rmwnode->addEdge(tonode))
+			if (addGraphEdge(rmwnode, tonode))
 				rollbackvector.push_back(rmwnode);
 		}
 	}
@@ -388,12 +610,28 @@ void CycleGraph::dumpGraphToFile(const char *filename) const
 
 /**
  * Checks whether one CycleNode can reach another.
+ *
+ * Without promises, this is a comparison against the reach clock vector of
+ * @a to. Otherwise, while the graph is acyclic, a node can only reach nodes
+ * later in the topological order, so the search is skipped entirely when @a
+ * to comes before @a from, and otherwise never leaves the nodes labelled
+ * between them.
+ *
  * @param from The CycleNode from which to begin exploration
  * @param to The CycleNode to reach
  * @return True, @a from can reach @a to; otherwise, false
  */
 bool CycleGraph::checkReachable(const CycleNode *from, const CycleNode *to) const
 {
+	if (reachValid()) {
+		const ModelAction *act = from->getAction();
+		return reach_clock(act) <= to->getReach(id_to_int(act->get_tid()));
+	}
+
+	unsigned int bound = (hasCycles || !orderValid) ? UINT_MAX : to->getOrder();
+	if (from->getOrder() > bound)
+		return false;
+
 	discovered->reset();
 	queue->clear();
 	queue->push_back(from);
@@ -405,7 +643,7 @@ bool CycleGraph::checkReachable(const CycleNode *from, const CycleNode *to) cons
 			return true;
 		for (unsigned int i = 0; i < node->getNumEdges(); i++) {
 			CycleNode *next = node->getEdge(i);
-			if (!discovered->contains(next)) {
+			if (next->getOrder() <= bound && !discovered->contains(next)) {
 				discovered->put(next, next);
 				queue->push_back(next);
 			}
@@ -475,6 +713,7 @@ void CycleGraph::startChanges()
 {
 	ASSERT(rollbackvector.empty());
 	ASSERT(rmwrollbackvector.empty());
+	ASSERT(reachrollbackvector.empty());
 	ASSERT(oldCycles == hasCycles);
 }
 
@@ -483,18 +722,27 @@ void CycleGraph::commitChanges()
 {
 	rollbackvector.clear();
 	rmwrollbackvector.clear();
+	reachrollbackvector.clear();
 	oldCycles = hasCycles;
 }
 
 /** Rollback changes to the previous commit. */
 void CycleGraph::rollbackChanges()
 {
-	for (unsigned int i = 0; i < rollbackvector.size(); i++)
-		rollbackvector[i]->removeEdge();
+	for (unsigned int i = 0; i < rollbackvector.size(); i++) {
+		CycleNode *tonode = rollbackvector[i]->removeEdge();
+		edgeHash ^= edgeId(rollbackvector[i], tonode);
+	}
 
 	for (unsigned int i = 0; i < rmwrollbackvector.size(); i++)
 		rmwrollbackvector[i]->clearRMW();
 
+	while (!reachrollbackvector.empty()) {
+		struct reach_change *change = &reachrollbackvector.back();
+		change->node->setReach(change->tid, change->clock);
+		reachrollbackvector.pop_back();
+	}
+
 	hasCycles = oldCycles;
 	rollbackvector.clear();
 	rmwrollbackvector.clear();
@@ -513,7 +761,8 @@ bool CycleGraph::checkForCycles() const
 CycleNode::CycleNode(const ModelAction *act) :
 	action(act),
 	promise(NULL),
-	hasRMW(NULL)
+	hasRMW(NULL),
+	order(0)
 {
 }
 
@@ -524,8 +773,24 @@ CycleNode::CycleNode(const ModelAction *act) :
 CycleNode::CycleNode(const Promise *promise) :
 	action(NULL),
 	promise(promise),
-	hasRMW(NULL)
+	hasRMW(NULL),
+	order(0)
+{
+}
+
+/** @return The latest sequence number of thread @a tid's writes which reach
+ * this node, or 0 if none do */
+modelclock_t CycleNode::getReach(unsigned int tid) const
+{
+	return tid < reach.size() ? reach[tid] : 0;
+}
+
+/** @brief Set this node's reach clock vector entry for thread @a tid */
+void CycleNode::setReach(unsigned int tid, modelclock_t clock)
 {
+	if (tid >= reach.size())
+		reach.resize(tid + 1);
+	reach[tid] = clock;
 }
 
 /**
@@ -12,16 +12,37 @@
 #include <inttypes.h>
 #include <stdio.h>
 
-#include "hashtable.h"
+#include "swisstable.h"
 #include "config.h"
 #include "mymemory.h"
 #include "stl-model.h"
+#include "modeltypes.h"
 
 class Promise;
 class CycleNode;
 class ModelAction;
 
-/** @brief A graph of Model Actions for tracking cycles. */
+/**
+ * @brief A graph of Model Actions for tracking cycles.
+ *
+ * Edges only ever connect writes to the same location, and the graph orders
+ * each thread's writes to a location in sequence, so each location's graph is
+ * one chain per thread plus the edges between chains. Every node therefore
+ * carries a reach clock vector: for each thread, the latest sequence number
+ * of that thread's writes which reach the node. A write reaches a node
+ * exactly when its sequence number is covered by the node's entry for its
+ * thread, so reachability queries and the cycle check for a new edge are
+ * single clock comparisons. Entries are pushed forward along each new edge,
+ * and logged so they can be rolled back.
+ *
+ * Promise nodes have no sequence number and break the per-thread chains, so
+ * once a Promise enters the graph it falls back to searching, guided by a
+ * topological order label on every node. The order is computed when first
+ * needed and then kept up to date as edges are added (Pearce and Kelly's
+ * dynamic topological sort); a node can only reach later nodes, so any
+ * search stays between the two labels. Removing edges never invalidates the
+ * order, so rolling back needs no work.
+ */
 class CycleGraph {
  public:
 	CycleGraph();
@@ -53,9 +74,13 @@ class CycleGraph {
 
 	bool resolvePromise(const Promise *promise, ModelAction *writer);
 
+	/** @return An order-independent hash of the edges between ModelActions */
+	uint64_t getEdgeHash() const { return edgeHash; }
+
 	SNAPSHOTALLOC
  private:
 	bool addNodeEdge(CycleNode *fromnode, CycleNode *tonode);
+	bool addGraphEdge(CycleNode *fromnode, CycleNode *tonode);
 	void putNode(const ModelAction *act, CycleNode *node);
 	void putNode(const Promise *promise, CycleNode *node);
 	void erasePromiseNode(const Promise *promise);
@@ -64,19 +89,27 @@ class CycleGraph {
 	CycleNode * getNode_noCreate(const ModelAction *act) const;
 	CycleNode * getNode_noCreate(const Promise *promise) const;
 	bool mergeNodes(CycleNode *node1, CycleNode *node2);
-
-	HashTable<const CycleNode *, const CycleNode *, uintptr_t, 4, model_malloc, model_calloc, model_free> *discovered;
+	bool computeOrder();
+	bool reorder(CycleNode *fromnode, CycleNode *tonode);
+	bool mergeReach(const CycleNode *fromnode, CycleNode *tonode);
+	void propagateReach(CycleNode *fromnode, CycleNode *tonode);
+	/** @return True if the reach clock vectors describe the graph */
+	bool reachValid() const { return !hasCycles && !hasPromises; }
+
+	SwissTable<const CycleNode *, const CycleNode *, uintptr_t, 4, model_malloc, model_calloc, model_free> *discovered;
 	ModelVector<const CycleNode *> * queue;
+	/** @brief Scratch space for CycleGraph::reorder() */
+	ModelVector<CycleNode *> * affected;
+	/** @brief Scratch space for CycleGraph::reorder() */
+	ModelVector<unsigned int> * orders;
 
 
 	/** @brief A table for mapping ModelActions to CycleNodes */
-	HashTable<const ModelAction *, CycleNode *, uintptr_t, 4> actionToNode;
+	SwissTable<const ModelAction *, CycleNode *, uintptr_t, 4> actionToNode;
 	/** @brief A table for mapping Promises to CycleNodes */
-	HashTable<const Promise *, CycleNode *, uintptr_t, 4> promiseToNode;
+	SwissTable<const Promise *, CycleNode *, uintptr_t, 4> promiseToNode;
 
-#if SUPPORT_MOD_ORDER_DUMP
 	SnapVector<CycleNode *> nodeList;
-#endif
 
 	bool checkReachable(const CycleNode *from, const CycleNode *to) const;
 
@@ -85,8 +118,28 @@ class CycleGraph {
 	/** @brief The previous value of CycleGraph::hasCycles, for rollback */
 	bool oldCycles;
 
+	/** @brief The topological order label for the next new CycleNode */
+	unsigned int nextOrder;
+
+	/** @brief A flag: true if the topological order labels are up to date */
+	bool orderValid;
+
+	/** @brief A flag: true if this graph has ever contained a Promise node */
+	bool hasPromises;
+
+	/** @brief XOR of the state IDs of every edge between two ModelActions */
+	uint64_t edgeHash;
+
 	SnapVector<CycleNode *> rollbackvector;
 	SnapVector<CycleNode *> rmwrollbackvector;
+
+	/** @brief A reach clock vector entry, as it was before a change */
+	struct reach_change {
+		CycleNode *node;
+		unsigned int tid;
+		modelclock_t clock;
+	};
+	SnapVector<struct reach_change> reachrollbackvector;
 };
 
 /**
@@ -112,6 +165,11 @@ class CycleNode {
 	const Promise * getPromise() const { return promise; }
 	bool is_promise() const { return !action; }
 	void resolvePromise(const ModelAction *writer);
+	unsigned int getOrder() const { return order; }
+	void setOrder(unsigned int o) { order = o; }
+	modelclock_t getReach(unsigned int tid) const;
+	void setReach(unsigned int tid, modelclock_t clock);
+	unsigned int getNumReach() const { return reach.size(); }
 
 	SNAPSHOTALLOC
  private:
@@ -131,6 +189,19 @@ class CycleNode {
 	/** Pointer to a RMW node that reads from this node, or NULL, if none
 	 * exists */
 	CycleNode *hasRMW;
+
+	/**
+	 * @brief This node's position in a topological order of the graph
+	 * @see CycleGraph::reorder
+	 */
+	unsigned int order;
+
+	/**
+	 * @brief For each thread, the latest sequence number of its writes
+	 * which reach this node
+	 * @see CycleGraph
+	 */
+	SnapVector<modelclock_t> reach;
 };
 
 #endif /* __CYCLEGRAPH_H__ */
@@ -3,18 +3,79 @@
 #include "threads-model.h"
 #include <stdio.h>
 #include <cstring>
+#include <inttypes.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include "mymemory.h"
 #include "clockvector.h"
 #include "config.h"
 #include "action.h"
 #include "execution.h"
 #include "stl-model.h"
+#include "swisstable.h"
 
 static struct ShadowTable *root;
-static SnapVector<DataRace *> *unrealizedraces;
+
+/**
+ * @brief The races which are not yet known to be realized
+ *
+ * A race stays unrealized while the execution is not a feasible prefix (see
+ * checkDataRaces()); in the meantime, synchronization may give its second
+ * access a clock vector which no longer races, so the races are indexed by
+ * the thread of their second access (see pruneDataRaces()).
+ */
+struct UnrealizedRaces {
+	UnrealizedRaces() :
+		bythread(),
+		index(64),
+		count(0)
+	{ }
+
+	/** @brief The races, indexed by the thread of their second access */
+	SnapVector< SnapVector<struct DataRace *> > bythread;
+	/** @brief A race for each key, to merge duplicates; see race_key() */
+	SwissTable<uint64_t, struct DataRace *, uint64_t> index;
+	/** @brief The total number of races */
+	unsigned int count;
+
+	SNAPSHOTALLOC
+};
+
+static struct UnrealizedRaces *unrealizedraces;
+static void *memory_start;
 static void *memory_base;
 static void *memory_top;
 
+/**
+ * @brief A thread's cache of recently used shadow base tables
+ *
+ * Direct-mapped on the 64 KiB page number of the address, so a hit skips the
+ * walk down the shadow table trie. An entry with a NULL table is invalid.
+ */
+struct ShadowCache {
+	uintptr_t page[SHADOW_CACHE_ENTRIES];
+	struct ShadowBaseTable *table[SHADOW_CACHE_ENTRIES];
+};
+
+/* Indexed by thread. Kept in model memory, so it is not rolled back along
+ * with the shadow tables; see flushShadowCache(). */
+static ModelVector<struct ShadowCache> *shadowcaches;
+
+/* Cumulative statistics; these live outside the snapshotted heap so they
+ * survive rollback */
+static uint64_t num_read_checks;
+static uint64_t num_write_checks;
+static uint64_t num_expanded_records;
+static uint64_t num_cache_hits;
+static uint64_t num_cache_misses;
+static uint64_t num_tables;
+static uint64_t num_table_splits;
+static uint64_t table_bytes;
+static uint64_t num_races_reported;
+static uint64_t num_races_merged;
+static uint64_t num_races_pruned;
+
 static const ModelExecution * get_execution()
 {
 	return model->get_execution();
@@ -24,9 +85,21 @@ static const ModelExecution * get_execution()
 void initRaceDetector()
 {
 	root = (struct ShadowTable *)snapshot_calloc(sizeof(struct ShadowTable), 1);
-	memory_base = snapshot_calloc(sizeof(struct ShadowBaseTable) * SHADOWBASETABLES, 1);
-	memory_top = ((char *)memory_base) + sizeof(struct ShadowBaseTable) * SHADOWBASETABLES;
-	unrealizedraces = new SnapVector<DataRace *>();
+	memory_start = memory_base = snapshot_calloc(SHADOWBASETABLEBYTES(0) * SHADOWBASETABLES, 1);
+	memory_top = ((char *)memory_base) + SHADOWBASETABLEBYTES(0) * SHADOWBASETABLES;
+	unrealizedraces = new UnrealizedRaces();
+	shadowcaches = new ModelVector<struct ShadowCache>();
+}
+
+/**
+ * @brief Invalidate every thread's shadow table cache
+ *
+ * Must be called after a snapshot rollback, which may free shadow tables
+ * that the caches still point to.
+ */
+void flushShadowCache()
+{
+	shadowcaches->clear();
 }
 
 void * table_calloc(size_t size)
@@ -40,9 +113,155 @@ void * table_calloc(size_t size)
 	}
 }
 
-/** This function looks up the entry in the shadow table corresponding to a
- * given address.*/
-static uint64_t * lookupAddressEntry(const void *address)
+static void table_free(void *table)
+{
+	/* Preallocated tables are never reused, so just drop them */
+	if (table < memory_start || table >= memory_top)
+		snapshot_free(table);
+}
+
+/*
+ * Accessors for the two shadow word encodings (see datarace.h). An empty
+ * shadow word is all zeros in both, which decodes as no read and no write.
+ */
+#if WIDE_SHADOW
+static inline bool shadow_is_expanded(shadow_t shadowval)
+{
+	return shadowval.write == EXPANDEDRECORD;
+}
+
+static inline struct RaceRecord * shadow_record(shadow_t shadowval)
+{
+	return (struct RaceRecord *)shadowval.read;
+}
+
+static inline void shadow_set_record(shadow_t *shadow, struct RaceRecord *record)
+{
+	shadow->read = (uint64_t)record;
+	shadow->write = EXPANDEDRECORD;
+}
+
+static inline int shadow_read_thread(shadow_t shadowval)
+{
+	return ACCESSTHREADID(shadowval.read);
+}
+
+static inline modelclock_t shadow_read_clock(shadow_t shadowval)
+{
+	return ACCESSVECTOR(shadowval.read);
+}
+
+static inline int shadow_write_thread(shadow_t shadowval)
+{
+	return ACCESSTHREADID(shadowval.write);
+}
+
+static inline modelclock_t shadow_write_clock(shadow_t shadowval)
+{
+	return ACCESSVECTOR(shadowval.write);
+}
+
+static inline void shadow_set(shadow_t *shadow, int rdthread, modelclock_t rdtime, int wrthread, modelclock_t wrtime)
+{
+	shadow->read = ENCODEACCESS(rdthread, rdtime);
+	shadow->write = ENCODEACCESS(wrthread, wrtime);
+}
+#else
+static inline bool shadow_is_expanded(shadow_t shadowval)
+{
+	return shadowval != 0 && !ISSHORTRECORD(shadowval);
+}
+
+static inline struct RaceRecord * shadow_record(shadow_t shadowval)
+{
+	return (struct RaceRecord *)shadowval;
+}
+
+static inline void shadow_set_record(shadow_t *shadow, struct RaceRecord *record)
+{
+	*shadow = (uint64_t)record;
+}
+
+static inline int shadow_read_thread(shadow_t shadowval)
+{
+	return RDTHREADID(shadowval);
+}
+
+static inline modelclock_t shadow_read_clock(shadow_t shadowval)
+{
+	return READVECTOR(shadowval);
+}
+
+static inline int shadow_write_thread(shadow_t shadowval)
+{
+	return WRTHREADID(shadowval);
+}
+
+static inline modelclock_t shadow_write_clock(shadow_t shadowval)
+{
+	return WRITEVECTOR(shadowval);
+}
+
+static inline void shadow_set(shadow_t *shadow, int rdthread, modelclock_t rdtime, int wrthread, modelclock_t wrtime)
+{
+	*shadow = ENCODEOP(rdthread, rdtime, wrthread, wrtime);
+}
+#endif
+
+static inline bool shadow_equal(shadow_t a, shadow_t b)
+{
+#if WIDE_SHADOW
+	return a.read == b.read && a.write == b.write;
+#else
+	return a == b;
+#endif
+}
+
+/** @brief Copy the first of @a count shadow words over the rest */
+static inline void shadow_fill(shadow_t *shadow, unsigned int count)
+{
+	for (unsigned int i = 1; i < count; i++)
+		shadow[i] = shadow[0];
+}
+
+/** @brief The number of shadow words compared by one vector comparison */
+#define SHADOWS_PER_VECTOR (16 / sizeof(shadow_t))
+
+/**
+ * @brief Find the run of shadow words identical to the first
+ *
+ * Untouched memory and the bytes of a previous wide or bulk access share
+ * the same compact shadow word, so long runs are the common case; these are
+ * compared 16 bytes at a time where SSE2 is available. Expanded records
+ * point to distinct RaceRecords, so they never form runs.
+ *
+ * @param shadow The first shadow word
+ * @param max The maximum length of the run
+ * @return The length of the run, at least 1
+ */
+static unsigned int shadow_run(const shadow_t *shadow, size_t max)
+{
+	unsigned int n = 1;
+#ifdef __SSE2__
+#if WIDE_SHADOW
+	__m128i first = _mm_loadu_si128((const __m128i *)shadow);
+#else
+	__m128i first = _mm_set1_epi64x((long long)*shadow);
+#endif
+	for (; n + SHADOWS_PER_VECTOR <= max; n += SHADOWS_PER_VECTOR) {
+		__m128i words = _mm_loadu_si128((const __m128i *)(shadow + n));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi32(words, first)) != 0xffff)
+			break;
+	}
+#endif
+	while (n < max && shadow_equal(shadow[n], shadow[0]))
+		n++;
+	return n;
+}
+
+/** This function looks up the trie slot which points to the shadow base
+ * table corresponding to a given address. */
+static void ** lookupBaseSlot(const void *address)
 {
 	struct ShadowTable *currtable = root;
 #if BIT48
@@ -52,11 +271,130 @@ static uint64_t * lookupAddressEntry(const void *address)
 	}
 #endif
 
-	struct ShadowBaseTable *basetable = (struct ShadowBaseTable *)currtable->array[(((uintptr_t)address) >> 16) & MASK16BIT];
-	if (basetable == NULL) {
-		basetable = (struct ShadowBaseTable *)(currtable->array[(((uintptr_t)address) >> 16) & MASK16BIT] = table_calloc(sizeof(struct ShadowBaseTable)));
+	return &currtable->array[(((uintptr_t)address) >> 16) & MASK16BIT];
+}
+
+/** @brief Allocate an empty shadow base table with a given granularity */
+static struct ShadowBaseTable * allocBaseTable(unsigned int shift)
+{
+	struct ShadowBaseTable *table = (struct ShadowBaseTable *)table_calloc(SHADOWBASETABLEBYTES(shift));
+	table->shift = shift;
+	num_tables++;
+	table_bytes += SHADOWBASETABLEBYTES(shift);
+	return table;
+}
+
+/** @brief Copy an expanded record, so that two shadow words can own one each */
+static struct RaceRecord * copyRecord(const struct RaceRecord *record)
+{
+	struct RaceRecord *copy = (struct RaceRecord *)snapshot_malloc(sizeof(struct RaceRecord));
+	*copy = *record;
+	if (record->capacity != 0) {
+		copy->thread = (thread_id_t *)snapshot_malloc(sizeof(thread_id_t) * record->capacity);
+		copy->readClock = (modelclock_t *)snapshot_malloc(sizeof(modelclock_t) * record->capacity);
+		std::memcpy(copy->thread, record->thread, record->numReads * sizeof(thread_id_t));
+		std::memcpy(copy->readClock, record->readClock, record->numReads * sizeof(modelclock_t));
+	}
+	num_expanded_records++;
+	return copy;
+}
+
+/**
+ * @brief Replace a shadow base table with one of a finer granularity
+ *
+ * Each shadow word is replicated across the words which now cover its
+ * bytes; expanded records are copied, since each record belongs to exactly
+ * one word. Every thread's cache may point to the old table, so all of them
+ * are flushed.
+ *
+ * @param slot The trie slot pointing to the table
+ * @param shift The new granularity; must be finer than the table's
+ * @return The new table
+ */
+static struct ShadowBaseTable * splitBaseTable(void **slot, unsigned int shift)
+{
+	struct ShadowBaseTable *old = (struct ShadowBaseTable *)*slot;
+	struct ShadowBaseTable *table = allocBaseTable(shift);
+	unsigned int ratio = 1 << (old->shift - shift);
+
+	for (unsigned int i = 0; i < SHADOWWORDS(old->shift); i++) {
+		shadow_t shadowval = old->array[i];
+		shadow_t *shadow = &table->array[i * ratio];
+		if (shadow_is_expanded(shadowval)) {
+			shadow[0] = shadowval;
+			for (unsigned int j = 1; j < ratio; j++)
+				shadow_set_record(&shadow[j], copyRecord(shadow_record(shadowval)));
+		} else {
+			for (unsigned int j = 0; j < ratio; j++)
+				shadow[j] = shadowval;
+		}
+	}
+
+	*slot = table;
+	table_free(old);
+	num_table_splits++;
+	flushShadowCache();
+	return table;
+}
+
+/**
+ * @brief The coarsest shadow granularity which can represent an access
+ * @param addr The first byte accessed
+ * @param size The number of bytes accessed
+ * @return The log2 of the number of bytes per shadow word
+ */
+static unsigned int access_shift(uintptr_t addr, size_t size)
+{
+	if (((addr | size) & 7) == 0)
+		return 3;
+	if (((addr | size) & 3) == 0)
+		return 2;
+	return 0;
+}
+
+/**
+ * @brief Look up the shadow base table for an address, through the accessing
+ * thread's cache
+ *
+ * A new table starts out as coarse as SHADOWINITIALSHIFT allows, and is only
+ * split into a finer one when an access does not fit its granularity.
+ *
+ * @param thread The accessing thread
+ * @param address The address
+ * @param maxshift The coarsest granularity the access can be represented at
+ * (see access_shift())
+ * @return The table, whose granularity is no coarser than @a maxshift
+ */
+static struct ShadowBaseTable * lookupBaseTable(thread_id_t thread, const void *address, unsigned int maxshift)
+{
+	unsigned int tid = id_to_int(thread);
+	uintptr_t page = ((uintptr_t)address) >> 16;
+	unsigned int i = page & (SHADOW_CACHE_ENTRIES - 1);
+
+	if (tid < shadowcaches->size()) {
+		struct ShadowCache *cache = &(*shadowcaches)[tid];
+		struct ShadowBaseTable *basetable = cache->table[i];
+		if (basetable != NULL && cache->page[i] == page && basetable->shift <= maxshift) {
+			num_cache_hits++;
+			return basetable;
+		}
 	}
-	return &basetable->array[((uintptr_t)address) & MASK16BIT];
+	num_cache_misses++;
+
+	void **slot = lookupBaseSlot(address);
+	struct ShadowBaseTable *basetable = (struct ShadowBaseTable *)*slot;
+	if (basetable == NULL)
+		basetable = (struct ShadowBaseTable *)(*slot = allocBaseTable(maxshift < SHADOWINITIALSHIFT ? maxshift : SHADOWINITIALSHIFT));
+	else if (basetable->shift > maxshift)
+		basetable = splitBaseTable(slot, maxshift);
+
+	/* Splitting may have flushed the caches */
+	if (tid >= shadowcaches->size())
+		shadowcaches->resize(tid + 1);
+	struct ShadowCache *cache = &(*shadowcaches)[tid];
+	cache->page[i] = page;
+	cache->table[i] = basetable;
+	return basetable;
 }
 
 /**
@@ -78,14 +416,14 @@ static bool clock_may_race(ClockVector *clock1, thread_id_t tid1,
  * Expands a record from the compact form to the full form.  This is
  * necessary for multiple readers or for very large thread ids or time
  * stamps. */
-static void expandRecord(uint64_t *shadow)
+static void expandRecord(shadow_t *shadow)
 {
-	uint64_t shadowval = *shadow;
+	shadow_t shadowval = *shadow;
 
-	modelclock_t readClock = READVECTOR(shadowval);
-	thread_id_t readThread = int_to_id(RDTHREADID(shadowval));
-	modelclock_t writeClock = WRITEVECTOR(shadowval);
-	thread_id_t writeThread = int_to_id(WRTHREADID(shadowval));
+	modelclock_t readClock = shadow_read_clock(shadowval);
+	thread_id_t readThread = int_to_id(shadow_read_thread(shadowval));
+	modelclock_t writeClock = shadow_write_clock(shadowval);
+	thread_id_t writeThread = int_to_id(shadow_write_thread(shadowval));
 
 	struct RaceRecord *record = (struct RaceRecord *)snapshot_calloc(1, sizeof(struct RaceRecord));
 	record->writeThread = writeThread;
@@ -99,20 +437,57 @@ static void expandRecord(uint64_t *shadow)
 		record->thread[0] = readThread;
 		record->readClock[0] = readClock;
 	}
-	*shadow = (uint64_t) record;
+	shadow_set_record(shadow, record);
+	num_expanded_records++;
+}
+
+/**
+ * @brief Hash the accesses of a race
+ *
+ * Races with the same key are duplicates: the second accesses are in the
+ * same thread, so the earliest one has the smallest clock vector and races
+ * whenever any of the others does.
+ */
+static uint64_t race_key(const void *address, thread_id_t oldthread, modelclock_t oldclock, thread_id_t newthread)
+{
+	uint64_t key = (uintptr_t)address;
+	key = key * 0x9e3779b97f4a7c15ULL ^ ((((uint64_t)id_to_int(oldthread)) << 32) | oldclock);
+	key = key * 0x9e3779b97f4a7c15ULL ^ id_to_int(newthread);
+	return key;
+}
+
+static bool race_matches(const struct DataRace *race, const void *address, thread_id_t oldthread, modelclock_t oldclock, thread_id_t newthread)
+{
+	return race->address == address && race->oldthread == oldthread &&
+		race->oldclock == oldclock && race->newaction->get_tid() == newthread;
 }
 
 /** This function is called when we detect a data race.*/
 static void reportDataRace(thread_id_t oldthread, modelclock_t oldclock, bool isoldwrite, ModelAction *newaction, bool isnewwrite, const void *address)
 {
-	struct DataRace *race = (struct DataRace *)snapshot_malloc(sizeof(struct DataRace));
-	race->oldthread = oldthread;
-	race->oldclock = oldclock;
-	race->isoldwrite = isoldwrite;
-	race->newaction = newaction;
-	race->isnewwrite = isnewwrite;
-	race->address = address;
-	unrealizedraces->push_back(race);
+	thread_id_t newthread = newaction->get_tid();
+	uint64_t key = race_key(address, oldthread, oldclock, newthread);
+	struct DataRace *dup = unrealizedraces->index.get(key);
+
+	num_races_reported++;
+	if (dup != NULL && race_matches(dup, address, oldthread, oldclock, newthread)) {
+		num_races_merged++;
+	} else {
+		struct DataRace *race = (struct DataRace *)snapshot_malloc(sizeof(struct DataRace));
+		race->oldthread = oldthread;
+		race->oldclock = oldclock;
+		race->isoldwrite = isoldwrite;
+		race->newaction = newaction;
+		race->isnewwrite = isnewwrite;
+		race->address = address;
+
+		unsigned int tid = id_to_int(newthread);
+		if (tid >= unrealizedraces->bythread.size())
+			unrealizedraces->bythread.resize(tid + 1);
+		unrealizedraces->bythread[tid].push_back(race);
+		unrealizedraces->index.put(key, race);
+		unrealizedraces->count++;
+	}
 
 	/* If the race is realized, bail out now. */
 	if (checkDataRaces())
@@ -130,23 +505,65 @@ static void reportDataRace(thread_id_t oldthread, modelclock_t oldclock, bool is
  */
 bool checkDataRaces()
 {
+	/* Don't bother checking for feasibility when there is nothing to do */
+	if (unrealizedraces->count == 0)
+		return false;
+
 	if (get_execution()->isfeasibleprefix()) {
 		bool race_asserted = false;
 		/* Prune the non-racing unrealized dataraces */
-		for (unsigned i = 0; i < unrealizedraces->size(); i++) {
-			struct DataRace *race = (*unrealizedraces)[i];
-			if (clock_may_race(race->newaction->get_cv(), race->newaction->get_tid(), race->oldclock, race->oldthread)) {
-				assert_race(race);
-				race_asserted = true;
+		for (unsigned int t = 0; t < unrealizedraces->bythread.size(); t++) {
+			SnapVector<struct DataRace *> *races = &unrealizedraces->bythread[t];
+			for (unsigned i = 0; i < races->size(); i++) {
+				struct DataRace *race = (*races)[i];
+				if (clock_may_race(race->newaction->get_cv(), race->newaction->get_tid(), race->oldclock, race->oldthread)) {
+					assert_race(race);
+					race_asserted = true;
+				}
+				snapshot_free(race);
 			}
-			snapshot_free(race);
+			races->clear();
 		}
-		unrealizedraces->clear();
+		unrealizedraces->index.reset();
+		unrealizedraces->count = 0;
 		return race_asserted;
 	}
 	return false;
 }
 
+/**
+ * @brief Drop a thread's unrealized races which no longer race
+ *
+ * Must be called whenever synchronization changes the clock vector of one of
+ * the thread's actions, since that may order the second access of a pending
+ * race after its first. Only that thread's races are examined.
+ *
+ * @param tid The thread whose action synchronized
+ */
+void pruneDataRaces(thread_id_t tid)
+{
+	unsigned int t = id_to_int(tid);
+	if (t >= unrealizedraces->bythread.size())
+		return;
+	SnapVector<struct DataRace *> *races = &unrealizedraces->bythread[t];
+
+	unsigned int copytoindex = 0;
+	for (unsigned int i = 0; i < races->size(); i++) {
+		struct DataRace *race = (*races)[i];
+		if (clock_may_race(race->newaction->get_cv(), tid, race->oldclock, race->oldthread)) {
+			(*races)[copytoindex++] = race;
+			continue;
+		}
+		uint64_t key = race_key(race->address, race->oldthread, race->oldclock, tid);
+		if (unrealizedraces->index.get(key) == race)
+			unrealizedraces->index.remove(key);
+		snapshot_free(race);
+		unrealizedraces->count--;
+		num_races_pruned++;
+	}
+	races->resize(copytoindex);
+}
+
 /**
  * @brief Assert a data race
  *
@@ -172,9 +589,9 @@ void assert_race(struct DataRace *race)
 }
 
 /** This function does race detection for a write on an expanded record. */
-void fullRaceCheckWrite(thread_id_t thread, void *location, uint64_t *shadow, ClockVector *currClock)
+void fullRaceCheckWrite(thread_id_t thread, void *location, shadow_t *shadow, ClockVector *currClock)
 {
-	struct RaceRecord *record = (struct RaceRecord *)(*shadow);
+	struct RaceRecord *record = shadow_record(*shadow);
 
 	/* Check for datarace against last read. */
 
@@ -207,16 +624,31 @@ void fullRaceCheckWrite(thread_id_t thread, void *location, uint64_t *shadow, Cl
 	record->writeClock = ourClock;
 }
 
-/** This function does race detection on a write. */
-void raceCheckWrite(thread_id_t thread, void *location)
+/**
+ * @brief Race check a write against a run of identical shadow words
+ *
+ * Every word in the run decodes to the same last read and last write, so a
+ * compact run is checked once and then overwritten as a whole. A run of
+ * expanded records, or one which has to be expanded, is checked a word at a
+ * time.
+ *
+ * @param thread The writing thread
+ * @param location The address of the first byte in the run
+ * @param shadow The first shadow word in the run
+ * @param count The number of shadow words in the run
+ * @param shift The log2 of the number of bytes per shadow word
+ * @param currClock The writing thread's clock vector
+ */
+static void raceCheckWriteRun(thread_id_t thread, void *location, shadow_t *shadow, unsigned int count, unsigned int shift, ClockVector *currClock)
 {
-	uint64_t *shadow = lookupAddressEntry(location);
-	uint64_t shadowval = *shadow;
-	ClockVector *currClock = get_execution()->get_cv(thread);
+	shadow_t shadowval = *shadow;
+
+	num_write_checks += count << shift;
 
 	/* Do full record */
-	if (shadowval != 0 && !ISSHORTRECORD(shadowval)) {
-		fullRaceCheckWrite(thread, location, shadow, currClock);
+	if (shadow_is_expanded(shadowval)) {
+		for (unsigned int i = 0; i < count; i++)
+			fullRaceCheckWrite(thread, ((char *)location) + (i << shift), shadow + i, currClock);
 		return;
 	}
 
@@ -225,15 +657,17 @@ void raceCheckWrite(thread_id_t thread, void *location)
 
 	/* Thread ID is too large or clock is too large. */
 	if (threadid > MAXTHREADID || ourClock > MAXWRITEVECTOR) {
-		expandRecord(shadow);
-		fullRaceCheckWrite(thread, location, shadow, currClock);
+		for (unsigned int i = 0; i < count; i++) {
+			expandRecord(shadow + i);
+			fullRaceCheckWrite(thread, ((char *)location) + (i << shift), shadow + i, currClock);
+		}
 		return;
 	}
 
 	/* Check for datarace against last read. */
 
-	modelclock_t readClock = READVECTOR(shadowval);
-	thread_id_t readThread = int_to_id(RDTHREADID(shadowval));
+	modelclock_t readClock = shadow_read_clock(shadowval);
+	thread_id_t readThread = int_to_id(shadow_read_thread(shadowval));
 
 	if (clock_may_race(currClock, thread, readClock, readThread)) {
 		/* We have a datarace */
@@ -242,20 +676,61 @@ void raceCheckWrite(thread_id_t thread, void *location)
 
 	/* Check for datarace against last write. */
 
-	modelclock_t writeClock = WRITEVECTOR(shadowval);
-	thread_id_t writeThread = int_to_id(WRTHREADID(shadowval));
+	modelclock_t writeClock = shadow_write_clock(shadowval);
+	thread_id_t writeThread = int_to_id(shadow_write_thread(shadowval));
 
 	if (clock_may_race(currClock, thread, writeClock, writeThread)) {
 		/* We have a datarace */
 		reportDataRace(writeThread, writeClock, true, get_execution()->get_parent_action(thread), true, location);
 	}
-	*shadow = ENCODEOP(0, 0, threadid, ourClock);
+	shadow_set(shadow, 0, 0, threadid, ourClock);
+	shadow_fill(shadow, count);
+}
+
+/** This function does race detection on a write. */
+void raceCheckWrite(thread_id_t thread, void *location)
+{
+	raceCheckWriteRange(thread, location, 1);
+}
+
+/**
+ * @brief Race check a write to a range of bytes
+ *
+ * Equivalent to calling raceCheckWrite() on every byte in the range, but
+ * looks up each shadow table only once and checks each run of identical
+ * shadow words (see shadow_run()) only once.
+ *
+ * @param thread The writing thread
+ * @param location The first byte written
+ * @param size The number of bytes written
+ */
+void raceCheckWriteRange(thread_id_t thread, void *location, size_t size)
+{
+	ClockVector *currClock = get_execution()->get_cv(thread);
+	uintptr_t addr = (uintptr_t)location;
+
+	while (size > 0) {
+		size_t n = MASK16BIT + 1 - (addr & MASK16BIT);
+		if (n > size)
+			n = size;
+		struct ShadowBaseTable *table = lookupBaseTable(thread, (void *)addr, access_shift(addr, n));
+		unsigned int shift = table->shift;
+		shadow_t *shadow = &table->array[(addr & MASK16BIT) >> shift];
+		size_t count = n >> shift;
+		for (size_t i = 0; i < count; ) {
+			unsigned int run = shadow_run(shadow + i, count - i);
+			raceCheckWriteRun(thread, (void *)(addr + (i << shift)), shadow + i, run, shift, currClock);
+			i += run;
+		}
+		addr += n;
+		size -= n;
+	}
 }
 
 /** This function does race detection on a read for an expanded record. */
-void fullRaceCheckRead(thread_id_t thread, const void *location, uint64_t *shadow, ClockVector *currClock)
+void fullRaceCheckRead(thread_id_t thread, const void *location, shadow_t *shadow, ClockVector *currClock)
 {
-	struct RaceRecord *record = (struct RaceRecord *) (*shadow);
+	struct RaceRecord *record = shadow_record(*shadow);
 
 	/* Check for datarace against last write. */
 
@@ -292,7 +767,7 @@ void fullRaceCheckRead(thread_id_t thread, const void *location, uint64_t *shado
 	}
 
 	if (copytoindex >= record->capacity) {
-		int newCapacity = record->capacity * 2;
+		int newCapacity = record->capacity ? record->capacity * 2 : INITCAPACITY;
 		thread_id_t *newthread = (thread_id_t *)snapshot_malloc(sizeof(thread_id_t) * newCapacity);
 		modelclock_t *newreadClock = (modelclock_t *)snapshot_malloc(sizeof(modelclock_t) * newCapacity);
 		std::memcpy(newthread, record->thread, record->capacity * sizeof(thread_id_t));
@@ -311,16 +786,20 @@ void fullRaceCheckRead(thread_id_t thread, const void *location, uint64_t *shado
 	record->numReads = copytoindex + 1;
 }
 
-/** This function does race detection on a read. */
-void raceCheckRead(thread_id_t thread, const void *location)
+/**
+ * @brief Race check a read against a run of identical shadow words
+ * @see raceCheckWriteRun()
+ */
+static void raceCheckReadRun(thread_id_t thread, const void *location, shadow_t *shadow, unsigned int count, unsigned int shift, ClockVector *currClock)
 {
-	uint64_t *shadow = lookupAddressEntry(location);
-	uint64_t shadowval = *shadow;
-	ClockVector *currClock = get_execution()->get_cv(thread);
+	shadow_t shadowval = *shadow;
+
+	num_read_checks += count << shift;
 
 	/* Do full record */
-	if (shadowval != 0 && !ISSHORTRECORD(shadowval)) {
-		fullRaceCheckRead(thread, location, shadow, currClock);
+	if (shadow_is_expanded(shadowval)) {
+		for (unsigned int i = 0; i < count; i++)
+			fullRaceCheckRead(thread, ((const char *)location) + (i << shift), shadow + i, currClock);
 		return;
 	}
 
@@ -329,35 +808,89 @@ void raceCheckRead(thread_id_t thread, const void *location)
 
 	/* Thread ID is too large or clock is too large. */
 	if (threadid > MAXTHREADID || ourClock > MAXWRITEVECTOR) {
-		expandRecord(shadow);
-		fullRaceCheckRead(thread, location, shadow, currClock);
+		for (unsigned int i = 0; i < count; i++) {
+			expandRecord(shadow + i);
+			fullRaceCheckRead(thread, ((const char *)location) + (i << shift), shadow + i, currClock);
+		}
 		return;
 	}
 
 	/* Check for datarace against last write. */
 
-	modelclock_t writeClock = WRITEVECTOR(shadowval);
-	thread_id_t writeThread = int_to_id(WRTHREADID(shadowval));
+	modelclock_t writeClock = shadow_write_clock(shadowval);
+	thread_id_t writeThread = int_to_id(shadow_write_thread(shadowval));
 
 	if (clock_may_race(currClock, thread, writeClock, writeThread)) {
 		/* We have a datarace */
 		reportDataRace(writeThread, writeClock, true, get_execution()->get_parent_action(thread), false, location);
 	}
 
-	modelclock_t readClock = READVECTOR(shadowval);
-	thread_id_t readThread = int_to_id(RDTHREADID(shadowval));
+	modelclock_t readClock = shadow_read_clock(shadowval);
+	thread_id_t readThread = int_to_id(shadow_read_thread(shadowval));
 
 	if (clock_may_race(currClock, thread, readClock, readThread)) {
 		/* We don't subsume this read... Have to expand record. */
-		expandRecord(shadow);
-		fullRaceCheckRead(thread, location, shadow, currClock);
+		for (unsigned int i = 0; i < count; i++) {
+			expandRecord(shadow + i);
+			fullRaceCheckRead(thread, ((const char *)location) + (i << shift), shadow + i, currClock);
+		}
 		return;
 	}
 
-	*shadow = ENCODEOP(threadid, ourClock, id_to_int(writeThread), writeClock);
+	shadow_set(shadow, threadid, ourClock, id_to_int(writeThread), writeClock);
+	shadow_fill(shadow, count);
+}
+
+/** This function does race detection on a read. */
+void raceCheckRead(thread_id_t thread, const void *location)
+{
+	raceCheckReadRange(thread, location, 1);
+}
+
+/**
+ * @brief Race check a read of a range of bytes
+ * @see raceCheckWriteRange()
+ */
+void raceCheckReadRange(thread_id_t thread, const void *location, size_t size)
+{
+	ClockVector *currClock = get_execution()->get_cv(thread);
+	uintptr_t addr = (uintptr_t)location;
+
+	while (size > 0) {
+		size_t n = MASK16BIT + 1 - (addr & MASK16BIT);
+		if (n > size)
+			n = size;
+		struct ShadowBaseTable *table = lookupBaseTable(thread, (const void *)addr, access_shift(addr, n));
+		unsigned int shift = table->shift;
+		shadow_t *shadow = &table->array[(addr & MASK16BIT) >> shift];
+		size_t count = n >> shift;
+		for (size_t i = 0; i < count; ) {
+			unsigned int run = shadow_run(shadow + i, count - i);
+			raceCheckReadRun(thread, (const void *)(addr + (i << shift)), shadow + i, run, shift, currClock);
+			i += run;
+		}
+		addr += n;
+		size -= n;
+	}
 }
 
 bool haveUnrealizedRaces()
 {
-	return !unrealizedraces->empty();
+	return unrealizedraces->count != 0;
+}
+
+/** @brief Print the race detector's statistics, summed over all executions */
+void printRaceStats()
+{
+	model_print("Race checks:       %" PRIu64 " reads, %" PRIu64 " writes\n",
+			num_read_checks, num_write_checks);
+	model_print("Expanded records:  %" PRIu64 " (%s shadow)\n",
+			num_expanded_records, WIDE_SHADOW ? "128-bit" : "64-bit");
+	model_print("Races reported:    %" PRIu64 " (%" PRIu64 " merged, %" PRIu64 " pruned early)\n",
+			num_races_reported, num_races_merged, num_races_pruned);
+	uint64_t lookups = num_cache_hits + num_cache_misses;
+	model_print("Shadow tables:     %" PRIu64 " allocated (%" PRIu64 " KiB), %" PRIu64 " split\n",
+			num_tables, table_bytes >> 10, num_table_splits);
+	model_print("Shadow cache hits: %" PRIu64 " of %" PRIu64 " lookups (%.1f%%)\n",
+			num_cache_hits, lookups, lookups ? 100.0 * num_cache_hits / lookups : 0.0);
 }
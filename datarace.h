@@ -7,6 +7,7 @@
 
 #include "config.h"
 #include <stdint.h>
+#include <stddef.h>
 #include "modeltypes.h"
 
 /* Forward declaration */
@@ -16,10 +17,41 @@ struct ShadowTable {
 	void * array[65536];
 };
 
+#if WIDE_SHADOW
+/** @brief A shadow word in the wide encoding; see ENCODEACCESS */
+struct ShadowWord {
+	uint64_t read;
+	uint64_t write;
+};
+typedef struct ShadowWord shadow_t;
+#else
+typedef uint64_t shadow_t;
+#endif
+
+/**
+ * @brief The shadow words for one 64 KiB region of memory
+ *
+ * Each shadow word covers (1 << shift) bytes, all of which have the same
+ * access history. With ADAPTIVE_SHADOW, a region starts out with one word
+ * per aligned 8 bytes and is only split into a finer table when an access
+ * does not fit; see lookupBaseTable().
+ */
 struct ShadowBaseTable {
-	uint64_t array[65536];
+	unsigned int shift;
+	shadow_t array[];
 };
 
+/** The number of shadow words in a base table of a given granularity */
+#define SHADOWWORDS(shift) (65536U >> (shift))
+/** The size of a base table of a given granularity */
+#define SHADOWBASETABLEBYTES(shift) (sizeof(struct ShadowBaseTable) + sizeof(shadow_t) * SHADOWWORDS(shift))
+
+#if ADAPTIVE_SHADOW
+#define SHADOWINITIALSHIFT 3
+#else
+#define SHADOWINITIALSHIFT 0
+#endif
+
 struct DataRace {
 	/* Clock and thread associated with first action.  This won't change in
 		 response to synchronization. */
@@ -42,11 +74,16 @@ struct DataRace {
 #define MASK16BIT 0xffff
 
 void initRaceDetector();
+void flushShadowCache();
 void raceCheckWrite(thread_id_t thread, void *location);
 void raceCheckRead(thread_id_t thread, const void *location);
+void raceCheckWriteRange(thread_id_t thread, void *location, size_t size);
+void raceCheckReadRange(thread_id_t thread, const void *location, size_t size);
 bool checkDataRaces();
+void pruneDataRaces(thread_id_t tid);
 void assert_race(struct DataRace *race);
 bool haveUnrealizedRaces();
+void printRaceStats();
 
 /**
  * @brief A record of information for detecting data races
@@ -62,6 +99,30 @@ struct RaceRecord {
 
 #define INITCAPACITY 4
 
+#if WIDE_SHADOW
+
+#define THREADMASK 0xffff
+#define CLOCKMASK 0xffffffffffffULL
+
+/**
+ * In the wide encoding, each shadow word is a pair of 64-bit words, one for
+ * the last read and one for the last write. Each holds a thread ID in its
+ * low 16 bits and a clock in the remaining 48 bits; a zero clock means no
+ * access. An expanded shadow word holds a pointer to its RaceRecord in the
+ * read word and EXPANDEDRECORD, which is not a valid access, in the write
+ * word.
+ */
+#define ENCODEACCESS(thread, time) (((uint64_t)(thread)) | (((uint64_t)(time)) << 16))
+#define ACCESSTHREADID(x) ((x)&THREADMASK)
+#define ACCESSVECTOR(x) (((x)>>16)&CLOCKMASK)
+#define EXPANDEDRECORD (~0ULL)
+
+#define MAXTHREADID (THREADMASK-1)
+#define MAXREADVECTOR (CLOCKMASK-1)
+#define MAXWRITEVECTOR (CLOCKMASK-1)
+
+#else /* !WIDE_SHADOW */
+
 #define ISSHORTRECORD(x) ((x)&0x1)
 
 #define THREADMASK 0xff
@@ -91,4 +152,6 @@ struct RaceRecord {
 #define MAXREADVECTOR (READMASK-1)
 #define MAXWRITEVECTOR (WRITEMASK-1)
 
+#endif /* !WIDE_SHADOW */
+
 #endif /* __DATARACE_H__ */
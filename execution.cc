@@ -16,6 +16,7 @@
 #include "datarace.h"
 #include "threads-model.h"
 #include "bugmessage.h"
+#include "statecache.h"
 
 #define INITIAL_THREAD_ID	0
 
@@ -73,11 +74,13 @@ ModelExecution::ModelExecution(ModelChecker *m,
 	obj_map(),
 	condvar_waiters_map(),
 	obj_thrd_map(),
+	action_index(),
 	promises(),
 	futurevalues(),
 	pending_rel_seqs(),
 	thrd_last_action(1),
 	thrd_last_fence_release(),
+	thrd_state_hash(),
 	node_stack(node_stack),
 	priv(new struct model_snapshot_members()),
 	mo_graph(new CycleGraph())
@@ -107,7 +110,7 @@ int ModelExecution::get_execution_number() const
 	return model->get_execution_number();
 }
 
-static action_list_t * get_safe_ptr_action(HashTable<const void *, action_list_t *, uintptr_t, 4> * hash, void * ptr)
+static action_list_t * get_safe_ptr_action(SwissTable<const void *, action_list_t *, uintptr_t, 4> * hash, void * ptr)
 {
 	action_list_t *tmp = hash->get(ptr);
 	if (tmp == NULL) {
@@ -117,7 +120,7 @@ static action_list_t * get_safe_ptr_action(HashTable<const void *, action_list_t
 	return tmp;
 }
 
-static SnapVector<action_list_t> * get_safe_ptr_vect_action(HashTable<void *, SnapVector<action_list_t> *, uintptr_t, 4> * hash, void * ptr)
+static SnapVector<action_list_t> * get_safe_ptr_vect_action(SwissTable<void *, SnapVector<action_list_t> *, uintptr_t, 4> * hash, void * ptr)
 {
 	SnapVector<action_list_t> *tmp = hash->get(ptr);
 	if (tmp == NULL) {
@@ -127,6 +130,35 @@ static SnapVector<action_list_t> * get_safe_ptr_vect_action(HashTable<void *, Sn
 	return tmp;
 }
 
+/** @return The later of two actions, either of which may be NULL */
+static const ModelAction * later_action(const ModelAction *a, const ModelAction *b)
+{
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	return *a < *b ? b : a;
+}
+
+/**
+ * @brief Find the last write in a list sequenced before @a bound, other than
+ * @a curr and @a rf
+ * @return The write, or NULL if there is none (or @a bound is NULL)
+ */
+template <typename T>
+static const ModelAction * last_write_before(const SnapVector<ModelAction *> *writes,
+		const ModelAction *bound, const ModelAction *curr, const T *rf)
+{
+	if (!bound)
+		return NULL;
+	for (int i = LocationIndex::last_before(writes, bound); i >= 0; i--) {
+		const ModelAction *act = (*writes)[i];
+		if (act != curr && !act->equals(rf))
+			return act;
+	}
+	return NULL;
+}
+
 action_list_t * ModelExecution::get_actions_on_obj(void * obj, thread_id_t tid) const
 {
 	SnapVector<action_list_t> *wrv = obj_thrd_map.get(obj);
@@ -344,10 +376,14 @@ ModelAction * ModelExecution::get_last_fence_conflict(ModelAction *act) const
 	/* Skip past the release */
 	const action_list_t *list = &action_trace;
 	action_list_t::const_reverse_iterator rit;
-	for (rit = list->rbegin(); rit != list->rend(); rit++)
-		if (*rit == last_release)
-			break;
-	ASSERT(rit != list->rend());
+	if (last_release == act) {
+		/* act follows the whole trace (it may not be in it yet; see
+		 * backtrack_summary()) */
+		rit = list->rbegin();
+	} else {
+		rit = list->rfind(last_release);
+		ASSERT(rit != list->rend());
+	}
 
 	/* Find a prior:
 	 *   load-acquire
@@ -387,6 +423,26 @@ ModelAction * ModelExecution::get_last_fence_conflict(ModelAction *act) const
 	return latest_backtrack;
 }
 
+/**
+ * @brief Find the most recent action which could synchronize with @a act
+ * @param list A list of candidate actions, in sequence order
+ * @param act The action
+ * @param ret The most recent such action found so far, if any
+ * @return The later of @a ret and the last action in @a list sequenced before
+ * @a act which could synchronize with @a act
+ */
+static ModelAction * last_conflict_before(const SnapVector<ModelAction *> *list, ModelAction *act, ModelAction *ret)
+{
+	for (int i = LocationIndex::last_before(list, act); i >= 0; i--) {
+		ModelAction *prev = (*list)[i];
+		if (ret && *prev < *ret)
+			break;
+		if (prev->could_synchronize_with(act))
+			return prev;
+	}
+	return ret;
+}
+
 /**
  * @brief Find the last backtracking conflict for a ModelAction
  *
@@ -410,17 +466,27 @@ ModelAction * ModelExecution::get_last_conflict(ModelAction *act) const
 	case ATOMIC_RMW: {
 		ModelAction *ret = NULL;
 
-		/* linear search: from most recent to oldest */
-		action_list_t *list = obj_map.get(act->get_location());
-		action_list_t::reverse_iterator rit;
-		for (rit = list->rbegin(); rit != list->rend(); rit++) {
-			ModelAction *prev = *rit;
-			if (prev == act)
+		/*
+		 * Only seq_cst fences can synchronize with a seq_cst fence, only
+		 * seq_cst writes with a seq_cst access, and only acquire reads
+		 * with a release write (see
+		 * ModelAction::could_synchronize_with()); find the most recent
+		 * such action in any other thread
+		 */
+		void *location = act->get_location();
+		bool release = act->could_be_write() && act->is_release();
+		for (unsigned int i = 0; i < action_index.get_num_threads(location); i++) {
+			if (int_to_id(i) == act->get_tid())
+				continue;
+			const struct thread_history *history = action_index.get_history(location, int_to_id(i));
+			if (act->is_fence()) {
+				ret = last_conflict_before(&history->sc_fences, act, ret);
 				continue;
-			if (prev->could_synchronize_with(act)) {
-				ret = prev;
-				break;
 			}
+			if (act->is_seqcst())
+				ret = last_conflict_before(&history->sc_writes, act, ret);
+			if (release)
+				ret = last_conflict_before(&history->acquire_reads, act, ret);
 		}
 
 		ModelAction *ret2 = get_last_fence_conflict(act);
@@ -494,16 +560,25 @@ ModelAction * ModelExecution::get_last_conflict(ModelAction *act) const
  */
 void ModelExecution::set_backtracking(ModelAction *act)
 {
-	Thread *t = get_thread(act);
 	ModelAction *prev = get_last_conflict(act);
 	if (prev == NULL)
 		return;
+	add_backtracking(prev, act);
+}
 
+/**
+ * @brief Add the backtracking points which reorder two conflicting actions
+ * @param prev The earlier action
+ * @param act The later action, in a different thread (which may not exist
+ * yet at @a prev)
+ */
+void ModelExecution::add_backtracking(ModelAction *prev, ModelAction *act)
+{
 	Node *node = prev->get_node()->get_parent();
 
 	/* See Dynamic Partial Order Reduction (addendum), POPL '05 */
 	int low_tid, high_tid;
-	if (node->enabled_status(t->get_id()) == THREAD_ENABLED) {
+	if (node->enabled_status(act->get_tid()) == THREAD_ENABLED) {
 		low_tid = id_to_int(act->get_tid());
 		high_tid = low_tid + 1;
 	} else {
@@ -563,7 +638,7 @@ void ModelExecution::set_backtracking(ModelAction *act)
 			continue;
 		DEBUG("Setting backtrack: conflict = %d, instead tid = %d\n",
 					id_to_int(prev->get_tid()),
-					id_to_int(t->get_id()));
+					id_to_int(act->get_tid()));
 		if (DBG_ENABLED()) {
 			prev->print();
 			act->print();
@@ -603,6 +678,150 @@ ModelAction * ModelExecution::get_next_backtrack()
 	return next;
 }
 
+/**
+ * @brief Give an action an ID which does not depend on the interleaving
+ *
+ * The ID combines the action's thread with the thread's history hash just
+ * before the action, so the same action gets the same ID in every execution
+ * in which its thread has seen the same history.
+ *
+ * @param curr The action, before it is processed
+ */
+void ModelExecution::set_state_id(ModelAction *curr)
+{
+	unsigned int tid = id_to_int(curr->get_tid());
+	uint64_t hash = tid < thrd_state_hash.size() ? thrd_state_hash[tid] : 0;
+	curr->set_state_id(state_hash_combine(tid + 1, hash));
+}
+
+/**
+ * @brief Fold a processed action into its thread's history hash
+ *
+ * Besides the action itself, the hash covers the values the action observed
+ * and the action it synchronized with (the store it read from, the unlock it
+ * acquired, or the last action of the thread it joined), since together
+ * these determine the thread's local state. A release store also records
+ * which threads were asleep, since that limits what they may later read
+ * from it. Every action counts, including yields and failed trylocks: they
+ * leave shared state as it was, but the thread has still moved on to a
+ * different point in its program.
+ *
+ * @param curr The action, after it is processed
+ */
+void ModelExecution::update_state_hash(ModelAction *curr)
+{
+	unsigned int tid = id_to_int(curr->get_tid());
+	if (thrd_state_hash.size() <= tid)
+		thrd_state_hash.resize(get_num_threads());
+
+	uint64_t desc = state_hash_combine(curr->get_type(), curr->get_mo());
+	desc = state_hash_combine(desc, (uintptr_t)curr->get_location());
+	desc = state_hash_combine(desc, curr->get_return_value());
+	if (curr->is_read() && curr->is_write())
+		desc = state_hash_combine(desc, curr->get_write_value());
+
+	const ModelAction *source = NULL;
+	if (curr->is_read())
+		source = curr->get_reads_from();
+	else if (curr->is_success_lock())
+		source = get_last_unlock(curr);
+	else if (curr->is_thread_join())
+		source = get_last_action(curr->get_thread_operand()->get_id());
+	if (source)
+		desc = state_hash_combine(desc, source->get_state_id());
+
+	/* sleep_can_read_from() asks which threads slept through a release */
+	if (curr->is_write() && curr->is_release()) {
+		Node *prevnode = curr->get_node()->get_parent();
+		for (int i = 0; prevnode && i < prevnode->get_num_threads(); i++)
+			if (prevnode->enabled_status(int_to_id(i)) == THREAD_SLEEP_SET)
+				desc = state_hash_combine(desc, i + 1);
+	}
+
+	thrd_state_hash[tid] = state_hash_combine(thrd_state_hash[tid], desc);
+}
+
+/**
+ * @brief Compute a fingerprint of the current execution state
+ *
+ * Two prefixes with the same fingerprint have (up to hash collisions) the same
+ * thread histories, the same modification-order constraints, the same sleep
+ * set and the same thread to schedule next (which decides the interleavings
+ * DPOR explores below the state), so the executions that can extend them are
+ * the same. The per-thread histories stand in for the threads' clock vectors,
+ * which are derived from the same reads-from and synchronization edges, and
+ * for the contents of the user's heap, which in a race-free program are
+ * determined by those histories.
+ *
+ * States involving promises, future values or unresolved release sequences
+ * can still be changed by later actions, so they get no fingerprint.
+ *
+ * @return The fingerprint (never 0), or 0 if the state cannot be fingerprinted
+ */
+uint64_t ModelExecution::get_state_fingerprint() const
+{
+	if (!isfeasibleprefix() || !promises.empty() || !futurevalues.empty() ||
+			!pending_rel_seqs.empty())
+		return 0;
+
+	uint64_t fingerprint = mo_graph->getEdgeHash();
+	for (unsigned int i = 0; i < get_num_threads(); i++) {
+		uint64_t hash = i < thrd_state_hash.size() ? thrd_state_hash[i] : 0;
+		fingerprint = state_hash_combine(fingerprint, hash);
+		fingerprint = state_hash_combine(fingerprint,
+				scheduler->is_sleep_set(get_thread(int_to_id(i))));
+	}
+	fingerprint = state_hash_combine(fingerprint,
+			id_to_int(scheduler->get_scheduler_thread()));
+	return fingerprint ? fingerprint : 1;
+}
+
+/**
+ * @brief Add the backtracking points that an explored subtree would have
+ * added, had the current execution continued into it
+ *
+ * Each operation reached below the state is treated as if its thread took it
+ * right after the current action, and checked for conflicts against the
+ * current path just as set_backtracking() does; each write also sends its
+ * value to the reads on the current path which could read from it.
+ *
+ * @param ops The operations reached below the state the execution has
+ * reached (see StateCache)
+ */
+void ModelExecution::backtrack_summary(const state_summary_t *ops)
+{
+	for (unsigned int i = 0; i < ops->size(); i++) {
+		const struct state_op *op = &(*ops)[i];
+		/* Nothing on the current path touched the location */
+		if (op->location && !obj_map.get(op->location))
+			continue;
+
+		ModelAction probe(op->type, op->order, op->location, op->value, model_thread);
+		probe.set_tid(op->tid);
+		probe.set_seq_number(priv->used_sequence_numbers + 1);
+		ModelAction *prev = get_last_conflict(&probe);
+		if (prev)
+			add_backtracking(prev, &probe);
+
+		if (!probe.is_write())
+			continue;
+		/*
+		 * Send the value to the reads the write could have sent it to
+		 * (see w_modification_order()); mo_may_allow() needs the write
+		 * itself, so a few of these may be infeasible
+		 */
+		action_list_t *list = obj_map.get(op->location);
+		ModelAction *last = get_last_action(op->tid);
+		for (action_list_t::reverse_iterator rit = list->rbegin(); rit != list->rend(); rit++) {
+			ModelAction *act = *rit;
+			if (act->is_read() && !act->same_thread(&probe) &&
+					!act->could_synchronize_with(&probe) &&
+					!(last && act->happens_before(last)))
+				send_future_value(&probe, act);
+		}
+	}
+}
+
 /**
  * Processes a read model action.
  * @param curr is the read model action to process.
@@ -751,7 +970,7 @@ bool ModelExecution::process_mutex(ModelAction *curr)
 		action_list_t *waiters = get_safe_ptr_action(&condvar_waiters_map, curr->get_location());
 		int wakeupthread = curr->get_node()->get_misc();
 		action_list_t::iterator it = waiters->begin();
-		advance(it, wakeupthread);
+		std::advance(it, wakeupthread);
 		scheduler->wake(get_thread(*it));
 		waiters->erase(it);
 		break;
@@ -807,7 +1026,17 @@ void ModelExecution::add_future_value(const ModelAction *writer, ModelAction *re
 	/* Do more ambitious checks now that mo is more complete */
 	if (!mo_may_allow(writer, reader))
 		return;
+	send_future_value(writer, reader);
+}
 
+/**
+ * @brief Offer a write's value to a read's Node as a future value, without
+ * checking modification order
+ * @param writer The operation whose value is sent. Must be a write.
+ * @param reader The read operation which may read the future value. Must be a read.
+ */
+void ModelExecution::send_future_value(const ModelAction *writer, ModelAction *reader)
+{
 	Node *node = reader->get_node();
 
 	/* Find an ancestor thread which exists at the time of the reader */
@@ -820,8 +1049,11 @@ void ModelExecution::add_future_value(const ModelAction *writer, ModelAction *re
 		writer->get_seq_number() + params->maxfuturedelay,
 		write_thread->get_id(),
 	};
-	if (node->add_future_value(fv))
+	if (node->add_future_value(fv)) {
 		set_latest_backtrack(reader);
+		if (params->prunestates)
+			model->get_state_cache()->touch(node_stack->get_index(node));
+	}
 }
 
 /**
@@ -1168,8 +1400,15 @@ bool ModelExecution::synchronize(const ModelAction *first, ModelAction *second)
 		set_bad_synchronization();
 		return false;
 	}
+	/* @a second already knows everything @a first does: nothing to update */
+	if (second->get_cv()->dominates(first->get_cv()))
+		return true;
 	check_promises(first->get_tid(), second->get_cv(), first->get_cv());
-	return second->synchronize_with(first);
+	if (!second->synchronize_with(first))
+		return false;
+	/* The new clock vector may order a pending race */
+	pruneDataRaces(second->get_tid());
+	return true;
 }
 
 /**
@@ -1247,9 +1486,16 @@ ModelAction * ModelExecution::check_current_action(ModelAction *curr)
 	ASSERT(curr);
 	bool second_part_of_rmw = curr->is_rmwc() || curr->is_rmw();
 	bool newly_explored = initialize_curr_action(&curr);
+	bool replayed = !newly_explored && node_stack->in_replay_prefix();
 
 	DBG();
 
+	if (second_part_of_rmw)
+		action_index.add_rmw(curr);
+
+	if (params->prunestates && !second_part_of_rmw)
+		set_state_id(curr);
+
 	wake_up_sleeping_actions(curr);
 
 	/* Compute fairness information for CHESS yield algorithm */
@@ -1343,7 +1589,20 @@ ModelAction * ModelExecution::check_current_action(ModelAction *curr)
 	}
 
 	check_curr_backtracking(curr);
-	set_backtracking(curr);
+	/*
+	 * An action replayed strictly before the divergence point saw exactly
+	 * the same prefix in the execution that recorded it, so any
+	 * backtracking points it could add have already been added (and
+	 * check_curr_backtracking() has found those still unexplored)
+	 */
+	if (!replayed) {
+		set_backtracking(curr);
+		if (params->prunestates)
+			model->get_state_cache()->record(curr);
+	}
+
+	if (params->prunestates)
+		update_state_hash(curr);
 	return curr;
 }
 
@@ -1596,62 +1855,57 @@ bool ModelExecution::r_modification_order(ModelAction *curr, const rf_type *rf)
 		if (last_sc_fence_local)
 			last_sc_fence_thread_before = get_last_seq_cst_fence(int_to_id(i), last_sc_fence_local);
 
-		/* Iterate over actions in thread, starting from most recent */
-		action_list_t *list = &(*thrd_lists)[i];
-		action_list_t::reverse_iterator rit;
-		for (rit = list->rbegin(); rit != list->rend(); rit++) {
-			ModelAction *act = *rit;
+		const struct thread_history *history = action_index.get_history(curr->get_location(), int_to_id(i));
+		if (!history)
+			continue;
 
-			/* Skip curr */
-			if (act == curr)
-				continue;
-			/* Don't want to add reflexive edges on 'rf' */
-			if (act->equals(rf)) {
-				if (act->happens_before(curr))
-					break;
-				else
-					continue;
-			}
+		/*
+		 * Include at most one act per-thread that "happens before"
+		 * curr: the most recent one, skipping curr itself
+		 */
+		ModelAction *act = NULL;
+		int idx = LocationIndex::last_happens_before(&history->actions, curr);
+		if (idx >= 0 && history->actions[idx] == curr)
+			idx--;
+		if (idx >= 0)
+			act = history->actions[idx];
 
-			if (act->is_write()) {
-				/* C++, Section 29.3 statement 5 */
-				if (curr->is_seqcst() && last_sc_fence_thread_local &&
-						*act < *last_sc_fence_thread_local) {
-					added = mo_graph->addEdge(act, rf) || added;
-					break;
-				}
-				/* C++, Section 29.3 statement 4 */
-				else if (act->is_seqcst() && last_sc_fence_local &&
-						*act < *last_sc_fence_local) {
-					added = mo_graph->addEdge(act, rf) || added;
-					break;
-				}
-				/* C++, Section 29.3 statement 6 */
-				else if (last_sc_fence_thread_before &&
-						*act < *last_sc_fence_thread_before) {
-					added = mo_graph->addEdge(act, rf) || added;
-					break;
-				}
-			}
+		/*
+		 * The most recent write (other than rf) which an SC fence orders
+		 * before rf:
+		 *  - C++, Section 29.3 statement 5 (thread i's last SC fence, if
+		 *    curr is seq_cst)
+		 *  - C++, Section 29.3 statement 4 (seq_cst writes before the
+		 *    current thread's last SC fence)
+		 *  - C++, Section 29.3 statement 6 (thread i's last SC fence
+		 *    before the current thread's)
+		 */
+		const ModelAction *fence = curr->is_seqcst() ? last_sc_fence_thread_local : NULL;
+		fence = later_action(fence, last_sc_fence_thread_before);
+		const ModelAction *fenced = last_write_before(&history->writes, fence, curr, rf);
+		fenced = later_action(fenced, last_write_before(&history->sc_writes, last_sc_fence_local, curr, rf));
 
-			/*
-			 * Include at most one act per-thread that "happens
-			 * before" curr
-			 */
-			if (act->happens_before(curr)) {
-				if (act->is_write()) {
-					added = mo_graph->addEdge(act, rf) || added;
-				} else {
-					const ModelAction *prevrf = act->get_reads_from();
-					const Promise *prevrf_promise = act->get_reads_from_promise();
-					if (prevrf) {
-						if (!prevrf->equals(rf))
-							added = mo_graph->addEdge(prevrf, rf) || added;
-					} else if (!prevrf_promise->equals(rf)) {
-						added = mo_graph->addEdge(prevrf_promise, rf) || added;
-					}
-				}
-				break;
+		if (fenced && (!act || *act < *fenced)) {
+			added = mo_graph->addEdge(fenced, rf) || added;
+			continue;
+		}
+		if (!act)
+			continue;
+
+		/* Don't want to add reflexive edges on 'rf' */
+		if (act->equals(rf))
+			continue;
+
+		if (act->is_write()) {
+			added = mo_graph->addEdge(act, rf) || added;
+		} else {
+			const ModelAction *prevrf = act->get_reads_from();
+			const Promise *prevrf_promise = act->get_reads_from_promise();
+			if (prevrf) {
+				if (!prevrf->equals(rf))
+					added = mo_graph->addEdge(prevrf, rf) || added;
+			} else if (!prevrf_promise->equals(rf)) {
+				added = mo_graph->addEdge(prevrf_promise, rf) || added;
 			}
 		}
 	}
@@ -1717,62 +1971,40 @@ bool ModelExecution::w_modification_order(ModelAction *curr, ModelVector<ModelAc
 		if (last_sc_fence_local && int_to_id((int)i) != curr->get_tid())
 			last_sc_fence_thread_before = get_last_seq_cst_fence(int_to_id(i), last_sc_fence_local);
 
-		/* Iterate over actions in thread, starting from most recent */
-		action_list_t *list = &(*thrd_lists)[i];
-		action_list_t::reverse_iterator rit;
-		for (rit = list->rbegin(); rit != list->rend(); rit++) {
-			ModelAction *act = *rit;
-			if (act == curr) {
-				/*
-				 * 1) If RMW and it actually read from something, then we
-				 * already have all relevant edges, so just skip to next
-				 * thread.
-				 *
-				 * 2) If RMW and it didn't read from anything, we should
-				 * whatever edge we can get to speed up convergence.
-				 *
-				 * 3) If normal write, we need to look at earlier actions, so
-				 * continue processing list.
-				 */
-				if (curr->is_rmw()) {
-					if (curr->get_reads_from() != NULL)
-						break;
-					else
-						continue;
-				} else
-					continue;
-			}
+		const struct thread_history *history = action_index.get_history(curr->get_location(), int_to_id(i));
+		if (!history)
+			continue;
+		const SnapVector<ModelAction *> *list = &history->actions;
 
-			/* C++, Section 29.3 statement 7 */
-			if (last_sc_fence_thread_before && act->is_write() &&
-					*act < *last_sc_fence_thread_before) {
-				added = mo_graph->addEdge(act, curr) || added;
-				break;
-			}
+		/*
+		 * If RMW and it actually read from something, then we already
+		 * have all relevant edges from this thread. (If RMW and it didn't
+		 * read from anything, we should get whatever edge we can to speed
+		 * up convergence.)
+		 */
+		if (int_to_id((int)i) == curr->get_tid() && curr->is_rmw() && curr->get_reads_from() != NULL)
+			continue;
 
-			/*
-			 * Include at most one act per-thread that "happens
-			 * before" curr
-			 */
-			if (act->happens_before(curr)) {
-				/*
-				 * Note: if act is RMW, just add edge:
-				 *   act --mo--> curr
-				 * The following edge should be handled elsewhere:
-				 *   readfrom(act) --mo--> act
-				 */
-				if (act->is_write())
-					added = mo_graph->addEdge(act, curr) || added;
-				else if (act->is_read()) {
-					//if previous read accessed a null, just keep going
-					if (act->get_reads_from() == NULL) {
-						added = mo_graph->addEdge(act->get_reads_from_promise(), curr) || added;
-					} else
-						added = mo_graph->addEdge(act->get_reads_from(), curr) || added;
-				}
-				break;
-			} else if (act->is_read() && !act->could_synchronize_with(curr) &&
-			                             !act->same_thread(curr)) {
+		/*
+		 * Include at most one act per-thread that "happens before"
+		 * curr: the most recent one, skipping curr itself
+		 */
+		int idx = LocationIndex::last_happens_before(list, curr);
+		if (idx >= 0 && (*list)[idx] == curr)
+			idx--;
+
+		/* C++, Section 29.3 statement 7 */
+		const ModelAction *fenced = last_write_before(&history->writes, last_sc_fence_thread_before, curr, curr);
+		if (fenced && (idx < 0 || *(*list)[idx] < *fenced))
+			idx = LocationIndex::position(list, fenced);
+		else
+			fenced = NULL;
+
+		/* Scan the more recent actions, which do not happen before curr */
+		for (int j = (int)list->size() - 1; send_fv && j > idx; j--) {
+			ModelAction *act = (*list)[j];
+			if (act->is_read() && !act->could_synchronize_with(curr) &&
+			                      !act->same_thread(curr)) {
 				/* We have an action that:
 				   (1) did not happen before us
 				   (2) is a read and we are a write
@@ -1786,7 +2018,7 @@ bool ModelExecution::w_modification_order(ModelAction *curr, ModelVector<ModelAc
 
 				 */
 
-				if (send_fv && thin_air_constraint_may_allow(curr, act) && check_coherence_promise(curr, act)) {
+				if (thin_air_constraint_may_allow(curr, act) && check_coherence_promise(curr, act)) {
 					if (!is_infeasible())
 						send_fv->push_back(act);
 					else if (curr->is_rmw() && act->is_rmw() && curr->get_reads_from() && curr->get_reads_from() == act->get_reads_from())
@@ -1794,6 +2026,27 @@ bool ModelExecution::w_modification_order(ModelAction *curr, ModelVector<ModelAc
 				}
 			}
 		}
+
+		if (fenced) {
+			added = mo_graph->addEdge(fenced, curr) || added;
+		} else if (idx >= 0) {
+			ModelAction *act = (*list)[idx];
+			/*
+			 * Note: if act is RMW, just add edge:
+			 *   act --mo--> curr
+			 * The following edge should be handled elsewhere:
+			 *   readfrom(act) --mo--> act
+			 */
+			if (act->is_write())
+				added = mo_graph->addEdge(act, curr) || added;
+			else if (act->is_read()) {
+				//if previous read accessed a null, just keep going
+				if (act->get_reads_from() == NULL) {
+					added = mo_graph->addEdge(act->get_reads_from_promise(), curr) || added;
+				} else
+					added = mo_graph->addEdge(act->get_reads_from(), curr) || added;
+			}
+		}
 	}
 
 	/*
@@ -1890,19 +2143,25 @@ bool ModelExecution::mo_may_allow(const ModelAction *writer, const ModelAction *
 	for (i = 0; i < thrd_lists->size(); i++) {
 		const ModelAction *write_after_read = NULL;
 
-		/* Iterate over actions in thread, starting from most recent */
-		action_list_t *list = &(*thrd_lists)[i];
-		action_list_t::reverse_iterator rit;
-		for (rit = list->rbegin(); rit != list->rend(); rit++) {
-			ModelAction *act = *rit;
+		const struct thread_history *history = action_index.get_history(reader->get_location(), int_to_id(i));
+		if (!history)
+			continue;
 
-			/* Don't disallow due to act == reader */
-			if (!reader->happens_before(act) || reader == act)
-				break;
-			else if (act->is_write())
+		/*
+		 * Find the earliest write (or read's write) among the actions
+		 * that reader happens before, not counting reader itself
+		 */
+		const SnapVector<ModelAction *> *list = &history->actions;
+		for (int j = LocationIndex::first_happens_after(list, reader); j < (int)list->size(); j++) {
+			ModelAction *act = (*list)[j];
+			if (act == reader)
+				continue;
+			if (act->is_write())
 				write_after_read = act;
 			else if (act->is_read() && act->get_reads_from() != NULL)
 				write_after_read = act->get_reads_from();
+			if (write_after_read)
+				break;
 		}
 
 		if (write_after_read && write_after_read != writer && mo_graph->checkReachable(write_after_read, writer))
@@ -2229,6 +2488,10 @@ void ModelExecution::add_action_to_lists(ModelAction *act)
 	if (uninit)
 		(*vec)[uninit_id].push_front(uninit);
 
+	if (uninit)
+		action_index.add_action(uninit);
+	action_index.add_action(act);
+
 	if ((int)thrd_last_action.size() <= tid)
 		thrd_last_action.resize(get_num_threads());
 	thrd_last_action[tid] = act;
@@ -2291,16 +2554,15 @@ ModelAction * ModelExecution::get_last_fence_release(thread_id_t tid) const
 ModelAction * ModelExecution::get_last_seq_cst_write(ModelAction *curr) const
 {
 	void *location = curr->get_location();
-	action_list_t *list = obj_map.get(location);
 	/* Find: max({i in dom(S) | seq_cst(t_i) && isWrite(t_i) && samevar(t_i, t)}) */
-	action_list_t::reverse_iterator rit;
-	for (rit = list->rbegin(); (*rit) != curr; rit++)
-		;
-	rit++; /* Skip past curr */
-	for ( ; rit != list->rend(); rit++)
-		if ((*rit)->is_write() && (*rit)->is_seqcst())
-			return *rit;
-	return NULL;
+	ModelAction *last = NULL;
+	for (unsigned int i = 0; i < action_index.get_num_threads(location); i++) {
+		const SnapVector<ModelAction *> *writes = &action_index.get_history(location, int_to_id(i))->sc_writes;
+		int j = LocationIndex::last_before(writes, curr);
+		if (j >= 0 && (!last || *last < *(*writes)[j]))
+			last = (*writes)[j];
+	}
+	return last;
 }
 
 /**
@@ -2314,26 +2576,13 @@ ModelAction * ModelExecution::get_last_seq_cst_write(ModelAction *curr) const
 ModelAction * ModelExecution::get_last_seq_cst_fence(thread_id_t tid, const ModelAction *before_fence) const
 {
 	/* All fences should have location FENCE_LOCATION */
-	action_list_t *list = obj_map.get(FENCE_LOCATION);
-
-	if (!list)
+	const struct thread_history *history = action_index.get_history(FENCE_LOCATION, tid);
+	if (!history)
 		return NULL;
 
-	action_list_t::reverse_iterator rit = list->rbegin();
-
-	if (before_fence) {
-		for (; rit != list->rend(); rit++)
-			if (*rit == before_fence)
-				break;
-
-		ASSERT(*rit == before_fence);
-		rit++;
-	}
-
-	for (; rit != list->rend(); rit++)
-		if ((*rit)->is_fence() && (tid == (*rit)->get_tid()) && (*rit)->is_seqcst())
-			return *rit;
-	return NULL;
+	const SnapVector<ModelAction *> *fences = &history->sc_fences;
+	int i = before_fence ? LocationIndex::last_before(fences, before_fence) : (int)fences->size() - 1;
+	return i >= 0 ? (*fences)[i] : NULL;
 }
 
 /**
@@ -2409,6 +2658,12 @@ bool ModelExecution::resolve_promise(ModelAction *write, Promise *promise,
 			/* Propagate the changed clock vector */
 			propagate_clockvector(read, work);
 		}
+		if (params->prunestates) {
+			/* The read was hashed before its store was known */
+			unsigned int tid = id_to_int(read->get_tid());
+			thrd_state_hash[tid] = state_hash_combine(thrd_state_hash[tid],
+					state_hash_combine(read->get_state_id(), write->get_state_id()));
+		}
 		actions_to_check.push_back(read);
 	}
 	/* Make sure the promise's value matches the write's value */
@@ -2588,14 +2843,16 @@ void ModelExecution::build_may_read_from(ModelAction *curr)
 
 	/* Iterate over all threads */
 	for (i = 0; i < thrd_lists->size(); i++) {
-		/* Iterate over actions in thread, starting from most recent */
-		action_list_t *list = &(*thrd_lists)[i];
-		action_list_t::reverse_iterator rit;
-		for (rit = list->rbegin(); rit != list->rend(); rit++) {
-			ModelAction *act = *rit;
+		const struct thread_history *history = action_index.get_history(curr->get_location(), int_to_id(i));
+		if (!history)
+			continue;
+
+		/* Iterate over 'write' actions in thread, starting from most recent */
+		const SnapVector<ModelAction *> *writes = &history->writes;
+		for (int j = (int)writes->size() - 1; j >= 0; j--) {
+			ModelAction *act = (*writes)[j];
 
-			/* Only consider 'write' actions */
-			if (!act->is_write() || act == curr)
+			if (act == curr)
 				continue;
 
 			/* Don't consider more than one seq_cst write if we are a seq_cst read. */
@@ -2681,6 +2938,7 @@ ModelAction * ModelExecution::get_uninitialized_action(const ModelAction *curr)
 	ModelAction *act = node->get_uninit_action();
 	if (!act) {
 		act = new ModelAction(ATOMIC_UNINIT, std::memory_order_relaxed, curr->get_location(), params->uninitvalue, model_thread);
+		act->set_state_id(state_hash_mix((uintptr_t)curr->get_location()));
 		node->set_uninit_action(act);
 	}
 	act->create_cv(NULL);
@@ -9,12 +9,15 @@
 #include <inttypes.h>
 
 #include "mymemory.h"
-#include "hashtable.h"
+#include "swisstable.h"
 #include "workqueue.h"
 #include "config.h"
 #include "modeltypes.h"
 #include "stl-model.h"
 #include "params.h"
+#include "locationindex.h"
+#include "actionlist.h"
+#include "statecache.h"
 
 /* Forward declaration */
 class Node;
@@ -30,7 +33,6 @@ struct bug_message;
 
 /** @brief Shorthand for a list of release sequence heads */
 typedef ModelVector<const ModelAction *> rel_heads_list_t;
-typedef SnapList<ModelAction *> action_list_t;
 
 struct PendingFutureValue {
 	PendingFutureValue(ModelAction *writer, ModelAction *reader) :
@@ -113,6 +115,8 @@ public:
 	bool too_many_steps() const;
 
 	ModelAction * get_next_backtrack();
+	uint64_t get_state_fingerprint() const;
+	void backtrack_summary(const state_summary_t *ops);
 
 	action_list_t * get_action_trace() { return &action_trace; }
 
@@ -161,6 +165,9 @@ private:
 	ModelAction * get_last_fence_conflict(ModelAction *act) const;
 	ModelAction * get_last_conflict(ModelAction *act) const;
 	void set_backtracking(ModelAction *act);
+	void add_backtracking(ModelAction *prev, ModelAction *act);
+	void set_state_id(ModelAction *curr);
+	void update_state_hash(ModelAction *curr);
 	bool set_latest_backtrack(ModelAction *act);
 	Promise * pop_promise_to_resolve(const ModelAction *curr);
 	bool resolve_promise(ModelAction *curr, Promise *promise,
@@ -190,6 +197,7 @@ private:
 	void propagate_clockvector(ModelAction *acquire, work_queue_t *work);
 	bool resolve_release_sequences(void *location, work_queue_t *work_queue);
 	void add_future_value(const ModelAction *writer, ModelAction *reader);
+	void send_future_value(const ModelAction *writer, ModelAction *reader);
 	bool check_coherence_promise(const ModelAction *write, const ModelAction *read);
 	ModelAction * get_uninitialized_action(const ModelAction *curr) const;
 
@@ -198,13 +206,16 @@ private:
 
 	/** Per-object list of actions. Maps an object (i.e., memory location)
 	 * to a trace of all actions performed on the object. */
-	HashTable<const void *, action_list_t *, uintptr_t, 4> obj_map;
+	SwissTable<const void *, action_list_t *, uintptr_t, 4> obj_map;
 
 	/** Per-object list of actions. Maps an object (i.e., memory location)
 	 * to a trace of all actions performed on the object. */
-	HashTable<const void *, action_list_t *, uintptr_t, 4> condvar_waiters_map;
+	SwissTable<const void *, action_list_t *, uintptr_t, 4> condvar_waiters_map;
 
-	HashTable<void *, SnapVector<action_list_t> *, uintptr_t, 4> obj_thrd_map;
+	SwissTable<void *, SnapVector<action_list_t> *, uintptr_t, 4> obj_thrd_map;
+
+	/** @brief Random-access index of obj_thrd_map, for searching it */
+	LocationIndex action_index;
 
 	/**
 	 * @brief List of currently-pending promises
@@ -225,6 +236,8 @@ private:
 
 	SnapVector<ModelAction *> thrd_last_action;
 	SnapVector<ModelAction *> thrd_last_fence_release;
+	/** @brief Per-thread hash of each thread's history, for state pruning */
+	SnapVector<uint64_t> thrd_state_hash;
 	NodeStack * const node_stack;
 
 	/** A special model-checker Thread; used for associating with
@@ -6,6 +6,7 @@
 #define __LIBRACE_H__
 
 #include <stdint.h>
+#include <stddef.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -21,6 +22,11 @@ extern "C" {
 	uint32_t load_32(const void *addr);
 	uint64_t load_64(const void *addr);
 
+	/* Check a bulk access (e.g., memcpy() or memset()) of size bytes for
+	 * data races; the caller performs the access itself */
+	void store_range(void *addr, size_t size);
+	void load_range(const void *addr, size_t size);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,8 +19,7 @@ void store_16(void *addr, uint16_t val)
 {
 	DEBUG("addr = %p, val = %" PRIu16 "\n", addr, val);
 	thread_id_t tid = thread_current()->get_id();
-	raceCheckWrite(tid, addr);
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 1));
+	raceCheckWriteRange(tid, addr, 2);
 	(*(uint16_t *)addr) = val;
 }
 
@@ -28,10 +27,7 @@ void store_32(void *addr, uint32_t val)
 {
 	DEBUG("addr = %p, val = %" PRIu32 "\n", addr, val);
 	thread_id_t tid = thread_current()->get_id();
-	raceCheckWrite(tid, addr);
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 1));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 2));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 3));
+	raceCheckWriteRange(tid, addr, 4);
 	(*(uint32_t *)addr) = val;
 }
 
@@ -39,14 +35,7 @@ void store_64(void *addr, uint64_t val)
 {
 	DEBUG("addr = %p, val = %" PRIu64 "\n", addr, val);
 	thread_id_t tid = thread_current()->get_id();
-	raceCheckWrite(tid, addr);
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 1));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 2));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 3));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 4));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 5));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 6));
-	raceCheckWrite(tid, (void *)(((uintptr_t)addr) + 7));
+	raceCheckWriteRange(tid, addr, 8);
 	(*(uint64_t *)addr) = val;
 }
 
@@ -62,8 +51,7 @@ uint16_t load_16(const void *addr)
 {
 	DEBUG("addr = %p\n", addr);
 	thread_id_t tid = thread_current()->get_id();
-	raceCheckRead(tid, addr);
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 1));
+	raceCheckReadRange(tid, addr, 2);
 	return *((uint16_t *)addr);
 }
 
@@ -71,10 +59,7 @@ uint32_t load_32(const void *addr)
 {
 	DEBUG("addr = %p\n", addr);
 	thread_id_t tid = thread_current()->get_id();
-	raceCheckRead(tid, addr);
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 1));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 2));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 3));
+	raceCheckReadRange(tid, addr, 4);
 	return *((uint32_t *)addr);
 }
 
@@ -82,13 +67,20 @@ uint64_t load_64(const void *addr)
 {
 	DEBUG("addr = %p\n", addr);
 	thread_id_t tid = thread_current()->get_id();
-	raceCheckRead(tid, addr);
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 1));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 2));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 3));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 4));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 5));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 6));
-	raceCheckRead(tid, (const void *)(((uintptr_t)addr) + 7));
+	raceCheckReadRange(tid, addr, 8);
 	return *((uint64_t *)addr);
 }
+
+void store_range(void *addr, size_t size)
+{
+	DEBUG("addr = %p, size = %zu\n", addr, size);
+	thread_id_t tid = thread_current()->get_id();
+	raceCheckWriteRange(tid, addr, size);
+}
+
+void load_range(const void *addr, size_t size)
+{
+	DEBUG("addr = %p, size = %zu\n", addr, size);
+	thread_id_t tid = thread_current()->get_id();
+	raceCheckReadRange(tid, addr, size);
+}
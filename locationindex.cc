@@ -0,0 +1,141 @@
+#include "locationindex.h"
+#include "action.h"
+#include "common.h"
+#include "threads-model.h"
+
+/** @brief Constructor */
+LocationIndex::LocationIndex() :
+	map()
+{
+}
+
+/**
+ * @brief Add a new action to the end of its thread's history
+ *
+ * The first part of an RMW is not classified until the RMW completes (see
+ * LocationIndex::add_rmw()), since only then are its type and memory order
+ * known.
+ *
+ * @param act The action; must be the latest action of its thread on its
+ * location
+ */
+void LocationIndex::add_action(ModelAction *act)
+{
+	SnapVector<struct thread_history> *vec = map.get(act->get_location());
+	if (!vec) {
+		vec = new SnapVector<struct thread_history>();
+		map.put(act->get_location(), vec);
+	}
+	unsigned int tid = id_to_int(act->get_tid());
+	if (tid >= vec->size())
+		vec->resize(tid + 1);
+
+	struct thread_history *history = &(*vec)[tid];
+	history->actions.push_back(act);
+	if (!act->is_rmwr())
+		classify(history, act);
+}
+
+/**
+ * @brief Classify an RMW (or failed RMW) once its second part is processed
+ * @param act The RMW; must already have been added as an RMW read
+ */
+void LocationIndex::add_rmw(ModelAction *act)
+{
+	SnapVector<struct thread_history> *vec = map.get(act->get_location());
+	struct thread_history *history = &(*vec)[id_to_int(act->get_tid())];
+	ASSERT(history->actions.back() == act);
+	classify(history, act);
+}
+
+void LocationIndex::classify(struct thread_history *history, ModelAction *act)
+{
+	if (act->is_write()) {
+		history->writes.push_back(act);
+		if (act->is_seqcst())
+			history->sc_writes.push_back(act);
+	}
+	if (act->is_read() && act->is_acquire())
+		history->acquire_reads.push_back(act);
+	if (act->is_fence() && act->is_seqcst())
+		history->sc_fences.push_back(act);
+}
+
+/** @return The number of thread histories kept for a location */
+unsigned int LocationIndex::get_num_threads(const void *location) const
+{
+	SnapVector<struct thread_history> *vec = map.get(location);
+	return vec ? vec->size() : 0;
+}
+
+/**
+ * @return One thread's history on a location, or NULL if the thread has no
+ * actions there. Only valid until the next action is added.
+ */
+const struct thread_history * LocationIndex::get_history(const void *location, thread_id_t tid) const
+{
+	SnapVector<struct thread_history> *vec = map.get(location);
+	unsigned int i = id_to_int(tid);
+	if (!vec || i >= vec->size())
+		return NULL;
+	return &(*vec)[i];
+}
+
+/**
+ * @brief Find the last action in a thread's list which happens before @a act
+ * @return The index of the action, or -1 if there is none
+ */
+int LocationIndex::last_happens_before(const SnapVector<ModelAction *> *list, const ModelAction *act)
+{
+	int lo = 0, hi = list->size();
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if ((*list)[mid]->happens_before(act))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo - 1;
+}
+
+/**
+ * @brief Find the first action in a thread's list which @a act happens before
+ * @return The index of the action, or the length of the list if there is none
+ */
+int LocationIndex::first_happens_after(const SnapVector<ModelAction *> *list, const ModelAction *act)
+{
+	int lo = 0, hi = list->size();
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (act->happens_before((*list)[mid]))
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo;
+}
+
+/**
+ * @brief Find the last action in a list which is sequenced before @a act
+ * @return The index of the action, or -1 if there is none
+ */
+int LocationIndex::last_before(const SnapVector<ModelAction *> *list, const ModelAction *act)
+{
+	int lo = 0, hi = list->size();
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (*(*list)[mid] < *act)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo - 1;
+}
+
+/** @return The index of @a act within a list which contains it */
+int LocationIndex::position(const SnapVector<ModelAction *> *list, const ModelAction *act)
+{
+	int i = last_before(list, act) + 1;
+	ASSERT((*list)[i] == act);
+	return i;
+}
@@ -0,0 +1,63 @@
+/** @file locationindex.h
+ *  @brief Per-location, per-thread index of the actions in an execution.
+ */
+
+#ifndef __LOCATIONINDEX_H__
+#define __LOCATIONINDEX_H__
+
+#include <inttypes.h>
+
+#include "mymemory.h"
+#include "stl-model.h"
+#include "swisstable.h"
+#include "modeltypes.h"
+
+class ModelAction;
+
+/**
+ * @brief One thread's actions on one location, in sequence-number order
+ *
+ * Besides the full list, the actions are partitioned by the roles in which
+ * the model checker searches for them, so each search can binary-search a
+ * short list rather than walking every action back from the end.
+ */
+struct thread_history {
+	SnapVector<ModelAction *> actions;
+	SnapVector<ModelAction *> writes;
+	SnapVector<ModelAction *> sc_writes;
+	SnapVector<ModelAction *> acquire_reads;
+	SnapVector<ModelAction *> sc_fences;
+};
+
+/**
+ * @brief Indexes the actions of an execution by location and thread
+ *
+ * This mirrors ModelExecution::obj_thrd_map with random-access lists (except
+ * that condition-variable waits are not also filed under their mutex). All of
+ * the searches exploit the fact that a thread's actions are ordered by
+ * sequence number, and so also by happens-before: if an action happens
+ * before some other action, so do all earlier actions of its thread.
+ */
+class LocationIndex {
+public:
+	LocationIndex();
+
+	void add_action(ModelAction *act);
+	void add_rmw(ModelAction *act);
+
+	unsigned int get_num_threads(const void *location) const;
+	const struct thread_history * get_history(const void *location, thread_id_t tid) const;
+
+	static int last_happens_before(const SnapVector<ModelAction *> *list, const ModelAction *act);
+	static int first_happens_after(const SnapVector<ModelAction *> *list, const ModelAction *act);
+	static int last_before(const SnapVector<ModelAction *> *list, const ModelAction *act);
+	static int position(const SnapVector<ModelAction *> *list, const ModelAction *act);
+
+	SNAPSHOTALLOC
+private:
+	void classify(struct thread_history *history, ModelAction *act);
+
+	SwissTable<const void *, SnapVector<struct thread_history> *, uintptr_t, 4> map;
+};
+
+#endif /* __LOCATIONINDEX_H__ */
@@ -32,6 +32,13 @@ static void param_defaults(struct model_params *params)
 	params->verbose = !!DBG_ENABLED();
 	params->uninitvalue = 0;
 	params->maxexecutions = 0;
+	params->numworkers = 1;
+	params->prunestates = false;
+	params->tracefile = NULL;
+	params->spilllimit = 0;
+	params->checkpointfile = NULL;
+	params->checkpointinterval = CHECKPOINT_INTERVAL;
+	params->resume = false;
 }
 
 static void print_usage(const char *program_name, struct model_params *params)
@@ -89,6 +96,25 @@ static void print_usage(const char *program_name, struct model_params *params)
 "-x, --maxexec=NUM           Maximum number of executions.\n"
 "                            Default: %u\n"
 "                            -o help for a list of options\n"
+"-j, --jobs=NUM              Explore executions in parallel using up to NUM\n"
+"                              worker processes.\n"
+"                              Default: %d\n"
+"-P, --prune-states          Stop executions upon reaching a state whose\n"
+"                              executions have all been explored.\n"
+"                              Default: %s\n"
+"-T, --trace=FILE            Append a compact binary record of every\n"
+"                              execution to FILE (see tracewriter.h).\n"
+"-N, --spill=MB              Keep the node stack in a temporary file (under\n"
+"                              $TMPDIR), paging out all but at most MB MiB of it.\n"
+"                              Default: %u (keep it in memory)\n"
+"-C, --checkpoint=FILE       Save the progress of the exploration to FILE\n"
+"                              periodically, at exit from -x, and on SIGINT\n"
+"                              or SIGTERM (which stop the run).\n"
+"-c, --checkpoint-interval=SECS\n"
+"                            Seconds between checkpoints (0: after every\n"
+"                              execution).\n"
+"                              Default: %u\n"
+"-R, --resume                Continue the run saved in the checkpoint FILE.\n"
 " --                         Program arguments follow.\n\n",
 		program_name,
 		params->maxreads,
@@ -102,7 +128,11 @@ static void print_usage(const char *program_name, struct model_params *params)
 		params->bound,
 		params->verbose,
     params->uninitvalue,
-		params->maxexecutions);
+		params->maxexecutions,
+		params->numworkers,
+		params->prunestates ? "enabled" : "disabled",
+		params->spilllimit,
+		params->checkpointinterval);
 	model_print("Analysis plugins:\n");
 	for(unsigned int i=0;i<registeredanalysis->size();i++) {
 		TraceAnalysis * analysis=(*registeredanalysis)[i];
@@ -128,7 +158,7 @@ bool install_plugin(char * name) {
 
 static void parse_options(struct model_params *params, int argc, char **argv)
 {
-	const char *shortopts = "hyYt:o:m:M:s:S:f:e:b:u:x:v::";
+	const char *shortopts = "hyYPRt:o:m:M:s:S:f:e:b:u:x:j:T:N:C:c:v::";
 	const struct option longopts[] = {
 		{"help", no_argument, NULL, 'h'},
 		{"liveness", required_argument, NULL, 'm'},
@@ -145,6 +175,13 @@ static void parse_options(struct model_params *params, int argc, char **argv)
 		{"analysis", required_argument, NULL, 't'},
 		{"options", required_argument, NULL, 'o'},
 		{"maxexecutions", required_argument, NULL, 'x'},
+		{"jobs", required_argument, NULL, 'j'},
+		{"prune-states", no_argument, NULL, 'P'},
+		{"trace", required_argument, NULL, 'T'},
+		{"spill", required_argument, NULL, 'N'},
+		{"checkpoint", required_argument, NULL, 'C'},
+		{"checkpoint-interval", required_argument, NULL, 'c'},
+		{"resume", no_argument, NULL, 'R'},
 		{0, 0, 0, 0} /* Terminator */
 	};
 	int opt, longindex;
@@ -157,6 +194,11 @@ static void parse_options(struct model_params *params, int argc, char **argv)
 		case 'x':
 			params->maxexecutions = atoi(optarg);
 			break;
+		case 'j':
+			params->numworkers = atoi(optarg);
+			if (params->numworkers < 1)
+				error = true;
+			break;
 		case 's':
 			params->maxfuturedelay = atoi(optarg);
 			break;
@@ -201,12 +243,43 @@ static void parse_options(struct model_params *params, int argc, char **argv)
 		case 'Y':
 			params->yieldblock = true;
 			break;
+		case 'P':
+			params->prunestates = true;
+			break;
+		case 'T':
+			params->tracefile = optarg;
+			break;
+		case 'N': {
+			int limit = atoi(optarg);
+			if (limit < 1)
+				error = true;
+			else
+				params->spilllimit = limit;
+			break;
+		}
+		case 'C':
+			params->checkpointfile = optarg;
+			break;
+		case 'c': {
+			int interval = atoi(optarg);
+			if (interval < 0)
+				error = true;
+			else
+				params->checkpointinterval = interval;
+			break;
+		}
+		case 'R':
+			params->resume = true;
+			break;
 		default: /* '?' */
 			error = true;
 			break;
 		}
 	}
 
+	if (params->resume && !params->checkpointfile)
+		error = true;
+
 	/* Pass remaining arguments to user program */
 	params->argc = argc - (optind - 1);
 	params->argv = argv + (optind - 1);
@@ -255,10 +328,12 @@ static void model_main()
 	install_trace_analyses(model->get_execution());
 
 	snapshot_record(0);
-	model->run();
+	bool complete = model->run();
 	delete model;
 
 	DEBUG("Exiting\n");
+	if (!complete)
+		exit(EXIT_FAILURE);
 }
 
 /**
@@ -286,5 +361,5 @@ int main(int argc, char **argv)
 	redirect_output();
 
 	/* Let's jump in quickly and start running stuff */
-	snapshot_system_init(10000, 1024, 1024, 4000, &model_main);
+	snapshot_system_init(20000, 1024, 1024, 8000, &model_main);
 }
@@ -1,8 +1,10 @@
 #include <stdio.h>
 #include <algorithm>
 #include <new>
+#include <signal.h>
 #include <stdarg.h>
 #include <string.h>
+#include <time.h>
 
 #include "model.h"
 #include "action.h"
@@ -16,9 +18,36 @@
 #include "traceanalysis.h"
 #include "execution.h"
 #include "bugmessage.h"
+#include "parallel.h"
+#include "statecache.h"
+#include "tracewriter.h"
+#include "spill.h"
+#include "checkpoint.h"
 
 ModelChecker *model;
 
+#if USE_MPROTECT_SNAPSHOT
+/** @brief Set by SIGINT or SIGTERM, when checkpointing, to stop the run after
+ *  the current execution */
+static volatile sig_atomic_t stop_requested;
+
+static void request_stop(int sig)
+{
+	stop_requested = 1;
+}
+#else
+/* Checkpointing, and so stopping on a signal, needs mprotect snapshots */
+static const sig_atomic_t stop_requested = 0;
+#endif
+
+/** @return The current time, in nanoseconds */
+static uint64_t get_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 /** @brief Constructor */
 ModelChecker::ModelChecker(struct model_params params) :
 	/* Initialize default scheduler */
@@ -32,16 +61,31 @@ ModelChecker::ModelChecker(struct model_params params) :
 	diverge(NULL),
 	earliest_diverge(NULL),
 	trace_analyses(),
-	inspect_plugin(NULL)
+	inspect_plugin(NULL),
+	parallel(NULL),
+	state_cache(params.prunestates ? new StateCache() : NULL),
+	pruned(false),
+	trace_writer(params.tracefile ? new TraceWriter(params.tracefile) : NULL),
+	start_time(get_time()),
+	checkpoint_file(NULL),
+	last_checkpoint(0),
+	bug_reports()
 {
 	memset(&stats,0,sizeof(struct execution_stats));
+	if (params.spilllimit)
+		setup_spill();
 }
 
 /** @brief Destructor */
 ModelChecker::~ModelChecker()
 {
+	delete parallel;
+	delete state_cache;
+	delete trace_writer;
 	delete node_stack;
 	delete scheduler;
+	for (unsigned int i = 0; i < bug_reports.size(); i++)
+		model_free(bug_reports[i]);
 }
 
 /**
@@ -62,6 +106,7 @@ void ModelChecker::reset_to_initial_state()
 		delete get_thread(int_to_id(i))->get_pending();
 
 	snapshot_backtrack_before(0);
+	flushShadowCache();
 }
 
 /** @return the number of user threads created during this execution */
@@ -123,7 +168,7 @@ Thread * ModelChecker::get_next_thread()
 		} else {
 			ASSERT(prevnode);
 			/* Make a different thread execute for next step */
-			scheduler->add_sleep(get_thread(next->get_tid()));
+			scheduler->add_sleep(get_thread(parallel ? parallel->get_sleep_thread(next) : next->get_tid()));
 			tid = prevnode->get_next_backtrack();
 			/* Make sure the backtracked thread isn't sleeping. */
 			node_stack->pop_restofstack(1);
@@ -226,6 +271,8 @@ void ModelChecker::record_stats()
 		stats.num_buggy_executions++;
 	else if (execution->is_complete_execution())
 		stats.num_complete++;
+	else if (pruned)
+		stats.num_pruned++;
 	else {
 		stats.num_redundant++;
 
@@ -236,6 +283,27 @@ void ModelChecker::record_stats()
 		 */
 		//ASSERT(scheduler->all_threads_sleeping());
 	}
+	pruned = false;
+}
+
+/**
+ * @brief Remember the distinct bug reports of this execution, so that a run
+ * resumed from a checkpoint can list them
+ */
+void ModelChecker::collect_bugs()
+{
+	SnapVector<bug_message *> *bugs = execution->get_bugs();
+	for (unsigned int i = 0; i < bugs->size(); i++) {
+		const char *msg = (*bugs)[i]->msg;
+		bool seen = false;
+		for (unsigned int j = 0; j < bug_reports.size() && !seen; j++)
+			seen = strcmp(bug_reports[j], msg) == 0;
+		if (!seen && bug_reports.size() < CHECKPOINT_MAX_BUGS) {
+			char *copy = (char *)model_malloc(strlen(msg) + 1);
+			strcpy(copy, msg);
+			bug_reports.push_back(copy);
+		}
+	}
 }
 
 /** @brief Print execution stats */
@@ -243,11 +311,28 @@ void ModelChecker::print_stats() const
 {
 	model_print("Number of complete, bug-free executions: %d\n", stats.num_complete);
 	model_print("Number of redundant executions: %d\n", stats.num_redundant);
+	if (state_cache)
+		model_print("Number of pruned executions: %d\n", stats.num_pruned);
 	model_print("Number of buggy executions: %d\n", stats.num_buggy_executions);
 	model_print("Number of infeasible executions: %d\n", stats.num_infeasible);
 	model_print("Total executions: %d\n", stats.num_total);
-	if (params.verbose)
+	if (params.verbose) {
 		model_print("Total nodes created: %d\n", node_stack->get_total_nodes());
+		node_stack->print_stats();
+		snapshot_print_stats();
+		printRaceStats();
+		arena_print_stats();
+		stack_pool_print_stats();
+		spill_print_stats();
+		ModelAction::print_pool_stats();
+		Thread::print_swap_stats((get_time() - start_time) / 1e9);
+	}
+	if (state_cache)
+		state_cache->print_stats();
+	if (parallel)
+		parallel->print_stats();
+	if (trace_writer && params.verbose)
+		trace_writer->print_stats();
 }
 
 /**
@@ -309,6 +394,8 @@ bool ModelChecker::next_execution()
 	}
 
 	record_stats();
+	if (trace_writer)
+		trace_writer->write_execution(execution_number, execution);
 
 	/* Output */
 	if ( (complete && params.verbose) || params.verbose>1 || (complete && execution->have_bug_reports()))
@@ -316,6 +403,9 @@ bool ModelChecker::next_execution()
 	else
 		clear_program_output();
 
+	if (checkpoint_file && complete && execution->have_bug_reports())
+		collect_bugs();
+
 	if (complete)
 		earliest_diverge = NULL;
 
@@ -327,8 +417,16 @@ bool ModelChecker::next_execution()
 	if (exit_flag)
 		return false;
 
-	if ((diverge = execution->get_next_backtrack()) == NULL)
+	diverge = execution->get_next_backtrack();
+	if (parallel)
+		diverge = parallel->next_divergence(diverge);
+	if (diverge && state_cache)
+		state_cache->diverge(node_stack->get_index(diverge->get_node()));
+	if (diverge == NULL) {
+		if (checkpoint_file)
+			write_checkpoint();
 		return false;
+	}
 
 	if (DBG_ENABLED()) {
 		model_print("Next execution will diverge at:\n");
@@ -337,7 +435,14 @@ bool ModelChecker::next_execution()
 
 	execution_number++;
 
-	if (params.maxexecutions != 0 && stats.num_complete >= params.maxexecutions)
+	bool stop = stop_requested ||
+		(params.maxexecutions != 0 && stats.num_complete >= params.maxexecutions);
+	if (checkpoint_file && (stop || get_time() - last_checkpoint >=
+				(uint64_t)params.checkpointinterval * 1000000000))
+		write_checkpoint();
+	if (stop_requested)
+		model_print("Stopping before execution %d\n", execution_number);
+	if (stop)
 		return false;
 
 	reset_to_initial_state();
@@ -429,6 +534,18 @@ bool ModelChecker::should_terminate_execution()
 
 	if (execution->too_many_steps())
 		return true;
+
+	/* Reached a state whose subtree has already been explored? */
+	if (state_cache && !node_stack->in_replay_prefix()) {
+		uint64_t fingerprint = execution->get_state_fingerprint();
+		const state_summary_t *summary = fingerprint ? state_cache->visit(fingerprint,
+				node_stack->get_index(node_stack->get_head())) : NULL;
+		if (summary) {
+			execution->backtrack_summary(summary);
+			pruned = true;
+			return true;
+		}
+	}
 	return false;
 }
 
@@ -457,11 +574,259 @@ void ModelChecker::do_restart()
 	execution_number = 1;
 }
 
-/** @brief Run ModelChecker for the user program */
-void ModelChecker::run()
+/**
+ * @brief Enable parallel exploration, if supported by this configuration
+ *
+ * Parallel exploration forks worker processes which share nothing but their
+ * final reports, so it is not available for analysis plugins (which keep
+ * their own cross-execution state), for state pruning (whose summaries of
+ * explored subtrees would miss the workers' executions) or for the fork-based
+ * snapshotting backend.
+ */
+void ModelChecker::setup_parallel()
+{
+#if USE_MPROTECT_SNAPSHOT
+	if (!trace_analyses.empty() || inspect_plugin) {
+		model_print("Warning: parallel exploration is not supported with analysis plugins; "
+				"exploring sequentially\n");
+		return;
+	}
+	if (spill_enabled()) {
+		model_print("Warning: parallel exploration is not supported with node spilling; "
+				"exploring sequentially\n");
+		return;
+	}
+	if (checkpoint_file) {
+		model_print("Warning: parallel exploration is not supported with checkpointing; "
+				"exploring sequentially\n");
+		return;
+	}
+	if (state_cache) {
+		model_print("Warning: parallel exploration is not supported with state pruning; "
+				"exploring sequentially\n");
+		return;
+	}
+	parallel = new ParallelExplorer(&params, node_stack, &stats);
+#else
+	model_print("Warning: parallel exploration requires mprotect-based snapshotting; "
+			"exploring sequentially\n");
+#endif
+}
+
+/**
+ * @brief Keep the NodeStack in a spill file, if supported by this
+ * configuration
+ *
+ * The spill file is a shared mapping, so it would be shared by the processes
+ * of the fork-based snapshotting backend and by parallel workers; spilling
+ * is only available with mprotect-based snapshotting, and rules out parallel
+ * exploration (see setup_parallel()).
+ */
+void ModelChecker::setup_spill()
+{
+#if USE_MPROTECT_SNAPSHOT
+	if (!spill_init((size_t)params.spilllimit << 20))
+		model_print("Warning: cannot create a node spill file; keeping nodes in memory\n");
+#else
+	model_print("Warning: node spilling requires mprotect-based snapshotting; "
+			"keeping nodes in memory\n");
+#endif
+}
+
+/**
+ * @brief Checkpoint the exploration, if supported by this configuration
+ *
+ * SIGINT and SIGTERM then stop the run once the current execution ends,
+ * after a last checkpoint; a second signal terminates it as usual. The
+ * fork-based snapshotting backend rolls back the model checker's globals
+ * (and delivers a terminal's SIGINT to every snapshot process), so
+ * checkpointing is only available with mprotect-based snapshotting.
+ */
+void ModelChecker::setup_checkpoint()
 {
-	bool has_next;
-	do {
+#if USE_MPROTECT_SNAPSHOT
+	struct sigaction sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = request_stop;
+	sa.sa_flags = SA_RESETHAND | SA_RESTART;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+	checkpoint_file = params.checkpointfile;
+	last_checkpoint = get_time();
+#else
+	model_print("Warning: checkpointing requires mprotect-based snapshotting; "
+			"not checkpointing\n");
+#endif
+}
+
+/** @brief The options which shape the exploration, in checkpoint order */
+static void get_exploration_options(const struct model_params *params, int64_t *options)
+{
+	options[0] = params->maxreads;
+	options[1] = params->maxfuturedelay;
+	options[2] = params->yieldon;
+	options[3] = params->yieldblock;
+	options[4] = params->fairwindow;
+	options[5] = params->enabledcount;
+	options[6] = params->bound;
+	options[7] = params->uninitvalue;
+	options[8] = params->maxfuturevalues;
+	options[9] = params->expireslop;
+	options[10] = params->prunestates;
+}
+
+#define NUM_EXPLORATION_OPTIONS 11
+
+/** @brief Refuse to resume from a checkpoint of a different run */
+static void checkpoint_mismatch(const char *filename)
+{
+	model_print("Checkpoint %s was written by a run with different options, "
+			"program arguments or analysis plugins\n", filename);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Write the progress of the exploration to the checkpoint file
+ *
+ * Called at the end of an execution, once the next divergence point is
+ * known. The checkpoint holds, in order:
+ *
+ *   the options which shape the exploration and the program arguments,
+ *   which a resumed run must share; the NodeStack (see
+ *   NodeStack::checkpoint()); the next divergence point (NULL once the
+ *   exploration is complete); the execution number and stats; the distinct
+ *   bug reports so far; and the name and state of each analysis plugin.
+ *
+ * If a plugin cannot be checkpointed, checkpointing is turned off.
+ */
+void ModelChecker::write_checkpoint()
+{
+	CheckpointWriter writer;
+	int64_t options[NUM_EXPLORATION_OPTIONS];
+	get_exploration_options(&params, options);
+	for (int i = 0; i < NUM_EXPLORATION_OPTIONS; i++)
+		writer.put_int(options[i]);
+	writer.put(params.argc);
+	for (int i = 1; i < params.argc; i++)
+		writer.put_string(params.argv[i]);
+
+	node_stack->checkpoint(&writer);
+	writer.put_action(diverge);
+	writer.put(execution_number);
+	writer.put(stats.num_total);
+	writer.put(stats.num_infeasible);
+	writer.put(stats.num_buggy_executions);
+	writer.put(stats.num_complete);
+	writer.put(stats.num_redundant);
+	writer.put(stats.num_pruned);
+
+	writer.put(bug_reports.size());
+	for (unsigned int i = 0; i < bug_reports.size(); i++)
+		writer.put_string(bug_reports[i]);
+
+	writer.put(trace_analyses.size());
+	for (unsigned int i = 0; i < trace_analyses.size(); i++) {
+		writer.put_string(trace_analyses[i]->name());
+		if (!trace_analyses[i]->checkpoint(&writer)) {
+			model_print("Warning: analysis plugin %s does not support checkpointing; "
+					"not checkpointing\n", trace_analyses[i]->name());
+			checkpoint_file = NULL;
+			return;
+		}
+	}
+
+	writer.commit(checkpoint_file);
+	last_checkpoint = get_time();
+}
+
+/**
+ * @brief Restore the progress of a run from the checkpoint file
+ *
+ * Exits if the checkpoint cannot be read or was written by a run with
+ * different options, program arguments or analysis plugins.
+ *
+ * @return False if the checkpointed run had explored every execution
+ */
+bool ModelChecker::resume_from_checkpoint()
+{
+	if (!checkpoint_file) {
+		model_print("Cannot resume without checkpointing\n");
+		exit(EXIT_FAILURE);
+	}
+
+	CheckpointReader reader(checkpoint_file);
+	int64_t options[NUM_EXPLORATION_OPTIONS];
+	get_exploration_options(&params, options);
+	bool same = true;
+	for (int i = 0; i < NUM_EXPLORATION_OPTIONS; i++)
+		same &= reader.get_int() == options[i];
+	same &= reader.get() == (uint64_t)params.argc;
+	for (int i = 1; i < params.argc && same; i++) {
+		char *arg = reader.get_string();
+		same = strcmp(arg, params.argv[i]) == 0;
+		model_free(arg);
+	}
+	if (!same && !reader.failed())
+		checkpoint_mismatch(checkpoint_file);
+
+	node_stack->restore(&reader);
+	diverge = reader.get_action();
+	execution_number = reader.get();
+	stats.num_total = reader.get();
+	stats.num_infeasible = reader.get();
+	stats.num_buggy_executions = reader.get();
+	stats.num_complete = reader.get();
+	stats.num_redundant = reader.get();
+	stats.num_pruned = reader.get();
+
+	unsigned int num_bugs = reader.get();
+	for (unsigned int i = 0; i < num_bugs && !reader.failed(); i++)
+		bug_reports.push_back(reader.get_string());
+
+	same &= reader.get() == trace_analyses.size();
+	for (unsigned int i = 0; i < trace_analyses.size() && same; i++) {
+		char *name = reader.get_string();
+		same = strcmp(name, trace_analyses[i]->name()) == 0;
+		model_free(name);
+		if (same)
+			trace_analyses[i]->resume(&reader);
+	}
+
+	if (!same && !reader.failed())
+		checkpoint_mismatch(checkpoint_file);
+	if (reader.failed() || !reader.at_end()) {
+		model_print("Cannot resume from checkpoint %s\n", checkpoint_file);
+		exit(EXIT_FAILURE);
+	}
+
+	model_print("Resuming from checkpoint %s at execution %d\n",
+			checkpoint_file, execution_number);
+	if (!bug_reports.empty()) {
+		model_print("Bug reports before the checkpoint:\n");
+		for (unsigned int i = 0; i < bug_reports.size(); i++)
+			model_print("%s", bug_reports[i]);
+	}
+	model_print("\n");
+	return diverge != NULL;
+}
+
+/**
+ * @brief Run ModelChecker for the user program
+ * @return False if part of the execution tree was left unexplored because a
+ * parallel worker failed
+ */
+bool ModelChecker::run()
+{
+	bool has_next = true;
+
+	if (params.checkpointfile)
+		setup_checkpoint();
+	if (params.numworkers > 1)
+		setup_parallel();
+	if (params.resume)
+		has_next = resume_from_checkpoint();
+
+	while (has_next) {
 		thrd_t user_thread;
 		Thread *t = new Thread(execution->get_next_id(), &user_thread, &user_main_wrapper, NULL, NULL);
 		execution->add_thread(t);
@@ -518,14 +883,20 @@ void ModelChecker::run()
 				do_restart();
 			}
 		}
-	} while (has_next);
+	}
 
 	execution->fixup_release_sequences();
 
-	model_print("******* Model-checking complete: *******\n");
+	bool complete = !parallel || parallel->is_complete();
+	if (complete)
+		model_print("******* Model-checking complete: *******\n");
+	else
+		model_print("******* Model-checking INCOMPLETE: *******\n");
 	print_stats();
 
 	/* Have the trace analyses dump their output. */
 	for (unsigned int i = 0; i < trace_analyses.size(); i++)
 		trace_analyses[i]->finish();
+
+	return complete;
 }
@@ -15,6 +15,7 @@
 #include "stl-model.h"
 #include "context.h"
 #include "params.h"
+#include "actionlist.h"
 
 /* Forward declaration */
 class Node;
@@ -27,8 +28,10 @@ class ClockVector;
 class TraceAnalysis;
 class ModelExecution;
 class ModelAction;
+class ParallelExplorer;
+class StateCache;
+class TraceWriter;
 
-typedef SnapList<ModelAction *> action_list_t;
 
 /** @brief Model checker execution stats */
 struct execution_stats {
@@ -37,6 +40,7 @@ struct execution_stats {
 	int num_buggy_executions; /** @brief Number of buggy executions */
 	int num_complete; /**< @brief Number of feasible, non-buggy, complete executions */
 	int num_redundant; /**< @brief Number of redundant, aborted executions */
+	int num_pruned; /**< @brief Number of executions cut at an explored state (-P) */
 };
 
 /** @brief The central structure for model-checking */
@@ -45,7 +49,7 @@ public:
 	ModelChecker(struct model_params params);
 	~ModelChecker();
 
-	void run();
+	bool run();
 
 	/** Restart the model checker, intended for pluggins. */
 	void restart();
@@ -57,9 +61,10 @@ public:
 	bool get_exit_flag() const { return exit_flag; }
 
 	/** @returns the context for the main model-checking system thread */
-	ucontext_t * get_system_context() { return &system_context; }
+	model_context_t * get_system_context() { return &system_context; }
 
 	ModelExecution * get_execution() const { return execution; }
+	StateCache * get_state_cache() const { return state_cache; }
 
 	int get_execution_number() const { return execution_number; }
 
@@ -105,7 +110,7 @@ private:
 	ModelAction *diverge;
 	ModelAction *earliest_diverge;
 
-	ucontext_t system_context;
+	model_context_t system_context;
 
 	ModelVector<TraceAnalysis *> trace_analyses;
 
@@ -115,7 +120,29 @@ private:
 	TraceAnalysis *inspect_plugin;
 	/** @brief The cumulative execution stats */
 	struct execution_stats stats;
+	/** @brief Distributes exploration across worker processes, if enabled */
+	ParallelExplorer *parallel;
+	/** @brief Fingerprints of explored states, if state pruning is enabled */
+	StateCache *state_cache;
+	/** @brief The current execution was cut short at an explored state */
+	bool pruned;
+	/** @brief Binary trace of every execution, if requested */
+	TraceWriter *trace_writer;
+	/** @brief When model checking started, in nanoseconds */
+	uint64_t start_time;
+	/** @brief File to write checkpoints to, or NULL if not checkpointing */
+	const char *checkpoint_file;
+	/** @brief When the last checkpoint was written, in nanoseconds */
+	uint64_t last_checkpoint;
+	/** @brief The distinct bug reports seen so far, when checkpointing */
+	ModelVector<char *> bug_reports;
 	void record_stats();
+	void collect_bugs();
+	void setup_parallel();
+	void setup_spill();
+	void setup_checkpoint();
+	void write_checkpoint();
+	bool resume_from_checkpoint();
 	void run_trace_analyses();
 	void print_bugs() const;
 	void print_execution(bool printbugs) const;
@@ -4,6 +4,8 @@
 #include <unistd.h>
 #include <string.h>
 #include <new>
+#include <inttypes.h>
+#include <sys/mman.h>
 
 #include "mymemory.h"
 #include "snapshot.h"
@@ -95,12 +97,228 @@ void *snapshot_realloc(void *ptr, size_t size)
 	return tmp;
 }
 
+/** @brief Snapshotting memalign, for use by model-checker (not user progs) */
+void * snapshot_memalign(size_t alignment, size_t size)
+{
+	void *tmp = mspace_memalign(model_snapshot_space, alignment, size);
+	ASSERT(tmp);
+	return tmp;
+}
+
 /** @brief Snapshotting free, for use by model-checker (not user progs) */
 void snapshot_free(void *ptr)
 {
 	mspace_free(model_snapshot_space, ptr);
 }
 
+/*
+ * The per-execution arena
+ *
+ * Objects which never outlive an execution (clock vectors, action lists) are
+ * bump-allocated from one large reservation of ordinary, unsnapshotted
+ * memory, with a free list per 16-byte size class to recycle anything freed
+ * early. Rather than having the snapshotter copy and restore these pages and
+ * the allocator's metadata, rolling back just moves the bump pointer back to
+ * where it was when the snapshot was taken (see arena_mark()). Nothing which
+ * was live at the snapshot is restored, so this is only sound for objects
+ * which are all dead once the snapshot is restored: the model checker only
+ * ever rolls back to the start of an execution.
+ *
+ * Until the first mark, and if the reservation runs out, allocations come
+ * from the snapshotting heap instead. Allocations of 32 bytes or more are
+ * 32-byte aligned, for the clock vector kernels.
+ */
+
+#define ARENA_GRANULE 16
+#define ARENA_CLASSES 16
+#define ARENA_ALIGN 32
+
+static char *arena_start;
+static char *arena_top;
+static char *arena_end;
+static void *arena_freelist[ARENA_CLASSES];
+
+static struct {
+	uint64_t bumped;
+	uint64_t reused;
+	uint64_t fallback;
+	uint64_t rollbacks;
+	size_t highwater;
+} arena_stats;
+
+/** @brief Allocate from the per-execution arena */
+void * arena_malloc(size_t size)
+{
+	size_t cls = (size + ARENA_GRANULE - 1) / ARENA_GRANULE;
+	if (cls == 0)
+		cls = 1;
+	if (cls < ARENA_CLASSES && arena_freelist[cls]) {
+		void *p = arena_freelist[cls];
+		arena_freelist[cls] = *(void **)p;
+		arena_stats.reused++;
+		return p;
+	}
+
+	size_t bytes = cls * ARENA_GRANULE;
+	char *p = arena_top;
+	if (p && bytes >= ARENA_ALIGN)
+		p = (char *)(((uintptr_t)p + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+	if (!p || p + bytes > arena_end) {
+		arena_stats.fallback++;
+		return snapshot_memalign(ARENA_ALIGN, size);
+	}
+	arena_top = p + bytes;
+	arena_stats.bumped++;
+	if ((size_t)(arena_top - arena_start) > arena_stats.highwater)
+		arena_stats.highwater = arena_top - arena_start;
+	return p;
+}
+
+/**
+ * @brief Free memory from arena_malloc()
+ * @param ptr The memory
+ * @param size The size it was allocated with
+ */
+void arena_free(void *ptr, size_t size)
+{
+	if (!ptr)
+		return;
+	if ((char *)ptr < arena_start || (char *)ptr >= arena_end) {
+		snapshot_free(ptr);
+		return;
+	}
+	size_t cls = (size + ARENA_GRANULE - 1) / ARENA_GRANULE;
+	if (cls == 0)
+		cls = 1;
+	/* Large objects are only reclaimed by rollback */
+	if (cls < ARENA_CLASSES) {
+		*(void **)ptr = arena_freelist[cls];
+		arena_freelist[cls] = ptr;
+	}
+}
+
+/**
+ * @brief Mark the arena's current position, to roll back to later
+ *
+ * The first mark reserves the arena's address space and starts allocating
+ * from it.
+ *
+ * @return The mark, for arena_rollback()
+ */
+void * arena_mark()
+{
+	if (!arena_start) {
+		void *base = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+		arena_start = arena_top = (char *)base;
+		arena_end = arena_start + ARENA_SIZE;
+	}
+	return arena_top;
+}
+
+/**
+ * @brief Roll the arena back to a mark, freeing everything allocated since
+ * @param mark The mark, from arena_mark()
+ */
+void arena_rollback(void *mark)
+{
+	if (!mark)
+		return;
+	arena_top = (char *)mark;
+	memset(arena_freelist, 0, sizeof(arena_freelist));
+	arena_stats.rollbacks++;
+}
+
+/** @brief Print statistics on the per-execution arena */
+void arena_print_stats()
+{
+	model_print("Arena allocations: %" PRIu64 " bumped, %" PRIu64 " reused, %" PRIu64 " from snapshot heap\n",
+			arena_stats.bumped, arena_stats.reused, arena_stats.fallback);
+	model_print("Arena high-water:  %zu KiB, %" PRIu64 " rollbacks\n",
+			arena_stats.highwater >> 10, arena_stats.rollbacks);
+}
+
+/*
+ * The stack pool
+ *
+ * Each thread ID up to STACK_POOL_THREADS gets a fixed slot in one
+ * reservation of unsnapshotted address space: a guard region, then the
+ * thread's stack. The reservation starts out inaccessible, and a slot's
+ * stack is only made accessible the first time its thread is created, so
+ * the kernel commits stack pages as they are touched. A thread gets the same
+ * stack back in every later execution, so its pages are neither allocated
+ * nor tracked by the snapshotter again. As with the arena, nothing on the
+ * stacks is restored on rollback; that is sound because the model checker
+ * only rolls back to the start of an execution, when no user thread is
+ * running, and each thread's context is rebuilt when it is created.
+ */
+
+#define STACK_POOL_SLOT (STACK_GUARD_SIZE + STACK_SIZE)
+
+static char *stack_pool_base;
+static bool stack_pool_committed[STACK_POOL_THREADS];
+
+static struct {
+	uint64_t committed;
+	uint64_t reused;
+} stack_pool_stats;
+
+/**
+ * @brief Get the pooled stack for a thread ID
+ * @param index The thread ID
+ * @return A stack of STACK_SIZE bytes, or NULL if the ID has no slot in the
+ * pool (the caller should allocate the stack itself)
+ */
+void * stack_pool_get(unsigned int index)
+{
+	if (index >= STACK_POOL_THREADS)
+		return NULL;
+	if (!stack_pool_base) {
+		void *base = mmap(NULL, (size_t)STACK_POOL_THREADS * STACK_POOL_SLOT, PROT_NONE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+		if (base == MAP_FAILED)
+			return NULL;
+		stack_pool_base = (char *)base;
+	}
+
+	char *stack = stack_pool_base + (size_t)index * STACK_POOL_SLOT + STACK_GUARD_SIZE;
+	if (stack_pool_committed[index]) {
+		stack_pool_stats.reused++;
+		return stack;
+	}
+	if (mprotect(stack, STACK_SIZE, PROT_READ | PROT_WRITE)) {
+		perror("mprotect");
+		return NULL;
+	}
+	stack_pool_committed[index] = true;
+	stack_pool_stats.committed++;
+	return stack;
+}
+
+/** @return True if an address lies in the stack pool (guards included) */
+bool stack_pool_contains(const void *addr)
+{
+	return stack_pool_base && (const char *)addr >= stack_pool_base &&
+		(const char *)addr < stack_pool_base + (size_t)STACK_POOL_THREADS * STACK_POOL_SLOT;
+}
+
+/** @return True if an address lies in the guard region below a pooled stack */
+bool stack_pool_is_guard(const void *addr)
+{
+	if (!stack_pool_contains(addr))
+		return false;
+	return ((const char *)addr - stack_pool_base) % STACK_POOL_SLOT < STACK_GUARD_SIZE;
+}
+
+/** @brief Print statistics on the stack pool */
+void stack_pool_print_stats()
+{
+	model_print("Thread stacks:     %" PRIu64 " committed, %" PRIu64 " reused\n",
+			stack_pool_stats.committed, stack_pool_stats.reused);
+}
+
 /** Non-snapshotting free for our use. */
 void model_free(void *ptr)
 {
@@ -47,6 +47,25 @@
 		return p; \
 	}
 
+/** ARENAALLOC declares the allocators for a class to allocate memory in the
+ *	per-execution arena (see arena_malloc()). */
+#define ARENAALLOC \
+	void * operator new(size_t size) { \
+		return arena_malloc(size); \
+	} \
+	void operator delete(void *p, size_t size) { \
+		arena_free(p, size); \
+	} \
+	void * operator new[](size_t size) { \
+		return arena_malloc(size); \
+	} \
+	void operator delete[](void *p, size_t size) { \
+		arena_free(p, size); \
+	} \
+	void * operator new(size_t size, void *p) { /* placement new */ \
+		return p; \
+	}
+
 void *model_malloc(size_t size);
 void *model_calloc(size_t count, size_t size);
 void model_free(void *ptr);
@@ -54,8 +73,20 @@ void model_free(void *ptr);
 void * snapshot_malloc(size_t size);
 void * snapshot_calloc(size_t count, size_t size);
 void * snapshot_realloc(void *ptr, size_t size);
+void * snapshot_memalign(size_t alignment, size_t size);
 void snapshot_free(void *ptr);
 
+void * arena_malloc(size_t size);
+void arena_free(void *ptr, size_t size);
+void * arena_mark();
+void arena_rollback(void *mark);
+void arena_print_stats();
+
+void * stack_pool_get(unsigned int index);
+bool stack_pool_contains(const void *addr);
+bool stack_pool_is_guard(const void *addr);
+void stack_pool_print_stats();
+
 void * Thread_malloc(size_t size);
 void Thread_free(void *ptr);
 
@@ -243,6 +274,93 @@ bool operator!= (const SnapshotAlloc<T1>&,
 	return false;
 }
 
+/**
+ * @brief Provides a per-execution arena allocator for use in STL classes
+ *
+ * Like SnapshotAlloc, for containers whose elements die with the execution.
+ */
+template <class T>
+class ArenaAlloc {
+ public:
+	// type definitions
+	typedef T        value_type;
+	typedef T*       pointer;
+	typedef const T* const_pointer;
+	typedef T&       reference;
+	typedef const T& const_reference;
+	typedef size_t   size_type;
+	typedef size_t   difference_type;
+
+	// rebind allocator to type U
+	template <class U>
+	struct rebind {
+		typedef ArenaAlloc<U> other;
+	};
+
+	// return address of values
+	pointer address(reference value) const {
+		return &value;
+	}
+	const_pointer address(const_reference value) const {
+		return &value;
+	}
+
+	/* constructors and destructor
+	 * - nothing to do because the allocator has no state
+	 */
+	ArenaAlloc() throw() {
+	}
+	ArenaAlloc(const ArenaAlloc&) throw() {
+	}
+	template <class U>
+	ArenaAlloc(const ArenaAlloc<U>&) throw() {
+	}
+	~ArenaAlloc() throw() {
+	}
+
+	// return maximum number of elements that can be allocated
+	size_type max_size() const throw() {
+		return std::numeric_limits<size_t>::max() / sizeof(T);
+	}
+
+	// allocate but don't initialize num elements of type T
+	pointer allocate(size_type num, const void * = 0) {
+		pointer p = (pointer)arena_malloc(num * sizeof(T));
+		return p;
+	}
+
+	// initialize elements of allocated storage p with value value
+	void construct(pointer p, const T& value) {
+		// initialize memory with placement new
+		new((void*)p)T(value);
+	}
+
+	// destroy elements of initialized storage p
+	void destroy(pointer p) {
+		// destroy objects by calling their destructor
+		p->~T();
+	}
+
+	// deallocate storage p of deleted elements
+	void deallocate(pointer p, size_type num) {
+		arena_free((void*)p, num * sizeof(T));
+	}
+};
+
+/** Return that all specializations of this allocator are interchangeable. */
+template <class T1, class T2>
+bool operator ==(const ArenaAlloc<T1>&,
+		const ArenaAlloc<T2>&) throw() {
+	return true;
+}
+
+/** Return that all specializations of this allocator are interchangeable. */
+template <class T1, class T2>
+bool operator!= (const ArenaAlloc<T1>&,
+		const ArenaAlloc<T2>&) throw() {
+	return false;
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -251,6 +369,7 @@ extern "C" {
 	extern void mspace_free(mspace msp, void* mem);
 	extern void * mspace_realloc(mspace msp, void* mem, size_t newsize);
 	extern void * mspace_calloc(mspace msp, size_t n_elements, size_t elem_size);
+	extern void * mspace_memalign(mspace msp, size_t alignment, size_t bytes);
 	extern mspace create_mspace_with_base(void* base, size_t capacity, int locked);
 	extern mspace create_mspace(size_t capacity, int locked);
 
@@ -10,6 +10,161 @@
 #include "modeltypes.h"
 #include "execution.h"
 #include "params.h"
+#include "spill.h"
+#include "checkpoint.h"
+
+/**
+ * @brief Construct an empty ThreadBitSet
+ * @param size The number of threads in the set
+ */
+ThreadBitSet::ThreadBitSet(int size) :
+	num_bits(size),
+	word(0)
+{
+	if (num_bits > 64)
+		array = (uint64_t *)spill_calloc(num_words(), sizeof(uint64_t));
+}
+
+ThreadBitSet::~ThreadBitSet()
+{
+	if (num_bits > 64)
+		spill_free(array);
+}
+
+/** @brief Remove every thread from the set */
+void ThreadBitSet::clear()
+{
+	memset(words(), 0, num_words() * sizeof(uint64_t));
+}
+
+/** @return The lowest thread in the set, or -1 if the set is empty */
+int ThreadBitSet::find_first() const
+{
+	const uint64_t *w = words();
+	for (int i = 0; i < num_words(); i++)
+		if (w[i])
+			return i * 64 + __builtin_ctzll(w[i]);
+	return -1;
+}
+
+/** @return The heap memory held by the set, in bytes */
+size_t ThreadBitSet::get_footprint() const
+{
+	return num_bits > 64 ? num_words() * sizeof(uint64_t) : 0;
+}
+
+/** @brief Keep the set's heap memory resident (see spill_mark_hot()) */
+void ThreadBitSet::mark_hot() const
+{
+	if (num_bits > 64)
+		spill_mark_hot(array, num_words() * sizeof(uint64_t));
+}
+
+/** @brief Write the set to a checkpoint */
+void ThreadBitSet::checkpoint(CheckpointWriter *writer) const
+{
+	const uint64_t *w = words();
+	for (int i = 0; i < num_words(); i++)
+		writer->put(w[i]);
+}
+
+/** @brief Read the set back from a checkpoint, into a set of the same size */
+void ThreadBitSet::restore(CheckpointReader *reader)
+{
+	uint64_t *w = words();
+	for (int i = 0; i < num_words(); i++)
+		w[i] = reader->get();
+}
+
+ChoiceLists::ChoiceLists() :
+	buf(NULL),
+	capacity(0)
+{
+	memset(len, 0, sizeof(len));
+}
+
+ChoiceLists::~ChoiceLists()
+{
+	if (buf)
+		spill_free(buf);
+}
+
+/** @brief Keep the lists resident (see spill_mark_hot()) */
+void ChoiceLists::mark_hot() const
+{
+	if (buf)
+		spill_mark_hot(buf, capacity);
+}
+
+/** @brief The size of an element of each choice list */
+static const size_t choice_elem_size[NUM_CHOICE_LISTS] = {
+	sizeof(const ModelAction *),	/* CHOICE_READ_FROM_PAST */
+	sizeof(const ModelAction *),	/* CHOICE_READ_FROM_PROMISE */
+	sizeof(struct future_value),	/* CHOICE_FUTURE_VALUE */
+	sizeof(bool),			/* CHOICE_RESOLVE_PROMISE */
+	sizeof(const ModelAction *),	/* CHOICE_RELSEQ_BREAK */
+};
+
+/** @return The space taken by n elements of a list, padded to 8 bytes */
+size_t ChoiceLists::segment_size(int list, unsigned int n)
+{
+	return (n * choice_elem_size[list] + 7) & ~(size_t)7;
+}
+
+/** @return The offset of a list in the buffer */
+size_t ChoiceLists::offset(int list) const
+{
+	size_t off = 0;
+	for (int i = 0; i < list; i++)
+		off += segment_size(i, len[i]);
+	return off;
+}
+
+/**
+ * @brief Append zero-filled elements to a list
+ * @param list The list
+ * @param n The number of elements to append
+ * @return The first new element
+ */
+void * ChoiceLists::append(int list, unsigned int n)
+{
+	size_t start = offset(list);
+	size_t oldseg = segment_size(list, len[list]);
+	size_t newseg = segment_size(list, len[list] + n);
+	size_t used = offset(NUM_CHOICE_LISTS);
+
+	if (used + newseg - oldseg > capacity) {
+		size_t newcap = capacity ? capacity * 2 : 32;
+		while (newcap < used + newseg - oldseg)
+			newcap *= 2;
+		char *newbuf = (char *)spill_malloc(newcap);
+		if (buf) {
+			memcpy(newbuf, buf, used);
+			spill_free(buf);
+		}
+		buf = newbuf;
+		capacity = newcap;
+	}
+	/* Move the later lists up */
+	memmove(buf + start + newseg, buf + start + oldseg, used - start - oldseg);
+
+	char *first = buf + start + len[list] * choice_elem_size[list];
+	memset(first, 0, buf + start + newseg - first);
+	len[list] += n;
+	return first;
+}
+
+/** @brief Empty a list, moving the later lists down */
+void ChoiceLists::clear(int list)
+{
+	if (!len[list])
+		return;
+	size_t start = offset(list);
+	size_t seg = segment_size(list, len[list]);
+	size_t used = offset(NUM_CHOICE_LISTS);
+	memmove(buf + start, buf + start + seg, used - start - seg);
+	len[list] = 0;
+}
 
 /**
  * @brief Node constructor
@@ -36,18 +191,14 @@ Node::Node(const struct model_params *params, ModelAction *act, Node *par,
 	num_threads(nthreads),
 	explored_children(num_threads),
 	backtrack(num_threads),
-	fairness(num_threads),
+	fairness(NULL),
 	numBacktracks(0),
 	enabled_array(NULL),
-	read_from_past(),
+	choices(),
 	read_from_past_idx(0),
-	read_from_promises(),
 	read_from_promise_idx(-1),
-	future_values(),
 	future_index(-1),
-	resolve_promise(),
 	resolve_promise_idx(-1),
-	relseq_break_writes(),
 	relseq_break_index(0),
 	misc_index(0),
 	misc_max(0),
@@ -59,8 +210,8 @@ Node::Node(const struct model_params *params, ModelAction *act, Node *par,
 	int prevtid = prevfairness ? id_to_int(prevfairness->action->get_tid()) : 0;
 
 	if (get_params()->fairwindow != 0) {
+		fairness = (struct fairness_info *)spill_calloc(num_threads, sizeof(*fairness));
 		for (int i = 0; i < num_threads; i++) {
-			ASSERT(i < ((int)fairness.size()));
 			struct fairness_info *fi = &fairness[i];
 			struct fairness_info *prevfi = (parent && i < parent->get_num_threads()) ? &parent->fairness[i] : NULL;
 			if (prevfi) {
@@ -92,6 +243,162 @@ Node::Node(const struct model_params *params, ModelAction *act, Node *par,
 	}
 }
 
+/**
+ * @brief Restore a Node written by Node::checkpoint()
+ * @param params The model-checker parameters
+ * @param act The ModelAction of this Node, already restored
+ * @param par The parent Node, already restored, or NULL for the first Node
+ * @param reader The checkpoint
+ */
+Node::Node(const struct model_params *params, ModelAction *act, Node *par,
+		CheckpointReader *reader) :
+	read_from_status(READ_FROM_PAST),
+	action(act),
+	params(params),
+	uninit_action(NULL),
+	parent(par),
+	num_threads(reader->get()),
+	explored_children(num_threads),
+	backtrack(num_threads),
+	fairness(NULL),
+	numBacktracks(0),
+	enabled_array(NULL),
+	choices(),
+	read_from_past_idx(0),
+	read_from_promise_idx(-1),
+	future_index(-1),
+	resolve_promise_idx(-1),
+	relseq_break_index(0),
+	misc_index(0),
+	misc_max(0),
+	yield_data(NULL)
+{
+	act->set_node(this);
+	act->set_last_fence_release(reader->get_action());
+	read_from_status = (read_from_type_t)reader->get();
+	explored_children.restore(reader);
+	backtrack.restore(reader);
+	numBacktracks = reader->get();
+
+	if (get_params()->fairwindow != 0) {
+		fairness = (struct fairness_info *)spill_calloc(num_threads, sizeof(*fairness));
+		for (int i = 0; i < num_threads; i++) {
+			fairness[i].enabled_count = reader->get();
+			fairness[i].turns = reader->get();
+			fairness[i].priority = reader->get();
+		}
+	}
+	if (reader->get()) {
+		enabled_array = (enabled_type_t *)spill_malloc(sizeof(enabled_type_t) * num_threads);
+		for (int i = 0; i < num_threads; i++)
+			enabled_array[i] = (enabled_type_t)reader->get();
+	}
+
+	for (int list = 0; list < NUM_CHOICE_LISTS && !reader->failed(); list++) {
+		unsigned int n = reader->get();
+		if (!n || reader->failed())
+			continue;
+		choices.append(list, n);
+		for (unsigned int i = 0; i < n; i++) {
+			switch (list) {
+			case CHOICE_FUTURE_VALUE: {
+				struct future_value fv;
+				fv.value = reader->get();
+				fv.expiration = reader->get();
+				fv.tid = int_to_id(reader->get());
+				choices.set(list, i, fv);
+				break;
+			}
+			case CHOICE_RESOLVE_PROMISE:
+				choices.set(list, i, (bool)reader->get());
+				break;
+			default:
+				choices.set(list, i, (const ModelAction *)reader->get_action());
+				break;
+			}
+		}
+	}
+
+	read_from_past_idx = reader->get_int();
+	read_from_promise_idx = reader->get_int();
+	future_index = reader->get_int();
+	resolve_promise_idx = reader->get_int();
+	relseq_break_index = reader->get_int();
+	misc_index = reader->get_int();
+	misc_max = reader->get_int();
+}
+
+/**
+ * @brief Write this Node to a checkpoint
+ *
+ * Everything the Node has learned about its children is written; the yield
+ * matrix is not, since every execution recomputes it.
+ *
+ * @param writer The checkpoint, in which every action the Node refers to is
+ * already registered
+ */
+void Node::checkpoint(CheckpointWriter *writer) const
+{
+	writer->put(num_threads);
+	writer->put_action(action->get_last_fence_release());
+	writer->put(read_from_status);
+	explored_children.checkpoint(writer);
+	backtrack.checkpoint(writer);
+	writer->put(numBacktracks);
+
+	if (fairness) {
+		for (int i = 0; i < num_threads; i++) {
+			writer->put(fairness[i].enabled_count);
+			writer->put(fairness[i].turns);
+			writer->put(fairness[i].priority);
+		}
+	}
+	writer->put(enabled_array != NULL);
+	if (enabled_array) {
+		for (int i = 0; i < num_threads; i++)
+			writer->put(enabled_array[i]);
+	}
+
+	for (int list = 0; list < NUM_CHOICE_LISTS; list++) {
+		writer->put(choices.size(list));
+		for (unsigned int i = 0; i < choices.size(list); i++) {
+			switch (list) {
+			case CHOICE_FUTURE_VALUE: {
+				struct future_value fv = choices.get<struct future_value>(list, i);
+				writer->put(fv.value);
+				writer->put(fv.expiration);
+				writer->put(id_to_int(fv.tid));
+				break;
+			}
+			case CHOICE_RESOLVE_PROMISE:
+				writer->put(choices.get<bool>(list, i));
+				break;
+			default:
+				writer->put_action(choices.get<const ModelAction *>(list, i));
+				break;
+			}
+		}
+	}
+
+	writer->put_int(read_from_past_idx);
+	writer->put_int(read_from_promise_idx);
+	writer->put_int(future_index);
+	writer->put_int(resolve_promise_idx);
+	writer->put_int(relseq_break_index);
+	writer->put_int(misc_index);
+	writer->put_int(misc_max);
+}
+
+/** @brief Move the future values which are addresses (see NodeStack::relocate()) */
+void Node::relocate_future_values(const relocation_table_t *relocations)
+{
+	for (unsigned int i = 0; i < choices.size(CHOICE_FUTURE_VALUE); i++) {
+		struct future_value fv = choices.get<struct future_value>(CHOICE_FUTURE_VALUE, i);
+		fv.value += relocations->get(fv.value / PAGESIZE);
+		choices.set(CHOICE_FUTURE_VALUE, i, fv);
+	}
+}
+
 int Node::get_yield_data(int tid1, int tid2) const {
 	if (tid1<num_threads && tid2 < num_threads)
 		return yield_data[YIELD_INDEX(tid1,tid2,num_threads)];
@@ -101,7 +408,7 @@ int Node::get_yield_data(int tid1, int tid2) const {
 
 void Node::update_yield(Scheduler * scheduler) {
 	if (yield_data==NULL)
-		yield_data=(int *) model_calloc(1, sizeof(int)*num_threads*num_threads);
+		yield_data=(int *) spill_calloc(1, sizeof(int)*num_threads*num_threads);
 	//handle base case
 	if (parent == NULL) {
 		for(int i = 0; i < num_threads*num_threads; i++) {
@@ -148,10 +455,12 @@ Node::~Node()
 	delete action;
 	if (uninit_action)
 		delete uninit_action;
+	if (fairness)
+		spill_free(fairness);
 	if (enabled_array)
-		model_free(enabled_array);
+		spill_free(enabled_array);
 	if (yield_data)
-		model_free(yield_data);
+		spill_free(yield_data);
 }
 
 /** Prints debugging info for the ModelAction associated with this Node */
@@ -169,24 +478,24 @@ void Node::print() const
 	} else
 		model_print("(info not available)\n");
 	model_print("          backtrack: %s", backtrack_empty() ? "empty" : "non-empty ");
-	for (int i = 0; i < (int)backtrack.size(); i++)
-		if (backtrack[i] == true)
+	for (int i = 0; i < backtrack.size(); i++)
+		if (backtrack.get(i))
 			model_print("[%d]", i);
 	model_print("\n");
 
 	model_print("          read from past: %s", read_from_past_empty() ? "empty" : "non-empty ");
-	for (int i = read_from_past_idx + 1; i < (int)read_from_past.size(); i++)
-		model_print("[%d]", read_from_past[i]->get_seq_number());
+	for (int i = read_from_past_idx + 1; i < get_read_from_past_size(); i++)
+		model_print("[%d]", get_read_from_past(i)->get_seq_number());
 	model_print("\n");
 
 	model_print("          read-from promises: %s", read_from_promise_empty() ? "empty" : "non-empty ");
-	for (int i = read_from_promise_idx + 1; i < (int)read_from_promises.size(); i++)
-		model_print("[%d]", read_from_promises[i]->get_seq_number());
+	for (int i = read_from_promise_idx + 1; i < get_read_from_promise_size(); i++)
+		model_print("[%d]", choices.get<const ModelAction *>(CHOICE_READ_FROM_PROMISE, i)->get_seq_number());
 	model_print("\n");
 
 	model_print("          future values: %s", future_value_empty() ? "empty" : "non-empty ");
-	for (int i = future_index + 1; i < (int)future_values.size(); i++)
-		model_print("[%#" PRIx64 "]", future_values[i].value);
+	for (int i = future_index + 1; i < get_future_value_size(); i++)
+		model_print("[%#" PRIx64 "]", get_future_value(i).value);
 	model_print("\n");
 
 	model_print("          promises: %s\n", promise_empty() ? "empty" : "non-empty");
@@ -194,6 +503,39 @@ void Node::print() const
 	model_print("          rel seq break: %s\n", relseq_break_empty() ? "empty" : "non-empty");
 }
 
+/** @return The memory held by this Node, in bytes */
+size_t Node::get_footprint() const
+{
+	size_t bytes = sizeof(*this);
+	bytes += explored_children.get_footprint() + backtrack.get_footprint();
+	bytes += choices.get_footprint();
+	if (fairness)
+		bytes += num_threads * sizeof(struct fairness_info);
+	if (enabled_array)
+		bytes += num_threads * sizeof(enabled_type_t);
+	if (yield_data)
+		bytes += num_threads * num_threads * sizeof(int);
+	return bytes;
+}
+
+/**
+ * @brief Keep this Node and everything it holds resident when spilling (see
+ * spill_mark_hot())
+ */
+void Node::mark_hot() const
+{
+	spill_mark_hot(this, sizeof(*this));
+	explored_children.mark_hot();
+	backtrack.mark_hot();
+	choices.mark_hot();
+	if (fairness)
+		spill_mark_hot(fairness, num_threads * sizeof(*fairness));
+	if (enabled_array)
+		spill_mark_hot(enabled_array, num_threads * sizeof(*enabled_array));
+	if (yield_data)
+		spill_mark_hot(yield_data, num_threads * num_threads * sizeof(*yield_data));
+}
+
 /****************************** threads backtracking **************************/
 
 /**
@@ -206,7 +548,7 @@ void Node::print() const
 bool Node::has_been_explored(thread_id_t tid) const
 {
 	int id = id_to_int(tid);
-	return explored_children[id];
+	return explored_children.get(id);
 }
 
 /**
@@ -218,15 +560,30 @@ bool Node::backtrack_empty() const
 	return (numBacktracks == 0);
 }
 
+/**
+ * @param tid is the thread ID to check
+ * @return true if this thread choice is still pending in the backtracking set
+ */
+bool Node::has_backtrack(thread_id_t tid) const
+{
+	int i = id_to_int(tid);
+	return i < backtrack.size() && backtrack.get(i);
+}
+
+/**
+ * Mark a thread choice as explored from this Node, removing it from the
+ * backtracking set if present.
+ * @param tid is the thread ID that was (or is being) explored
+ */
 void Node::explore(thread_id_t tid)
 {
 	int i = id_to_int(tid);
-	ASSERT(i < ((int)backtrack.size()));
-	if (backtrack[i]) {
-		backtrack[i] = false;
+	ASSERT(i < backtrack.size());
+	if (backtrack.get(i)) {
+		backtrack.reset(i);
 		numBacktracks--;
 	}
-	explored_children[i] = true;
+	explored_children.set(i);
 }
 
 /**
@@ -236,7 +593,7 @@ void Node::explore(thread_id_t tid)
 void Node::explore_child(ModelAction *act, enabled_type_t *is_enabled)
 {
 	if (!enabled_array)
-		enabled_array = (enabled_type_t *)model_malloc(sizeof(enabled_type_t) * num_threads);
+		enabled_array = (enabled_type_t *)spill_malloc(sizeof(enabled_type_t) * num_threads);
 	if (is_enabled != NULL)
 		memcpy(enabled_array, is_enabled, sizeof(enabled_type_t) * num_threads);
 	else {
@@ -257,35 +614,29 @@ void Node::explore_child(ModelAction *act, enabled_type_t *is_enabled)
 bool Node::set_backtrack(thread_id_t id)
 {
 	int i = id_to_int(id);
-	ASSERT(i < ((int)backtrack.size()));
-	if (backtrack[i])
+	ASSERT(i < backtrack.size());
+	if (backtrack.get(i))
 		return false;
-	backtrack[i] = true;
+	backtrack.set(i);
 	numBacktracks++;
 	return true;
 }
 
 thread_id_t Node::get_next_backtrack()
 {
-	/** @todo Find next backtrack */
-	unsigned int i;
-	for (i = 0; i < backtrack.size(); i++)
-		if (backtrack[i] == true)
-			break;
+	int i = backtrack.find_first();
 	/* Backtrack set was empty? */
-	ASSERT(i != backtrack.size());
+	ASSERT(i >= 0);
 
-	backtrack[i] = false;
+	backtrack.reset(i);
 	numBacktracks--;
 	return int_to_id(i);
 }
 
 void Node::clear_backtracking()
 {
-	for (unsigned int i = 0; i < backtrack.size(); i++)
-		backtrack[i] = false;
-	for (unsigned int i = 0; i < explored_children.size(); i++)
-		explored_children[i] = false;
+	backtrack.clear();
+	explored_children.clear();
 	numBacktracks = 0;
 }
 
@@ -299,9 +650,10 @@ void Node::clear_backtracking()
  */
 void Node::set_promise(unsigned int i)
 {
-	if (i >= resolve_promise.size())
-		resolve_promise.resize(i + 1, false);
-	resolve_promise[i] = true;
+	unsigned int size = choices.size(CHOICE_RESOLVE_PROMISE);
+	if (i >= size)
+		choices.append(CHOICE_RESOLVE_PROMISE, i + 1 - size);
+	choices.set<bool>(CHOICE_RESOLVE_PROMISE, i, true);
 }
 
 /**
@@ -311,7 +663,7 @@ void Node::set_promise(unsigned int i)
  */
 bool Node::get_promise(unsigned int i) const
 {
-	return (i < resolve_promise.size()) && (int)i == resolve_promise_idx;
+	return (i < choices.size(CHOICE_RESOLVE_PROMISE)) && (int)i == resolve_promise_idx;
 }
 
 /**
@@ -321,12 +673,12 @@ bool Node::get_promise(unsigned int i) const
 bool Node::increment_promise()
 {
 	DBG();
-	if (resolve_promise.empty())
+	if (choices.empty(CHOICE_RESOLVE_PROMISE))
 		return false;
 	int prev_idx = resolve_promise_idx;
 	resolve_promise_idx++;
-	for ( ; resolve_promise_idx < (int)resolve_promise.size(); resolve_promise_idx++)
-		if (resolve_promise[resolve_promise_idx])
+	for ( ; resolve_promise_idx < (int)choices.size(CHOICE_RESOLVE_PROMISE); resolve_promise_idx++)
+		if (choices.get<bool>(CHOICE_RESOLVE_PROMISE, resolve_promise_idx))
 			return true;
 	resolve_promise_idx = prev_idx;
 	return false;
@@ -338,8 +690,8 @@ bool Node::increment_promise()
  */
 bool Node::promise_empty() const
 {
-	for (int i = resolve_promise_idx + 1; i < (int)resolve_promise.size(); i++)
-		if (i >= 0 && resolve_promise[i])
+	for (int i = resolve_promise_idx + 1; i < (int)choices.size(CHOICE_RESOLVE_PROMISE); i++)
+		if (i >= 0 && choices.get<bool>(CHOICE_RESOLVE_PROMISE, i))
 			return false;
 	return true;
 }
@@ -347,7 +699,7 @@ bool Node::promise_empty() const
 /** @brief Clear any promise-resolution information for this Node */
 void Node::clear_promise_resolutions()
 {
-	resolve_promise.clear();
+	choices.clear(CHOICE_RESOLVE_PROMISE);
 	resolve_promise_idx = -1;
 }
 
@@ -412,7 +764,7 @@ bool Node::has_priority_over(thread_id_t tid1, thread_id_t tid2) const
  */
 read_from_type_t Node::get_read_from_status()
 {
-	if (read_from_status == READ_FROM_PAST && read_from_past.empty())
+	if (read_from_status == READ_FROM_PAST && choices.empty(CHOICE_READ_FROM_PAST))
 		increment_read_from();
 	return read_from_status;
 }
@@ -456,9 +808,9 @@ bool Node::read_from_empty() const
  */
 unsigned int Node::read_from_size() const
 {
-	return read_from_past.size() +
-		read_from_promises.size() +
-		future_values.size();
+	return choices.size(CHOICE_READ_FROM_PAST) +
+		choices.size(CHOICE_READ_FROM_PROMISE) +
+		choices.size(CHOICE_FUTURE_VALUE);
 }
 
 /******************************* end read from ********************************/
@@ -468,8 +820,8 @@ unsigned int Node::read_from_size() const
 /** @brief Prints info about read_from_past set */
 void Node::print_read_from_past()
 {
-	for (unsigned int i = 0; i < read_from_past.size(); i++)
-		read_from_past[i]->print();
+	for (int i = 0; i < get_read_from_past_size(); i++)
+		get_read_from_past(i)->print();
 }
 
 /**
@@ -478,7 +830,7 @@ void Node::print_read_from_past()
  */
 void Node::add_read_from_past(const ModelAction *act)
 {
-	read_from_past.push_back(act);
+	choices.push_back(CHOICE_READ_FROM_PAST, act);
 }
 
 /**
@@ -488,20 +840,20 @@ void Node::add_read_from_past(const ModelAction *act)
  */
 const ModelAction * Node::get_read_from_past() const
 {
-	if (read_from_past_idx < read_from_past.size())
-		return read_from_past[read_from_past_idx];
+	if (read_from_past_idx < choices.size(CHOICE_READ_FROM_PAST))
+		return get_read_from_past(read_from_past_idx);
 	else
 		return NULL;
 }
 
 const ModelAction * Node::get_read_from_past(int i) const
 {
-	return read_from_past[i];
+	return choices.get<const ModelAction *>(CHOICE_READ_FROM_PAST, i);
 }
 
 int Node::get_read_from_past_size() const
 {
-	return read_from_past.size();
+	return choices.size(CHOICE_READ_FROM_PAST);
 }
 
 /**
@@ -510,7 +862,7 @@ int Node::get_read_from_past_size() const
  */
 bool Node::read_from_past_empty() const
 {
-	return ((read_from_past_idx + 1) >= read_from_past.size());
+	return ((read_from_past_idx + 1) >= choices.size(CHOICE_READ_FROM_PAST));
 }
 
 /**
@@ -520,9 +872,9 @@ bool Node::read_from_past_empty() const
 bool Node::increment_read_from_past()
 {
 	DBG();
-	if (read_from_past_idx < read_from_past.size()) {
+	if (read_from_past_idx < choices.size(CHOICE_READ_FROM_PAST)) {
 		read_from_past_idx++;
-		return read_from_past_idx < read_from_past.size();
+		return read_from_past_idx < choices.size(CHOICE_READ_FROM_PAST);
 	}
 	return false;
 }
@@ -538,7 +890,7 @@ bool Node::increment_read_from_past()
  */
 void Node::add_read_from_promise(const ModelAction *reader)
 {
-	read_from_promises.push_back(reader);
+	choices.push_back(CHOICE_READ_FROM_PROMISE, reader);
 }
 
 /**
@@ -548,8 +900,8 @@ void Node::add_read_from_promise(const ModelAction *reader)
  */
 Promise * Node::get_read_from_promise() const
 {
-	ASSERT(read_from_promise_idx >= 0 && read_from_promise_idx < ((int)read_from_promises.size()));
-	return read_from_promises[read_from_promise_idx]->get_reads_from_promise();
+	ASSERT(read_from_promise_idx >= 0 && read_from_promise_idx < get_read_from_promise_size());
+	return get_read_from_promise(read_from_promise_idx);
 }
 
 /**
@@ -561,13 +913,13 @@ Promise * Node::get_read_from_promise() const
  */
 Promise * Node::get_read_from_promise(int i) const
 {
-	return read_from_promises[i]->get_reads_from_promise();
+	return choices.get<const ModelAction *>(CHOICE_READ_FROM_PROMISE, i)->get_reads_from_promise();
 }
 
 /** @return The size of the read-from-promise set */
 int Node::get_read_from_promise_size() const
 {
-	return read_from_promises.size();
+	return choices.size(CHOICE_READ_FROM_PROMISE);
 }
 
 /**
@@ -576,7 +928,7 @@ int Node::get_read_from_promise_size() const
  */
 bool Node::read_from_promise_empty() const
 {
-	return ((read_from_promise_idx + 1) >= ((int)read_from_promises.size()));
+	return ((read_from_promise_idx + 1) >= get_read_from_promise_size());
 }
 
 /**
@@ -586,9 +938,9 @@ bool Node::read_from_promise_empty() const
 bool Node::increment_read_from_promise()
 {
 	DBG();
-	if (read_from_promise_idx < ((int)read_from_promises.size())) {
+	if (read_from_promise_idx < get_read_from_promise_size()) {
 		read_from_promise_idx++;
-		return (read_from_promise_idx < ((int)read_from_promises.size()));
+		return (read_from_promise_idx < get_read_from_promise_size());
 	}
 	return false;
 }
@@ -613,28 +965,31 @@ bool Node::add_future_value(struct future_value fv)
 	modelclock_t expiration = fv.expiration;
 	thread_id_t tid = fv.tid;
 	int idx = -1; /* Highest index where value is found */
-	for (unsigned int i = 0; i < future_values.size(); i++) {
-		if (future_values[i].value == value && future_values[i].tid == tid) {
-			if (expiration <= future_values[i].expiration)
+	for (int i = 0; i < get_future_value_size(); i++) {
+		struct future_value other = get_future_value(i);
+		if (other.value == value && other.tid == tid) {
+			if (expiration <= other.expiration)
 				return false;
 			idx = i;
 		}
 	}
 	if (idx > future_index) {
 		/* Future value hasn't been explored; update expiration */
-		future_values[idx].expiration = expiration;
+		struct future_value updated = get_future_value(idx);
+		updated.expiration = expiration;
+		choices.set(CHOICE_FUTURE_VALUE, idx, updated);
 		return true;
-	} else if (idx >= 0 && expiration <= future_values[idx].expiration + get_params()->expireslop) {
+	} else if (idx >= 0 && expiration <= get_future_value(idx).expiration + get_params()->expireslop) {
 		/* Future value has been explored and is within the "sloppy" window */
 		return false;
 	}
 
 	/* Limit the size of the future-values set */
 	if (get_params()->maxfuturevalues > 0 &&
-			(int)future_values.size() >= get_params()->maxfuturevalues)
+			get_future_value_size() >= get_params()->maxfuturevalues)
 		return false;
 
-	future_values.push_back(fv);
+	choices.push_back(CHOICE_FUTURE_VALUE, fv);
 	return true;
 }
 
@@ -645,8 +1000,25 @@ bool Node::add_future_value(struct future_value fv)
  */
 struct future_value Node::get_future_value() const
 {
-	ASSERT(future_index >= 0 && future_index < ((int)future_values.size()));
-	return future_values[future_index];
+	ASSERT(future_index >= 0 && future_index < get_future_value_size());
+	return get_future_value(future_index);
+}
+
+/**
+ * Gets a particular 'future_value' from this Node. Only valid for a node where
+ * this->action is a 'read'.
+ * @param i The index of the future value to get
+ * @return The future value at index i
+ */
+struct future_value Node::get_future_value(int i) const
+{
+	return choices.get<struct future_value>(CHOICE_FUTURE_VALUE, i);
+}
+
+/** @return The size of the future_values set */
+int Node::get_future_value_size() const
+{
+	return choices.size(CHOICE_FUTURE_VALUE);
 }
 
 /**
@@ -655,7 +1027,7 @@ struct future_value Node::get_future_value() const
  */
 bool Node::future_value_empty() const
 {
-	return ((future_index + 1) >= ((int)future_values.size()));
+	return ((future_index + 1) >= get_future_value_size());
 }
 
 /**
@@ -665,9 +1037,9 @@ bool Node::future_value_empty() const
 bool Node::increment_future_value()
 {
 	DBG();
-	if (future_index < ((int)future_values.size())) {
+	if (future_index < get_future_value_size()) {
 		future_index++;
-		return (future_index < ((int)future_values.size()));
+		return (future_index < get_future_value_size());
 	}
 	return false;
 }
@@ -686,7 +1058,7 @@ bool Node::increment_future_value()
  */
 void Node::add_relseq_break(const ModelAction *write)
 {
-	relseq_break_writes.push_back(write);
+	choices.push_back(CHOICE_RELSEQ_BREAK, write);
 }
 
 /**
@@ -698,8 +1070,8 @@ void Node::add_relseq_break(const ModelAction *write)
  */
 const ModelAction * Node::get_relseq_break() const
 {
-	if (relseq_break_index < (int)relseq_break_writes.size())
-		return relseq_break_writes[relseq_break_index];
+	if (relseq_break_index < (int)choices.size(CHOICE_RELSEQ_BREAK))
+		return choices.get<const ModelAction *>(CHOICE_RELSEQ_BREAK, relseq_break_index);
 	else
 		return NULL;
 }
@@ -712,9 +1084,9 @@ const ModelAction * Node::get_relseq_break() const
 bool Node::increment_relseq_break()
 {
 	DBG();
-	if (relseq_break_index < ((int)relseq_break_writes.size())) {
+	if (relseq_break_index < (int)choices.size(CHOICE_RELSEQ_BREAK)) {
 		relseq_break_index++;
-		return (relseq_break_index < ((int)relseq_break_writes.size()));
+		return (relseq_break_index < (int)choices.size(CHOICE_RELSEQ_BREAK));
 	}
 	return false;
 }
@@ -725,7 +1097,7 @@ bool Node::increment_relseq_break()
  */
 bool Node::relseq_break_empty() const
 {
-	return ((relseq_break_index + 1) >= ((int)relseq_break_writes.size()));
+	return ((relseq_break_index + 1) >= (int)choices.size(CHOICE_RELSEQ_BREAK));
 }
 
 /******************* end breaking release sequences ***************************/
@@ -751,10 +1123,27 @@ bool Node::increment_behaviors()
 	return false;
 }
 
+/**
+ * @return True if all behaviors (misc, promise, read-from, and release
+ * sequence choices) have been explored; i.e., increment_behaviors() would fail
+ */
+bool Node::behaviors_empty() const
+{
+	return misc_empty() &&
+		promise_empty() &&
+		read_from_empty() &&
+		relseq_break_empty();
+}
+
 NodeStack::NodeStack() :
 	node_list(),
+	execution(NULL),
 	head_idx(-1),
-	total_nodes(0)
+	total_nodes(0),
+	relocated(0),
+	relocations(NULL),
+	deepest(0),
+	deepest_bytes(0)
 {
 	total_nodes++;
 }
@@ -763,6 +1152,7 @@ NodeStack::~NodeStack()
 {
 	for (unsigned int i = 0; i < node_list.size(); i++)
 		delete node_list[i];
+	delete relocations;
 }
 
 /**
@@ -799,6 +1189,10 @@ ModelAction * NodeStack::explore_action(ModelAction *act, enabled_type_t *is_ena
 
 	if ((head_idx + 1) < (int)node_list.size()) {
 		head_idx++;
+		if (head_idx >= relocated) {
+			relocate(node_list[head_idx], act);
+			relocated = head_idx + 1;
+		}
 		return node_list[head_idx]->get_action();
 	}
 
@@ -817,6 +1211,9 @@ ModelAction * NodeStack::explore_action(ModelAction *act, enabled_type_t *is_ena
 	node_list.push_back(new Node(get_params(), act, head, next_threads, prevfairness));
 	total_nodes++;
 	head_idx++;
+	relocated = node_list.size();
+	if (node_list.size() % SPILL_CHECK_INTERVAL == 0)
+		spill_cold_nodes();
 	return NULL;
 }
 
@@ -838,6 +1235,18 @@ void NodeStack::pop_restofstack(int numAhead)
 	node_list.back()->clear_backtracking();
 }
 
+/**
+ * Empties the stack of all nodes after a given absolute position, without
+ * touching the backtracking state of the remaining nodes.
+ * @param idx The index of the last Node to keep
+ */
+void NodeStack::pop_after(int idx)
+{
+	for (unsigned int i = idx + 1; i < node_list.size(); i++)
+		delete node_list[i];
+	node_list.resize(idx + 1);
+}
+
 /** Reset the node stack. */
 void NodeStack::full_reset() 
 {
@@ -869,7 +1278,197 @@ Node * NodeStack::get_next() const
 	return node_list[it];
 }
 
+/**
+ * @param idx The absolute position of the Node in the stack
+ * @return The Node at position idx, or NULL if out of range
+ */
+Node * NodeStack::get_node(int idx) const
+{
+	if (idx < 0 || idx >= (int)node_list.size())
+		return NULL;
+	return node_list[idx];
+}
+
+/**
+ * @param node The Node to look up
+ * @return The absolute position of node in the stack, or -1 if not present
+ */
+int NodeStack::get_index(const Node *node) const
+{
+	for (int i = (int)node_list.size() - 1; i >= 0; i--)
+		if (node_list[i] == node)
+			return i;
+	return -1;
+}
+
+/**
+ * @brief Find the next divergence point directly from the NodeStack
+ *
+ * This mirrors ModelExecution::get_next_backtrack() without requiring a fresh
+ * execution: the next divergence is the most recent Node which either has an
+ * unexplored behavior or whose parent has an unexplored thread choice.
+ *
+ * @return The ModelAction at which the next execution should diverge, or NULL
+ * if the stack has been fully explored
+ */
+ModelAction * NodeStack::get_next_backtrack() const
+{
+	for (int i = (int)node_list.size() - 1; i >= 0; i--) {
+		Node *node = node_list[i];
+		Node *parent = node->get_parent();
+		if ((parent && !parent->backtrack_empty()) || !node->behaviors_empty())
+			return node->get_action();
+	}
+	return NULL;
+}
+
+/** @return The memory held by all the Nodes on the stack, in bytes */
+size_t NodeStack::get_footprint() const
+{
+	size_t bytes = 0;
+	for (unsigned int i = 0; i < node_list.size(); i++)
+		bytes += node_list[i]->get_footprint();
+	return bytes;
+}
+
+/**
+ * @brief If too much of the spill file is resident, page out all but the
+ * Nodes near the head
+ */
+void NodeStack::spill_cold_nodes() const
+{
+	if (!spill_over_limit())
+		return;
+	int first_hot = head_idx - SPILL_HOT_NODES;
+	for (int i = first_hot < 0 ? 0 : first_hot; i < (int)node_list.size(); i++)
+		node_list[i]->mark_hot();
+	spill_page_out();
+}
+
 void NodeStack::reset_execution()
 {
+	if (execution && get_params()->verbose && node_list.size() > deepest) {
+		deepest = node_list.size();
+		deepest_bytes = get_footprint();
+	}
+	spill_cold_nodes();
+	head_idx = -1;
+}
+
+/**
+ * @brief Write the whole stack to a checkpoint
+ *
+ * The actions of all the Nodes (and the ATOMIC_UNINIT actions created at
+ * them) come first, so that each Node can then refer to any of them.
+ *
+ * @param writer The checkpoint
+ */
+void NodeStack::checkpoint(CheckpointWriter *writer) const
+{
+	writer->put(total_nodes);
+	writer->put(node_list.size());
+	for (unsigned int i = 0; i < node_list.size(); i++) {
+		const ModelAction *act = node_list[i]->get_action();
+		const ModelAction *uninit = node_list[i]->get_uninit_action();
+		writer->add_action(act);
+		act->checkpoint(writer);
+		writer->put(uninit != NULL);
+		if (uninit) {
+			writer->add_action(uninit);
+			uninit->checkpoint(writer);
+		}
+	}
+	for (unsigned int i = 0; i < node_list.size(); i++)
+		node_list[i]->checkpoint(writer);
+}
+
+/**
+ * @brief Restore the stack written by NodeStack::checkpoint() into this,
+ * empty, stack
+ *
+ * The next execution replays the restored Nodes from the start, updating
+ * the addresses held by their actions as it goes.
+ *
+ * @param reader The checkpoint
+ * @return False if the checkpoint is malformed
+ */
+bool NodeStack::restore(CheckpointReader *reader)
+{
+	ASSERT(node_list.empty());
+	total_nodes = reader->get();
+	unsigned int num = reader->get();
+
+	ModelVector<ModelAction *> actions;
+	ModelVector<ModelAction *> uninits;
+	for (unsigned int i = 0; i < num && !reader->failed(); i++) {
+		ModelAction *act = new ModelAction(reader);
+		ModelAction *uninit = NULL;
+		reader->add_action(act);
+		if (reader->get()) {
+			uninit = new ModelAction(reader);
+			reader->add_action(uninit);
+		}
+		actions.push_back(act);
+		uninits.push_back(uninit);
+	}
+	for (unsigned int i = 0; i < num && !reader->failed(); i++) {
+		Node *node = new Node(get_params(), actions[i], get_head(), reader);
+		node->set_uninit_action(uninits[i]);
+		node_list.push_back(node);
+		head_idx++;
+	}
 	head_idx = -1;
+	relocated = 0;
+	if (!relocations)
+		relocations = new relocation_table_t();
+	return !reader->failed();
+}
+
+/**
+ * @brief Record that the page holding an address in the run which wrote the
+ * checkpoint holds another address in this run
+ */
+void NodeStack::add_relocation(uint64_t from, uint64_t to)
+{
+	uintptr_t page = from / PAGESIZE;
+	if (page && from != to && !relocations->contains(page))
+		relocations->put(page, to - from);
+}
+
+/**
+ * @brief Move a Node restored from a checkpoint to this run's addresses, as
+ * its action is replayed for the first time
+ *
+ * The action takes its addresses from the program's action for the same
+ * step (see ModelAction::relocate()). The future values the Node may read
+ * are values written later on in the execution, though, so they cannot be
+ * taken from this run yet; instead, each page of the locations and written
+ * values replayed so far is remembered with the distance it moved, and a
+ * future value which falls into such a page is moved by as much.
+ *
+ * @param node The Node
+ * @param act The program's action for the step
+ */
+void NodeStack::relocate(Node *node, ModelAction *act)
+{
+	ModelAction *old = node->get_action();
+	if (old->get_location() && act->get_location())
+		add_relocation((uintptr_t)old->get_location(), (uintptr_t)act->get_location());
+	if (!act->is_read())
+		add_relocation(old->get_value(), act->get_value());
+	old->relocate(act);
+	node->relocate_future_values(relocations);
+}
+
+/** @brief Print statistics on the memory held by Nodes */
+void NodeStack::print_stats() const
+{
+	unsigned int depth = deepest;
+	size_t bytes = deepest_bytes;
+	if (node_list.size() > depth) {
+		depth = node_list.size();
+		bytes = get_footprint();
+	}
+	model_print("Deepest node stack: %u nodes, %zu bytes per node\n",
+			depth, depth ? bytes / depth : 0);
 }
@@ -12,9 +12,13 @@
 #include "schedule.h"
 #include "promise.h"
 #include "stl-model.h"
+#include "swisstable.h"
+#include "spill.h"
 
 class ModelAction;
 class Thread;
+class CheckpointWriter;
+class CheckpointReader;
 
 struct fairness_info {
 	unsigned int enabled_count;
@@ -42,6 +46,97 @@ typedef enum {
 #define YIELD_P 8
 #define YIELD_INDEX(tid1, tid2, num_threads) (tid1*num_threads+tid2)
 
+/**
+ * @brief Maps each page of addresses in the run which wrote a checkpoint to
+ * the distance it moved in the run resuming from it (see
+ * NodeStack::relocate())
+ */
+typedef SwissTable<uintptr_t, intptr_t, uintptr_t, 0, model_malloc, model_calloc, model_free> relocation_table_t;
+
+/**
+ * @brief A fixed-size set of thread IDs
+ *
+ * Up to 64 threads are held inline in a single word; larger sets are
+ * allocated from the non-snapshotting heap.
+ */
+class ThreadBitSet {
+public:
+	ThreadBitSet(int size);
+	~ThreadBitSet();
+	int size() const { return num_bits; }
+	bool get(int i) const { return (words()[i / 64] >> (i % 64)) & 1; }
+	void set(int i) { words()[i / 64] |= (uint64_t)1 << (i % 64); }
+	void reset(int i) { words()[i / 64] &= ~((uint64_t)1 << (i % 64)); }
+	void clear();
+	int find_first() const;
+	size_t get_footprint() const;
+	void mark_hot() const;
+	void checkpoint(CheckpointWriter *writer) const;
+	void restore(CheckpointReader *reader);
+
+	MEMALLOC
+private:
+	int num_words() const { return (num_bits + 63) / 64; }
+	uint64_t * words() { return num_bits > 64 ? array : &word; }
+	const uint64_t * words() const { return num_bits > 64 ? array : &word; }
+
+	const int num_bits;
+	union {
+		uint64_t word;
+		uint64_t *array;
+	};
+};
+
+/** @brief The variable-length choice lists held by a Node */
+enum {
+	CHOICE_READ_FROM_PAST, /**< @brief Past writes a read may read from */
+	CHOICE_READ_FROM_PROMISE, /**< @brief Reads whose promises a read may read from */
+	CHOICE_FUTURE_VALUE, /**< @brief Future values a read may read */
+	CHOICE_RESOLVE_PROMISE, /**< @brief Promises a write may resolve */
+	CHOICE_RELSEQ_BREAK, /**< @brief Writes which may break a release sequence */
+	NUM_CHOICE_LISTS
+};
+
+/**
+ * @brief All of a Node's choice lists, in one allocation
+ *
+ * The lists are laid out back to back (each padded to 8 bytes) in a single
+ * buffer, which is only allocated once some list is non-empty; most Nodes
+ * never have any choices. Appending to a list moves the lists after it up.
+ */
+class ChoiceLists {
+public:
+	ChoiceLists();
+	~ChoiceLists();
+	unsigned int size(int list) const { return len[list]; }
+	bool empty(int list) const { return len[list] == 0; }
+
+	template <typename T>
+	T get(int list, unsigned int i) const {
+		return ((const T *)(buf + offset(list)))[i];
+	}
+	template <typename T>
+	void set(int list, unsigned int i, T val) {
+		((T *)(buf + offset(list)))[i] = val;
+	}
+	template <typename T>
+	void push_back(int list, T val) {
+		*(T *)append(list, 1) = val;
+	}
+
+	void * append(int list, unsigned int n);
+	void clear(int list);
+	size_t get_footprint() const { return capacity; }
+	void mark_hot() const;
+private:
+	static size_t segment_size(int list, unsigned int n);
+	size_t offset(int list) const;
+
+	char *buf;
+	unsigned int capacity;
+	unsigned int len[NUM_CHOICE_LISTS];
+};
+
 
 /**
  * @brief A single node in a NodeStack
@@ -56,13 +151,18 @@ class Node {
 public:
 	Node(const struct model_params *params, ModelAction *act, Node *par,
 			int nthreads, Node *prevfairness);
+	Node(const struct model_params *params, ModelAction *act, Node *par,
+			CheckpointReader *reader);
 	~Node();
 	/* return true = thread choice has already been explored */
 	bool has_been_explored(thread_id_t tid) const;
 	/* return true = backtrack set is empty */
 	bool backtrack_empty() const;
+	/* return true = thread choice is pending in the backtrack set */
+	bool has_backtrack(thread_id_t tid) const;
 
 	void clear_backtracking();
+	void explore(thread_id_t tid);
 	void explore_child(ModelAction *act, enabled_type_t *is_enabled);
 	/* return false = thread was already in backtrack */
 	bool set_backtrack(thread_id_t id);
@@ -101,6 +201,8 @@ public:
 
 	bool add_future_value(struct future_value fv);
 	struct future_value get_future_value() const;
+	struct future_value get_future_value(int i) const;
+	int get_future_value_size() const;
 
 	void set_promise(unsigned int i);
 	bool get_promise(unsigned int i) const;
@@ -121,12 +223,16 @@ public:
 	bool relseq_break_empty() const;
 
 	bool increment_behaviors();
+	bool behaviors_empty() const;
 
 	void print() const;
+	size_t get_footprint() const;
+	void mark_hot() const;
+	void checkpoint(CheckpointWriter *writer) const;
+	void relocate_future_values(const relocation_table_t *relocations);
 
-	MEMALLOC
+	SPILLALLOC
 private:
-	void explore(thread_id_t tid);
 	int get_yield_data(int tid1, int tid2) const;
 	bool read_from_past_empty() const;
 	bool increment_read_from_past();
@@ -146,33 +252,30 @@ private:
 
 	Node * const parent;
 	const int num_threads;
-	ModelVector<bool> explored_children;
-	ModelVector<bool> backtrack;
-	ModelVector<struct fairness_info> fairness;
+	ThreadBitSet explored_children;
+	ThreadBitSet backtrack;
+	/** @brief Per-thread fairness state; only allocated if fairwindow is set */
+	struct fairness_info *fairness;
 	int numBacktracks;
 	enabled_type_t *enabled_array;
 
 	/**
-	 * The set of past ModelActions that this the action at this Node may
-	 * read from. Only meaningful if this Node represents a 'read' action.
+	 * The past ModelActions that the action at this Node may read from, the
+	 * reads whose promises it may read from, the future values it may
+	 * read, the promises it may resolve, and the writes which may break
+	 * its release sequence. Only the lists which apply to the action are
+	 * ever non-empty.
 	 */
-	ModelVector<const ModelAction *> read_from_past;
+	ChoiceLists choices;
 	unsigned int read_from_past_idx;
-
-	ModelVector<const ModelAction *> read_from_promises;
 	int read_from_promise_idx;
-
-	ModelVector<struct future_value> future_values;
 	int future_index;
-
-	ModelVector<bool> resolve_promise;
 	int resolve_promise_idx;
-
-	ModelVector<const ModelAction *> relseq_break_writes;
 	int relseq_break_index;
 
 	int misc_index;
 	int misc_max;
+	/** @brief The yield matrix; only allocated if yieldon is set */
 	int * yield_data;
 };
 
@@ -196,18 +299,34 @@ public:
 	ModelAction * explore_action(ModelAction *act, enabled_type_t * is_enabled);
 	Node * get_head() const;
 	Node * get_next() const;
+	Node * get_node(int idx) const;
+	int get_index(const Node *node) const;
+	int get_num_nodes() const { return node_list.size(); }
+	/** @return True if the head Node is followed by Nodes recorded in an
+	 *  earlier execution; i.e., we are replaying a prefix of that execution */
+	bool in_replay_prefix() const { return head_idx + 1 < (int)node_list.size(); }
+	ModelAction * get_next_backtrack() const;
 	void reset_execution();
 	void pop_restofstack(int numAhead);
+	void pop_after(int idx);
 	void full_reset();
 	int get_total_nodes() { return total_nodes; }
 
 	void print() const;
+	void print_stats() const;
+
+	void checkpoint(CheckpointWriter *writer) const;
+	bool restore(CheckpointReader *reader);
 
 	MEMALLOC
 private:
 	node_list_t node_list;
 
 	const struct model_params * get_params() const;
+	size_t get_footprint() const;
+	void spill_cold_nodes() const;
+	void relocate(Node *node, ModelAction *act);
+	void add_relocation(uint64_t from, uint64_t to);
 
 	/** @brief The model-checker execution object */
 	const ModelExecution *execution;
@@ -221,6 +340,21 @@ private:
 	int head_idx;
 
 	int total_nodes;
+
+	/**
+	 * @brief The Nodes from this index on were restored from a checkpoint
+	 * and have not been replayed since (see ModelAction::relocate())
+	 */
+	int relocated;
+
+	/** @brief How the pages seen so far moved since the checkpoint, while
+	 *  relocating restored Nodes */
+	relocation_table_t *relocations;
+
+	/** @brief The most Nodes on the stack at the end of an execution */
+	unsigned int deepest;
+	/** @brief The memory held by the Nodes at that depth, in bytes */
+	size_t deepest_bytes;
 };
 
 #endif /* __NODESTACK_H__ */
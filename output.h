@@ -9,10 +9,12 @@
 
 #ifdef CONFIG_DEBUG
 static inline void redirect_output() { }
+static inline void redirect_program_output() { }
 static inline void clear_program_output() { }
 static inline void print_program_output() { }
 #else
 void redirect_output();
+void redirect_program_output();
 void clear_program_output();
 void print_program_output();
 #endif /* ! CONFIG_DEBUG */
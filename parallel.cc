@@ -0,0 +1,804 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <algorithm>
+
+#include "parallel.h"
+#include "action.h"
+#include "nodestack.h"
+#include "promise.h"
+#include "threads-model.h"
+#include "common.h"
+#include "output.h"
+#include "snapshot-interface.h"
+
+/** @brief Utilization counters for one worker slot */
+struct parallel_slot {
+	/** @brief Nonzero while some worker holds this slot */
+	int busy;
+	/** @brief Number of workers which have held this slot */
+	int num_workers;
+	/** @brief Executions run by workers in this slot */
+	uint64_t executions;
+	/** @brief Time (ns) workers in this slot spent exploring */
+	uint64_t busy_time;
+};
+
+/**
+ * @brief State shared (via an anonymous shared mapping) by every process in
+ * a parallel exploration
+ *
+ * There is one slot per allowed concurrent worker; a process must claim a
+ * free slot before forking a new worker, which bounds the total number of
+ * workers no matter which process forks them.
+ */
+struct parallel_shared {
+	/** @brief When parallel exploration started */
+	uint64_t start_time;
+	int num_slots;
+	struct parallel_slot slots[1];
+};
+
+/** @brief Header of the report a worker leaves behind when it exits */
+struct worker_report_header {
+	/** @brief Stats for the executions run by the worker alone */
+	struct execution_stats stats;
+	int num_backtracks;
+	int num_future_values;
+	/** @brief Workers below this one which terminated abnormally */
+	int num_failed_workers;
+};
+
+/** @brief A thread choice discovered by a worker above its subtree */
+struct backtrack_record {
+	int node;
+	thread_id_t tid;
+};
+
+/** @brief A future value discovered by a worker above its subtree */
+struct future_value_record {
+	int node;
+	struct future_value fv;
+};
+
+/** @return The current monotonic time, in nanoseconds */
+static uint64_t get_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/**
+ * @brief Map the slot table shared by all exploration processes
+ * @param num_slots The maximum number of concurrent workers
+ * @return The shared state, with all slots free
+ */
+static struct parallel_shared * create_shared(int num_slots)
+{
+	size_t size = sizeof(struct parallel_shared) + (num_slots - 1) * sizeof(struct parallel_slot);
+	void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+	struct parallel_shared *shared = (struct parallel_shared *)mem;
+	memset(shared, 0, size);
+	shared->num_slots = num_slots;
+	shared->start_time = get_time();
+	return shared;
+}
+
+/**
+ * @brief Create an anonymous temporary file
+ *
+ * The file is unlinked immediately, so it disappears once every process
+ * holding the descriptor has closed it.
+ *
+ * @return A read/write file descriptor
+ */
+static int make_temp_file()
+{
+	const char *dir = getenv("TMPDIR");
+	char path[PATH_MAX];
+
+	if (!dir || !*dir)
+		dir = "/tmp";
+	snprintf(path, sizeof(path), "%s/cdschecker-XXXXXX", dir);
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		perror("mkstemp");
+		exit(EXIT_FAILURE);
+	}
+	unlink(path);
+	return fd;
+}
+
+static void write_all(int fd, const void *buf, size_t len)
+{
+	const char *p = (const char *)buf;
+	while (len > 0) {
+		ssize_t ret = write(fd, p, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("write");
+			_exit(EXIT_FAILURE);
+		}
+		p += ret;
+		len -= ret;
+	}
+}
+
+/** @return True if exactly len bytes could be read at offset */
+static bool read_all(int fd, void *buf, size_t len, off_t offset)
+{
+	char *p = (char *)buf;
+	while (len > 0) {
+		ssize_t ret = pread(fd, p, len, offset);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return false;
+		p += ret;
+		len -= ret;
+		offset += ret;
+	}
+	return true;
+}
+
+/**
+ * @brief Constructor
+ * @param params The model-checker parameters; params->numworkers gives the
+ * maximum number of concurrently-running workers
+ * @param node_stack The NodeStack to distribute
+ * @param stats The cumulative execution stats, into which workers' stats are
+ * merged
+ */
+ParallelExplorer::ParallelExplorer(const struct model_params *params, NodeStack *node_stack, struct execution_stats *stats) :
+	params(params),
+	node_stack(node_stack),
+	stats(stats),
+	shared(create_shared(params->numworkers)),
+	workers(),
+	exited_siblings(),
+	last_explored(),
+	worker(false),
+	baseline_backtrack(),
+	start_time(0),
+	idle_time(0),
+	thief_executions(0),
+	failed_workers(0)
+{
+	memset(&self, 0, sizeof(self));
+	memset(&baseline_stats, 0, sizeof(baseline_stats));
+}
+
+ParallelExplorer::~ParallelExplorer()
+{
+	while (!workers.empty())
+		wait_for_worker();
+	discard_sibling_state(0);
+	munmap(shared, sizeof(struct parallel_shared) + (shared->num_slots - 1) * sizeof(struct parallel_slot));
+}
+
+/**
+ * @brief Select the next divergence point to explore in this process
+ *
+ * In a worker, the divergence chosen by the ModelExecution is kept only if it
+ * lies within the worker's subtree; otherwise the worker reports back to the
+ * coordinator and exits.
+ *
+ * In the coordinator, this hands out every remaining divergence point to
+ * workers and waits for them all to finish. It only returns (with a non-NULL
+ * action) in the freshly-forked child.
+ *
+ * @param diverge The next divergence point chosen by the ModelExecution
+ * @return The divergence point for the next execution in this process, or
+ * NULL if exploration is complete
+ */
+ModelAction * ParallelExplorer::next_divergence(ModelAction *diverge)
+{
+	if (worker) {
+		if (self.enabled_fd >= 0)
+			send_enabled();
+		reap_workers();
+		while (true) {
+			/* Reports from thieves may have added backtracking points */
+			if (!workers.empty() || thief_executions)
+				diverge = node_stack->get_next_backtrack();
+			if (!diverge || !owns(diverge) || budget_exhausted()) {
+				if (workers.empty())
+					finish_worker();
+				wait_for_worker();
+				continue;
+			}
+			int idx = node_stack->get_index(diverge->get_node());
+			bool switching = diverge->get_node()->behaviors_empty();
+			if (conflicts(idx, switching)) {
+				wait_for_worker();
+				continue;
+			}
+			if (switching) {
+				receive_sibling_state(idx);
+				self.sleep_tid = previous_sibling(diverge, idx);
+			}
+			/* Choices handed out below the divergence point are obsolete */
+			last_explored.resize(std::min((int)last_explored.size(), switching ? idx : idx + 1));
+			discard_sibling_state(switching ? idx : idx + 1);
+			ModelAction *stolen = donate(idx);
+			return stolen ? stolen : diverge;
+		}
+	}
+
+	while (true) {
+		ModelAction *act = node_stack->get_next_backtrack();
+		if (!act || budget_exhausted()) {
+			if (workers.empty())
+				return NULL;
+			wait_for_worker();
+			continue;
+		}
+
+		Node *node = act->get_node();
+		int idx = node_stack->get_index(node);
+		bool switching = node->behaviors_empty();
+		if (conflicts(idx, switching)) {
+			wait_for_worker();
+			continue;
+		}
+		int slot = reserve_slot();
+		if (slot < 0) {
+			wait_for_worker();
+			continue;
+		}
+
+		if (switching) {
+			receive_sibling_state(idx);
+			if (spawn_worker(act, idx, idx, slot, true))
+				return act;
+		} else {
+			if (spawn_worker(act, idx, idx + 1, slot, false))
+				return act;
+		}
+		consume(act);
+	}
+}
+
+/**
+ * @brief Get the thread to put to sleep when switching threads at a
+ * divergence point
+ *
+ * Sequentially, the previous sibling is always the thread of the diverging
+ * action itself. A worker's first divergence point may instead be a
+ * placeholder left behind by the coordinator, in which case the sibling
+ * handed out just before this worker's is the one to sleep.
+ *
+ * @param diverge The divergence point
+ * @return The thread to add to the sleep set
+ */
+thread_id_t ParallelExplorer::get_sleep_thread(const ModelAction *diverge)
+{
+	thread_id_t tid = self.sleep_tid;
+	self.sleep_tid = THREAD_ID_T_NONE;
+	if (!worker || tid == THREAD_ID_T_NONE)
+		return diverge->get_tid();
+	return tid;
+}
+
+/**
+ * @brief Get the thread which most recently executed at a Node's position
+ * @param act The action recorded at the Node
+ * @param idx The index of the Node
+ * @return The thread of the last sibling handed out from the Node's parent,
+ * or the thread of act if none has been handed out
+ */
+thread_id_t ParallelExplorer::previous_sibling(const ModelAction *act, int idx) const
+{
+	if (idx < (int)last_explored.size() && last_explored[idx] != THREAD_ID_T_NONE)
+		return last_explored[idx];
+	return act->get_tid();
+}
+
+/**
+ * @brief Check whether a divergence point lies within this worker's subtree
+ * @param act The divergence point
+ * @return True if this worker is responsible for exploring act
+ */
+bool ParallelExplorer::owns(ModelAction *act) const
+{
+	Node *node = act->get_node();
+	int idx = node_stack->get_index(node);
+	if (idx < 0)
+		return false;
+	if (!node->behaviors_empty())
+		return idx >= self.behavior_floor;
+	/* Switching threads at act means choosing from its parent's backtrack set */
+	return idx - 1 >= self.thread_floor;
+}
+
+/** @return True if the maximum number of executions has been reached */
+bool ParallelExplorer::budget_exhausted() const
+{
+	return params->maxexecutions != 0 && stats->num_complete >= params->maxexecutions;
+}
+
+/**
+ * @brief Check whether diverging at a Node would invalidate a running worker
+ *
+ * Diverging at idx discards every Node past idx (and, for a new behavior,
+ * the backtracking set of idx itself), so we cannot do so while a worker may
+ * still report back into those Nodes. As in a sequential search, all
+ * behaviors of a Node (including future values still being discovered) must
+ * be exhausted before switching to a different thread at that Node.
+ *
+ * @param idx The index of the Node at which we want to diverge
+ * @param switching True if diverging to a different thread; false if
+ * diverging to a new behavior
+ * @return True if we must wait for some worker first
+ */
+bool ParallelExplorer::conflicts(int idx, bool switching) const
+{
+	int behavior_limit = switching ? idx : idx + 1;
+	for (unsigned int i = 0; i < workers.size(); i++)
+		if (workers[i].thread_floor > idx || workers[i].behavior_floor > behavior_limit)
+			return true;
+	return false;
+}
+
+/**
+ * @brief Claim a free worker slot
+ * @return The slot index, or -1 if all slots are taken
+ */
+int ParallelExplorer::reserve_slot()
+{
+	for (int i = 0; i < shared->num_slots; i++)
+		if (__sync_bool_compare_and_swap(&shared->slots[i].busy, 0, 1))
+			return i;
+	return -1;
+}
+
+/**
+ * @brief Fork a worker to explore the subtree rooted at a divergence point
+ * @param act The divergence point
+ * @param thread_floor The first Node whose thread choices the worker owns
+ * @param behavior_floor The first Node whose behaviors the worker owns
+ * @param slot The worker slot claimed for the new worker
+ * @param sibling_sync True if the next sibling thread choice will be handed
+ * out by this process, and so needs the worker's recorded sleep set
+ * @return True in the child; false in the parent
+ */
+bool ParallelExplorer::spawn_worker(ModelAction *act, int thread_floor, int behavior_floor, int slot, bool sibling_sync)
+{
+	struct parallel_worker w;
+	w.out_fd = make_temp_file();
+	w.report_fd = make_temp_file();
+	w.thread_floor = thread_floor;
+	w.behavior_floor = behavior_floor;
+	w.sleep_tid = THREAD_ID_T_NONE;
+	w.enabled_fd = -1;
+	w.slot = slot;
+
+	/* Only a worker switching threads gets a new sibling's bookkeeping */
+	int pipefd[2] = { -1, -1 };
+	if (thread_floor == behavior_floor)
+		w.sleep_tid = previous_sibling(act, thread_floor);
+	if (sibling_sync) {
+		if (pipe(pipefd) < 0) {
+			perror("pipe");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	/* Don't duplicate any buffered program output */
+	fflush(stdout);
+
+	w.pid = fork();
+	if (w.pid < 0) {
+		perror("fork");
+		exit(EXIT_FAILURE);
+	}
+
+	if (w.pid > 0) {
+		if (pipefd[1] >= 0)
+			close(pipefd[1]);
+		w.enabled_fd = pipefd[0];
+		workers.push_back(w);
+		return false;
+	}
+
+	/* Child */
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		close(workers[i].out_fd);
+		close(workers[i].report_fd);
+		if (workers[i].enabled_fd >= 0)
+			close(workers[i].enabled_fd);
+	}
+	workers.clear();
+	discard_sibling_state(0);
+	last_explored.clear();
+	worker = true;
+	self = w;
+	self.pid = getpid();
+	if (pipefd[0] >= 0)
+		close(pipefd[0]);
+	self.enabled_fd = pipefd[1];
+
+	model_out = w.out_fd;
+	redirect_program_output();
+	snapshot_after_fork();
+
+	start_time = get_time();
+	idle_time = 0;
+	thief_executions = 0;
+	failed_workers = 0;
+	__sync_fetch_and_add(&shared->slots[slot].num_workers, 1);
+
+	baseline_stats = *stats;
+	baseline_backtrack.resize(thread_floor);
+	for (int i = 0; i < thread_floor; i++) {
+		Node *node = node_stack->get_node(i);
+		for (int t = 0; t < node->get_num_threads(); t++)
+			baseline_backtrack[i].push_back(node->has_backtrack(int_to_id(t)));
+	}
+	return true;
+}
+
+/**
+ * @brief Skip over a divergence point which has been handed to a worker
+ *
+ * Mirrors the bookkeeping done by ModelChecker::get_next_thread() when it
+ * reaches a divergence point, without actually running the execution.
+ *
+ * @param act The divergence point
+ */
+void ParallelExplorer::consume(ModelAction *act)
+{
+	Node *node = act->get_node();
+	int idx = node_stack->get_index(node);
+
+	last_explored.resize(idx + 1, THREAD_ID_T_NONE);
+	discard_sibling_state(idx + 1);
+	if (node->increment_behaviors()) {
+		/* The worker owns everything below this behavior */
+		node_stack->pop_after(idx);
+		node->clear_backtracking();
+		last_explored[idx] = THREAD_ID_T_NONE;
+	} else {
+		/*
+		 * The worker owns the subtree under the new thread choice; keep
+		 * this Node as a placeholder so the parent's remaining choices
+		 * (and any late future values) can still be replayed.
+		 */
+		Node *parent = node->get_parent();
+		thread_id_t tid = parent->get_next_backtrack();
+		parent->explore(tid);
+		node_stack->pop_after(idx);
+		last_explored[idx] = tid;
+	}
+}
+
+/**
+ * @brief Donate the shallowest open thread choice of this worker's subtree
+ *
+ * Called by a busy worker between executions. If a worker slot is free, the
+ * shallowest Node (above the upcoming divergence point) whose parent still
+ * has unexplored thread choices is handed to a newly-forked thief, which
+ * reports back to this worker. Unlike the coordinator, we cannot discard the
+ * Nodes below the donated choice (we are still exploring them), so only the
+ * thread choice itself is marked as explored.
+ *
+ * @param idx The index of this worker's upcoming divergence point
+ * @return In the thief, the divergence point to explore; otherwise NULL
+ */
+ModelAction * ParallelExplorer::donate(int idx)
+{
+	int slot = reserve_slot();
+	if (slot < 0)
+		return NULL;
+
+	for (int i = self.thread_floor + 1; i < idx; i++) {
+		Node *node = node_stack->get_node(i);
+		Node *parent = node->get_parent();
+		/* The thief would replay the Node's remaining behaviors first */
+		if (parent->backtrack_empty() || !node->behaviors_empty())
+			continue;
+
+		/* An earlier thief at this Node left the sleep state */
+		receive_sibling_state(i);
+		ModelAction *act = node->get_action();
+		if (spawn_worker(act, i, i, slot, true))
+			return act;
+		thread_id_t tid = parent->get_next_backtrack();
+		parent->explore(tid);
+		last_explored.resize(std::max((int)last_explored.size(), i + 1), THREAD_ID_T_NONE);
+		last_explored[i] = tid;
+		return NULL;
+	}
+
+	__sync_lock_release(&shared->slots[slot].busy);
+	return NULL;
+}
+
+/**
+ * @brief Collect the enabled/sleep state left by the workers exploring the
+ * previous sibling thread choices at a Node, which carries over to the next
+ * @param idx The index of the Node
+ */
+void ParallelExplorer::receive_sibling_state(int idx)
+{
+	for (unsigned int i = 0; i < workers.size(); i++)
+		if (workers[i].thread_floor == idx && workers[i].behavior_floor == idx)
+			receive_enabled(&workers[i]);
+	for (unsigned int i = 0; i < exited_siblings.size();) {
+		if (exited_siblings[i].thread_floor == idx) {
+			receive_enabled(&exited_siblings[i]);
+			exited_siblings.erase(exited_siblings.begin() + i);
+		} else {
+			i++;
+		}
+	}
+}
+
+/**
+ * @brief Drop the sibling state of exited workers whose Nodes are about to be
+ * replaced
+ * @param idx The index of the first Node being replaced
+ */
+void ParallelExplorer::discard_sibling_state(int idx)
+{
+	for (unsigned int i = 0; i < exited_siblings.size();) {
+		if (exited_siblings[i].thread_floor >= idx) {
+			close(exited_siblings[i].enabled_fd);
+			exited_siblings.erase(exited_siblings.begin() + i);
+		} else {
+			i++;
+		}
+	}
+}
+
+/**
+ * @brief Send the enabled/sleep state this worker recorded for the parent of
+ * its divergence point back to the coordinator
+ *
+ * A sequential search overwrites the parent's enabled array when recording
+ * the new thread choice, and the next sibling's sleep set is derived from it.
+ * This is final after the worker's first execution.
+ */
+void ParallelExplorer::send_enabled()
+{
+	Node *parent = node_stack->get_node(self.thread_floor - 1);
+	write_all(self.enabled_fd, parent->get_enabled_array(),
+			sizeof(enabled_type_t) * parent->get_num_threads());
+	close(self.enabled_fd);
+	self.enabled_fd = -1;
+}
+
+/**
+ * @brief Receive the enabled/sleep state from a thread-switching worker,
+ * blocking until its first execution has finished
+ * @param w The worker
+ */
+void ParallelExplorer::receive_enabled(struct parallel_worker *w)
+{
+	if (w->enabled_fd < 0)
+		return;
+
+	Node *parent = node_stack->get_node(w->thread_floor - 1);
+	size_t len = sizeof(enabled_type_t) * parent->get_num_threads();
+	enabled_type_t *enabled = (enabled_type_t *)model_malloc(len);
+	char *p = (char *)enabled;
+	size_t remaining = len;
+	while (remaining > 0) {
+		ssize_t ret = read(w->enabled_fd, p, remaining);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		p += ret;
+		remaining -= ret;
+	}
+	/* Keep the old state if the worker died before sending it */
+	if (remaining == 0)
+		memcpy(parent->get_enabled_array(), enabled, len);
+	model_free(enabled);
+
+	close(w->enabled_fd);
+	w->enabled_fd = -1;
+}
+
+/** @brief Block until some worker exits, then merge its results */
+void ParallelExplorer::wait_for_worker()
+{
+	int status;
+	uint64_t start = get_time();
+	pid_t pid = waitpid(-1, &status, 0);
+	idle_time += get_time() - start;
+	if (pid < 0) {
+		if (errno == EINTR)
+			return;
+		perror("waitpid");
+		exit(EXIT_FAILURE);
+	}
+	collect_worker(pid, status);
+}
+
+/** @brief Merge the results of any workers which have already exited */
+void ParallelExplorer::reap_workers()
+{
+	int status;
+	pid_t pid;
+	while (!workers.empty() && (pid = waitpid(-1, &status, WNOHANG)) > 0)
+		collect_worker(pid, status);
+}
+
+/**
+ * @brief Merge the results of an exited worker and release its slot
+ * @param pid The worker's process ID
+ * @param status The exit status, as returned by waitpid()
+ */
+void ParallelExplorer::collect_worker(pid_t pid, int status)
+{
+	for (unsigned int i = 0; i < workers.size(); i++) {
+		if (workers[i].pid == pid) {
+			struct parallel_worker w = workers[i];
+			workers.erase(workers.begin() + i);
+			/*
+			 * The sibling state only applies once we switch threads at
+			 * the worker's divergence point; the pipe outlives the worker.
+			 */
+			if (w.enabled_fd >= 0)
+				exited_siblings.push_back(w);
+			merge_worker(&w, status);
+			__sync_lock_release(&shared->slots[w.slot].busy);
+			return;
+		}
+	}
+}
+
+/**
+ * @brief Merge the output, stats, and discovered backtracking points of an
+ * exited worker
+ * @param w The worker
+ * @param status The exit status, as returned by waitpid()
+ */
+void ParallelExplorer::merge_worker(const struct parallel_worker *w, int status)
+{
+	char buf[4096];
+	off_t offset = 0;
+	ssize_t ret;
+
+	/* Pass along the worker's output */
+	while ((ret = pread(w->out_fd, buf, sizeof(buf), offset)) > 0) {
+		write_all(model_out, buf, ret);
+		offset += ret;
+	}
+	close(w->out_fd);
+
+	struct worker_report_header header;
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS ||
+			!read_all(w->report_fd, &header, sizeof(header), 0)) {
+		model_print("Warning: exploration worker %d terminated abnormally; "
+				"its subtree is left unexplored\n", w->pid);
+		close(w->report_fd);
+		failed_workers++;
+		return;
+	}
+
+	stats->num_total += header.stats.num_total;
+	stats->num_infeasible += header.stats.num_infeasible;
+	stats->num_buggy_executions += header.stats.num_buggy_executions;
+	stats->num_complete += header.stats.num_complete;
+	stats->num_redundant += header.stats.num_redundant;
+	stats->num_pruned += header.stats.num_pruned;
+	thief_executions += header.stats.num_total;
+	failed_workers += header.num_failed_workers;
+
+	offset = sizeof(header);
+	for (int i = 0; i < header.num_backtracks; i++) {
+		struct backtrack_record rec;
+		if (!read_all(w->report_fd, &rec, sizeof(rec), offset))
+			break;
+		offset += sizeof(rec);
+
+		Node *node = node_stack->get_node(rec.node);
+		ASSERT(node);
+		if (!node->has_been_explored(rec.tid))
+			node->set_backtrack(rec.tid);
+	}
+	for (int i = 0; i < header.num_future_values; i++) {
+		struct future_value_record rec;
+		if (!read_all(w->report_fd, &rec, sizeof(rec), offset))
+			break;
+		offset += sizeof(rec);
+
+		Node *node = node_stack->get_node(rec.node);
+		ASSERT(node);
+		node->add_future_value(rec.fv);
+	}
+	close(w->report_fd);
+}
+
+/**
+ * @brief Write this worker's report and exit
+ *
+ * Reports the stats for the executions this worker ran, plus any thread
+ * choices and future values it discovered for Nodes outside of its subtree.
+ */
+void ParallelExplorer::finish_worker()
+{
+	ModelVector<struct backtrack_record> backtracks;
+	ModelVector<struct future_value_record> future_values;
+	struct worker_report_header header;
+
+	header.stats.num_total = stats->num_total - baseline_stats.num_total;
+	header.stats.num_infeasible = stats->num_infeasible - baseline_stats.num_infeasible;
+	header.stats.num_buggy_executions = stats->num_buggy_executions - baseline_stats.num_buggy_executions;
+	header.stats.num_complete = stats->num_complete - baseline_stats.num_complete;
+	header.stats.num_redundant = stats->num_redundant - baseline_stats.num_redundant;
+	header.stats.num_pruned = stats->num_pruned - baseline_stats.num_pruned;
+
+	for (int i = 0; i < self.thread_floor; i++) {
+		Node *node = node_stack->get_node(i);
+		const ModelVector<bool> &baseline = baseline_backtrack[i];
+		for (int t = 0; t < node->get_num_threads(); t++) {
+			if (node->has_backtrack(int_to_id(t)) &&
+					!(t < (int)baseline.size() && baseline[t])) {
+				struct backtrack_record rec = { i, int_to_id(t) };
+				backtracks.push_back(rec);
+			}
+		}
+	}
+
+	for (int i = 0; i < self.behavior_floor; i++) {
+		Node *node = node_stack->get_node(i);
+		for (int j = 0; j < node->get_future_value_size(); j++) {
+			struct future_value_record rec;
+			rec.node = i;
+			rec.fv = node->get_future_value(j);
+			future_values.push_back(rec);
+		}
+	}
+
+	header.num_backtracks = backtracks.size();
+	header.num_future_values = future_values.size();
+	header.num_failed_workers = failed_workers;
+
+	write_all(self.report_fd, &header, sizeof(header));
+	for (unsigned int i = 0; i < backtracks.size(); i++)
+		write_all(self.report_fd, &backtracks[i], sizeof(backtracks[i]));
+	for (unsigned int i = 0; i < future_values.size(); i++)
+		write_all(self.report_fd, &future_values[i], sizeof(future_values[i]));
+
+	struct parallel_slot *slot = &shared->slots[self.slot];
+	__sync_fetch_and_add(&slot->executions, header.stats.num_total - thief_executions);
+	__sync_fetch_and_add(&slot->busy_time, get_time() - start_time - idle_time);
+
+	fflush(stdout);
+	_exit(EXIT_SUCCESS);
+}
+
+/** @brief Print the utilization of each worker slot */
+void ParallelExplorer::print_stats() const
+{
+	if (worker)
+		return;
+
+	uint64_t elapsed = get_time() - shared->start_time;
+	for (int i = 0; i < shared->num_slots; i++) {
+		const struct parallel_slot *slot = &shared->slots[i];
+		model_print("Worker slot %d: %d workers, %" PRIu64 " executions, %.1f%% busy\n",
+				i, slot->num_workers, slot->executions,
+				elapsed ? 100.0 * slot->busy_time / elapsed : 0.0);
+	}
+	if (failed_workers)
+		model_print("%d exploration worker%s terminated abnormally; "
+				"the exploration is incomplete\n",
+				failed_workers, failed_workers > 1 ? "s" : "");
+}
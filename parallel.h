@@ -0,0 +1,133 @@
+/** @file parallel.h
+ *  @brief Parallel exploration of the execution tree with forked workers.
+ */
+
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <sys/types.h>
+#include <inttypes.h>
+
+#include "mymemory.h"
+#include "stl-model.h"
+#include "modeltypes.h"
+#include "model.h"
+
+/**
+ * @brief A forked worker process which explores one subtree of the NodeStack
+ *
+ * A worker owns the thread choices (backtracking sets) of every Node at or
+ * beyond thread_floor and the behaviors (reads-from, promises, future values,
+ * etc.) of every Node at or beyond behavior_floor. Anything it discovers for
+ * shallower Nodes is written to its report and merged by the coordinator.
+ */
+struct parallel_worker {
+	pid_t pid;
+	/** @brief Temporary file holding the worker's model-checker output */
+	int out_fd;
+	/** @brief Temporary file holding the worker's final report */
+	int report_fd;
+	int thread_floor;
+	int behavior_floor;
+	/** @brief The sibling thread explored just before this subtree, which
+	 *  belongs in the sleep set at the divergence point */
+	thread_id_t sleep_tid;
+	/**
+	 * @brief Pipe carrying the enabled/sleep state the worker recorded in
+	 * the parent of its divergence point, which the next sibling needs
+	 * (-1 if not applicable or already received)
+	 */
+	int enabled_fd;
+	/** @brief The worker slot (see struct parallel_shared) held by the worker */
+	int slot;
+};
+
+struct parallel_shared;
+
+/**
+ * @brief Distributes the exploration of the NodeStack across processes
+ *
+ * The coordinating process runs the first execution to populate the
+ * NodeStack, then stops executing; each remaining divergence point is handed
+ * to a forked worker, which replays the prefix up to the divergence and
+ * explores the subtree below it. Workers report their execution stats,
+ * buffered output, and any backtracking points found above their subtree back
+ * to the coordinator, which merges them into its own NodeStack and continues
+ * distributing work until the tree is exhausted.
+ *
+ * DPOR subtrees are very unbalanced, so a fixed split leaves most workers
+ * idle. Whenever a worker slot is free, a busy worker donates the shallowest
+ * open thread choice of its own subtree to a new worker (a "thief") which it
+ * forks and supervises itself, exactly as the coordinator does.
+ */
+class ParallelExplorer {
+public:
+	ParallelExplorer(const struct model_params *params, NodeStack *node_stack, struct execution_stats *stats);
+	~ParallelExplorer();
+
+	ModelAction * next_divergence(ModelAction *diverge);
+	thread_id_t get_sleep_thread(const ModelAction *diverge);
+	bool is_worker() const { return worker; }
+	bool is_complete() const { return failed_workers == 0; }
+	void print_stats() const;
+
+	MEMALLOC
+private:
+	const struct model_params * const params;
+	NodeStack * const node_stack;
+	struct execution_stats * const stats;
+
+	/** @brief Slot bookkeeping shared by every process in the exploration */
+	struct parallel_shared * const shared;
+
+	/** @brief Workers which are still running */
+	ModelVector<struct parallel_worker> workers;
+	/** @brief Exited workers whose sibling state has not been collected */
+	ModelVector<struct parallel_worker> exited_siblings;
+
+	/**
+	 * @brief The thread choice most recently handed out from the parent of
+	 * each placeholder Node (or donated from each Node, in a worker)
+	 */
+	ModelVector<thread_id_t> last_explored;
+
+	/** @brief True if this process is a forked worker */
+	bool worker;
+	/** @brief This worker's ownership bounds (worker only) */
+	struct parallel_worker self;
+	/** @brief Stats at the time of the fork (worker only) */
+	struct execution_stats baseline_stats;
+	/** @brief Backtracking sets above the subtree at fork time (worker only) */
+	ModelVector< ModelVector<bool> > baseline_backtrack;
+	/** @brief When this worker started (worker only) */
+	uint64_t start_time;
+	/** @brief Time spent blocked on this worker's own thieves (worker only) */
+	uint64_t idle_time;
+	/** @brief Executions reported by this worker's thieves (worker only) */
+	int thief_executions;
+	/**
+	 * @brief Workers below this process which terminated abnormally, whose
+	 * subtrees were left unexplored
+	 */
+	int failed_workers;
+
+	thread_id_t previous_sibling(const ModelAction *act, int idx) const;
+	bool owns(ModelAction *act) const;
+	bool budget_exhausted() const;
+	bool conflicts(int idx, bool switching) const;
+	int reserve_slot();
+	bool spawn_worker(ModelAction *act, int thread_floor, int behavior_floor, int slot, bool sibling_sync);
+	void consume(ModelAction *act);
+	ModelAction * donate(int idx);
+	void send_enabled();
+	void receive_enabled(struct parallel_worker *w);
+	void receive_sibling_state(int idx);
+	void discard_sibling_state(int idx);
+	void wait_for_worker();
+	void reap_workers();
+	void collect_worker(pid_t pid, int status);
+	void merge_worker(const struct parallel_worker *w, int status);
+	void finish_worker() __attribute__((noreturn));
+};
+
+#endif /* __PARALLEL_H__ */
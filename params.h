@@ -25,6 +25,31 @@ struct model_params {
 	 *  value */
 	unsigned int expireslop;
 
+	/** @brief Maximum number of worker processes exploring executions in
+	 *  parallel (1 = explore sequentially) */
+	int numworkers;
+
+	/** @brief Cut executions which reach an already-explored state */
+	bool prunestates;
+
+	/** @brief File to write a binary trace of every execution to, or
+	 *  NULL (see TraceWriter) */
+	const char *tracefile;
+
+	/** @brief Keep NodeStack memory in a spill file, with at most this many
+	 *  MiB of it resident (0 = keep it all in memory) */
+	unsigned int spilllimit;
+
+	/** @brief File to checkpoint the exploration to, or NULL (see
+	 *  ModelChecker::write_checkpoint()) */
+	const char *checkpointfile;
+
+	/** @brief Seconds between checkpoints (0 = after every execution) */
+	unsigned int checkpointinterval;
+
+	/** @brief Continue from the checkpoint in checkpointfile */
+	bool resume;
+
 	/** @brief Verbosity (0 = quiet; 1 = noisy; 2 = noisier) */
 	int verbose;
 
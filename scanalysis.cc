@@ -3,6 +3,7 @@
 #include "threads-model.h"
 #include "clockvector.h"
 #include "execution.h"
+#include "checkpoint.h"
 #include <sys/time.h>
 
 
@@ -44,6 +45,21 @@ void SCAnalysis::finish() {
 	model_print("Actions per execution: %llu\n", actionperexec);
 }
 
+bool SCAnalysis::checkpoint(CheckpointWriter *writer) {
+	writer->put(stats->elapsedtime);
+	writer->put(stats->sccount);
+	writer->put(stats->nonsccount);
+	writer->put(stats->actions);
+	return true;
+}
+
+void SCAnalysis::resume(CheckpointReader *reader) {
+	stats->elapsedtime=reader->get();
+	stats->sccount=reader->get();
+	stats->nonsccount=reader->get();
+	stats->actions=reader->get();
+}
+
 bool SCAnalysis::option(char * opt) {
 	if (strcmp(opt, "verbose")==0) {
 		print_always=true;
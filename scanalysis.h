@@ -1,7 +1,7 @@
 #ifndef SCANALYSIS_H
 #define SCANALYSIS_H
 #include "traceanalysis.h"
-#include "hashtable.h"
+#include "swisstable.h"
 
 struct sc_statistics {
 	unsigned long long elapsedtime;
@@ -19,7 +19,8 @@ class SCAnalysis : public TraceAnalysis {
 	virtual const char * name();
 	virtual bool option(char *);
 	virtual void finish();
-
+	virtual bool checkpoint(CheckpointWriter *writer);
+	virtual void resume(CheckpointReader *reader);
 
 	SNAPSHOTALLOC
  private:
@@ -37,10 +38,10 @@ class SCAnalysis : public TraceAnalysis {
 	ModelAction* pruneArray(ModelAction**, int);
 
 	int maxthreads;
-	HashTable<const ModelAction *, ClockVector *, uintptr_t, 4 > cvmap;
+	SwissTable<const ModelAction *, ClockVector *, uintptr_t, 4 > cvmap;
 	bool cyclic;
-	HashTable<const ModelAction *, const ModelAction *, uintptr_t, 4 > badrfset;
-	HashTable<void *, const ModelAction *, uintptr_t, 4 > lastwrmap;
+	SwissTable<const ModelAction *, const ModelAction *, uintptr_t, 4 > badrfset;
+	SwissTable<void *, const ModelAction *, uintptr_t, 4 > lastwrmap;
 	SnapVector<action_list_t> threadlists;
 	ModelExecution *execution;
 	bool print_always;
@@ -258,6 +258,15 @@ void Scheduler::set_scheduler_thread(thread_id_t tid) {
 	curr_thread_index=id_to_int(tid);
 }
 
+/**
+ * @return The thread from which select_next_thread() starts its round-robin
+ * search
+ */
+thread_id_t Scheduler::get_scheduler_thread() const
+{
+	return int_to_id(curr_thread_index);
+}
+
 /**
  * @brief Set the current "running" Thread
  * @param t Thread to run
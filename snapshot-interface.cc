@@ -15,9 +15,11 @@
 #define MAPFILE "/proc/self/maps"
 
 struct snapshot_entry {
-	snapshot_entry(snapshot_id id, int idx) : snapshotid(id), index(idx) { }
+	snapshot_entry(snapshot_id id, int idx, void *mark) : snapshotid(id), index(idx), arenamark(mark) { }
 	snapshot_id snapshotid;
 	int index;
+	/** @brief The per-execution arena's position at the snapshot */
+	void *arenamark;
 	MEMALLOC
 };
 
@@ -78,7 +80,7 @@ static void SnapshotGlobalSegments()
 		if (w == 'w' && strstr(regionname, MYBINARYNAME)) {
 			size_t len = ((uintptr_t)end - (uintptr_t)begin) / PAGESIZE;
 			if (len != 0)
-				snapshot_add_memory_region(begin, len);
+				snapshot_add_memory_region(begin, len, false);
 		}
 	}
 	pclose(map);
@@ -124,7 +126,7 @@ static void SnapshotGlobalSegments()
 		if (w == 'w' && strstr(regionname, binary_name)) {
 			size_t len = ((uintptr_t)end - (uintptr_t)begin) / PAGESIZE;
 			if (len != 0)
-				snapshot_add_memory_region(begin, len);
+				snapshot_add_memory_region(begin, len, false);
 			DEBUG("%55s: %18p - %18p\t%c%c%c%c\n", regionname, begin, end, r, w, x, p);
 		}
 	}
@@ -148,6 +150,7 @@ int SnapshotStack::backTrackBeforeStep(int seqindex)
 			stack.pop_back();
 
 	ASSERT(i >= 0);
+	arena_rollback(stack[i].arenamark);
 	snapshot_roll_back(stack[i].snapshotid);
 	return stack[i].index;
 }
@@ -155,7 +158,8 @@ int SnapshotStack::backTrackBeforeStep(int seqindex)
 /** This method takes a snapshot at the given sequence number. */
 void SnapshotStack::snapshotStep(int seqindex)
 {
-	stack.push_back(snapshot_entry(take_snapshot(), seqindex));
+	void *mark = arena_mark();
+	stack.push_back(snapshot_entry(take_snapshot(), seqindex, mark));
 }
 
 void snapshot_stack_init()
@@ -16,5 +16,7 @@ void snapshot_system_init(unsigned int numbackingpages,
 void snapshot_stack_init();
 void snapshot_record(int seq_index);
 int snapshot_backtrack_before(int seq_index);
+void snapshot_after_fork();
+void snapshot_print_stats();
 
 #endif
@@ -5,7 +5,19 @@
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 #include <sys/wait.h>
+#include "config.h"
+#if USE_MPROTECT_SNAPSHOT == 3
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/userfaultfd.h>
+#include <linux/fs.h>
+#elif USE_MPROTECT_SNAPSHOT == 4
+#include <sys/syscall.h>
+#include <linux/memfd.h>
+#endif
 
 #include "hashtable.h"
 #include "snapshot.h"
@@ -23,6 +35,52 @@ static void * PageAlignAddressUpward(void *addr)
 
 #if USE_MPROTECT_SNAPSHOT
 
+/** @return The current monotonic time, in nanoseconds */
+static uint64_t snapshot_time()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+#if USE_MPROTECT_SNAPSHOT == 3
+/* Asynchronous userfaultfd write-protection and PAGEMAP_SCAN (Linux 6.7),
+ * for building against older kernel headers */
+#ifndef UFFD_USER_MODE_ONLY
+#define UFFD_USER_MODE_ONLY 1
+#endif
+#ifndef UFFD_FEATURE_WP_ASYNC
+#define UFFD_FEATURE_WP_UNPOPULATED (1 << 13)
+#define UFFD_FEATURE_WP_ASYNC (1 << 15)
+#endif
+#ifndef PAGEMAP_SCAN
+struct page_region {
+	uint64_t start;
+	uint64_t end;
+	uint64_t categories;
+};
+
+struct pm_scan_arg {
+	uint64_t size;
+	uint64_t flags;
+	uint64_t start;
+	uint64_t end;
+	uint64_t walk_end;
+	uint64_t vec;
+	uint64_t vec_len;
+	uint64_t max_pages;
+	uint64_t category_inverted;
+	uint64_t category_mask;
+	uint64_t category_anyof_mask;
+	uint64_t return_mask;
+};
+
+#define PAGEMAP_SCAN _IOWR('f', 16, struct pm_scan_arg)
+#define PAGE_IS_WRITTEN (1 << 1)
+#define PAGE_IS_PRESENT (1 << 3)
+#endif
+#endif /* USE_MPROTECT_SNAPSHOT == 3 */
+
 /* Each SnapShotRecord lists the firstbackingpage that must be written to
  * revert to that snapshot */
 struct SnapShotRecord {
@@ -42,6 +100,9 @@ struct BackingPageRecord {
 struct MemoryRegion {
 	void *basePtr; // base of memory region
 	int sizeInPages; // size of memory region in pages
+#if USE_MPROTECT_SNAPSHOT == 4
+	bool anonymous; // region is private anonymous memory (unpopulated pages are zero)
+#endif
 };
 
 /** ReturnPageAlignedAddress returns a page aligned address for the
@@ -71,6 +132,20 @@ struct mprot_snapshotter {
 	unsigned int maxBackingPages; //Stores the total number of backing pages
 	unsigned int maxSnapShots; //Stores the total number of snapshots we allow
 
+#if USE_MPROTECT_SNAPSHOT == 3
+	int uffd; //The userfaultfd tracking writes to the snapshotted regions, or -1
+	int pagemapfd; //Our /proc/self/pagemap, for collecting the written pages
+	bool fullRestore; //Written pages are unknown; restore every page on the next rollback
+	HashTable<void *, unsigned int, uintptr_t, 4, model_malloc, model_calloc, model_free> savedPages; //Maps a page to its backing page (plus one)
+#endif
+
+	/* Statistics */
+	unsigned int numFaults; //Write faults taken by our signal handler
+	unsigned int numRollbacks; //Rollbacks performed
+	uint64_t numRestoredPages; //Pages copied back from the backing store
+	uint64_t numZappedPages; //Pages dropped to re-expose their original contents
+	uint64_t rollbackTime; //Time spent in rollbacks (ns)
+
 	MEMALLOC
 };
 
@@ -82,7 +157,18 @@ mprot_snapshotter::mprot_snapshotter(unsigned int backing_pages, unsigned int sn
 	lastRegion(0),
 	maxRegions(regions),
 	maxBackingPages(backing_pages),
-	maxSnapShots(snapshots)
+	maxSnapShots(snapshots),
+#if USE_MPROTECT_SNAPSHOT == 3
+	uffd(-1),
+	pagemapfd(-1),
+	fullRestore(false),
+	savedPages(),
+#endif
+	numFaults(0),
+	numRollbacks(0),
+	numRestoredPages(0),
+	numZappedPages(0),
+	rollbackTime(0)
 {
 	regionsToSnapShot = (struct MemoryRegion *)model_malloc(sizeof(struct MemoryRegion) * regions);
 	backingStoreBasePtr = (void *)model_malloc(sizeof(snapshot_page_t) * (backing_pages + 1));
@@ -105,7 +191,12 @@ mprot_snapshotter::~mprot_snapshotter()
  */
 static void mprot_handle_pf(int sig, siginfo_t *si, void *unused)
 {
-	if (si->si_code == SEGV_MAPERR) {
+	if (stack_pool_is_guard(si->si_addr)) {
+		model_print("Stack overflow in a user thread at %p\n", si->si_addr);
+		exit(EXIT_FAILURE);
+	}
+	/* Only the mprotect()-based backends expect write faults */
+	if (si->si_code == SEGV_MAPERR || USE_MPROTECT_SNAPSHOT >= 3) {
 		model_print("Segmentation fault at %p\n", si->si_addr);
 		model_print("For debugging, place breakpoint at: %s:%d\n",
 				__FILE__, __LINE__);
@@ -114,6 +205,7 @@ static void mprot_handle_pf(int sig, siginfo_t *si, void *unused)
 	}
 	void* addr = ReturnPageAlignedAddress(si->si_addr);
 
+	mprot_snap->numFaults++;
 	unsigned int backingpage = mprot_snap->lastBackingPage++; //Could run out of pages...
 	if (backingpage == mprot_snap->maxBackingPages) {
 		model_print("Out of backing pages at %p\n", si->si_addr);
@@ -159,6 +251,7 @@ static void mprot_snapshot_init(unsigned int numbackingpages,
 
 	mprot_snap = new mprot_snapshotter(numbackingpages, numsnapshots, nummemoryregions);
 
+#if USE_MPROTECT_SNAPSHOT < 3
 	// EVIL HACK: We need to make sure that calls into the mprot_handle_pf method don't cause dynamic links
 	// The problem is that we end up protecting state in the dynamic linker...
 	// Solution is to call our signal handler before we start protecting stuff...
@@ -168,21 +261,23 @@ static void mprot_snapshot_init(unsigned int numbackingpages,
 	si.si_addr = ss.ss_sp;
 	mprot_handle_pf(SIGSEGV, &si, NULL);
 	mprot_snap->lastBackingPage--; //remove the fake page we copied
+	mprot_snap->numFaults--;
+#endif
 
 	void *basemySpace = model_malloc((numheappages + 1) * PAGESIZE);
 	void *pagealignedbase = PageAlignAddressUpward(basemySpace);
 	user_snapshot_space = create_mspace_with_base(pagealignedbase, numheappages * PAGESIZE, 1);
-	snapshot_add_memory_region(pagealignedbase, numheappages);
+	snapshot_add_memory_region(pagealignedbase, numheappages, true);
 
 	void *base_model_snapshot_space = model_malloc((numheappages + 1) * PAGESIZE);
 	pagealignedbase = PageAlignAddressUpward(base_model_snapshot_space);
 	model_snapshot_space = create_mspace_with_base(pagealignedbase, numheappages * PAGESIZE, 1);
-	snapshot_add_memory_region(pagealignedbase, numheappages);
+	snapshot_add_memory_region(pagealignedbase, numheappages, true);
 
 	entryPoint();
 }
 
-static void mprot_add_to_snapshot(void *addr, unsigned int numPages)
+static void mprot_add_to_snapshot(void *addr, unsigned int numPages, bool anonymous)
 {
 	unsigned int memoryregion = mprot_snap->lastRegion++;
 	if (memoryregion == mprot_snap->maxRegions) {
@@ -195,8 +290,324 @@ static void mprot_add_to_snapshot(void *addr, unsigned int numPages)
 			numPages > 1 ? "s" : "");
 	mprot_snap->regionsToSnapShot[memoryregion].basePtr = addr;
 	mprot_snap->regionsToSnapShot[memoryregion].sizeInPages = numPages;
+#if USE_MPROTECT_SNAPSHOT == 4
+	mprot_snap->regionsToSnapShot[memoryregion].anonymous = anonymous;
+#endif
+}
+
+#if USE_MPROTECT_SNAPSHOT == 3
+
+/**
+ * @brief Start tracking writes to every snapshotted region
+ *
+ * Each region is registered for asynchronous userfaultfd write-protection:
+ * the kernel resolves write faults on protected pages by itself (no signal
+ * is delivered), recording them as written for PAGEMAP_SCAN.
+ */
+static void dirty_tracking_init()
+{
+	if (mprot_snap->uffd >= 0)
+		close(mprot_snap->uffd);
+	if (mprot_snap->pagemapfd >= 0)
+		close(mprot_snap->pagemapfd);
+
+	mprot_snap->uffd = syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY);
+	if (mprot_snap->uffd < 0) {
+		perror("userfaultfd");
+		model_print("Dirty-page tracking requires userfaultfd; rebuild with USE_MPROTECT_SNAPSHOT=2\n");
+		exit(EXIT_FAILURE);
+	}
+
+	struct uffdio_api api;
+	memset(&api, 0, sizeof(api));
+	api.api = UFFD_API;
+	api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+	if (ioctl(mprot_snap->uffd, UFFDIO_API, &api) < 0) {
+		perror("UFFDIO_API");
+		model_print("Dirty-page tracking requires Linux 6.7 or later; rebuild with USE_MPROTECT_SNAPSHOT=2\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++) {
+		struct uffdio_register reg;
+		memset(&reg, 0, sizeof(reg));
+		reg.range.start = (uintptr_t)mprot_snap->regionsToSnapShot[region].basePtr;
+		reg.range.len = mprot_snap->regionsToSnapShot[region].sizeInPages * sizeof(snapshot_page_t);
+		reg.mode = UFFDIO_REGISTER_MODE_WP;
+		if (ioctl(mprot_snap->uffd, UFFDIO_REGISTER, &reg) < 0) {
+			perror("UFFDIO_REGISTER");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	mprot_snap->pagemapfd = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+	if (mprot_snap->pagemapfd < 0) {
+		perror("open(/proc/self/pagemap)");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/** @brief Write-protect a range, so that the next write to each page in it
+ *  is recorded */
+static void dirty_tracking_protect(void *addr, size_t len)
+{
+	struct uffdio_writeprotect wp;
+	wp.range.start = (uintptr_t)addr;
+	wp.range.len = len;
+	wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+	if (ioctl(mprot_snap->uffd, UFFDIO_WRITEPROTECT, &wp) < 0) {
+		perror("UFFDIO_WRITEPROTECT");
+		exit(EXIT_FAILURE);
+	}
 }
 
+/**
+ * @brief Find the pages of a region in a given state
+ * @param region The region to scan
+ * @param category The PAGE_IS_* state to look for
+ * @param func Called for each maximal run of matching pages
+ */
+static void dirty_tracking_scan(const struct MemoryRegion *region, uint64_t category,
+		void (*func)(void *start, void *end))
+{
+	struct page_region vec[64];
+	struct pm_scan_arg arg;
+	memset(&arg, 0, sizeof(arg));
+	arg.size = sizeof(arg);
+	arg.start = (uintptr_t)region->basePtr;
+	arg.end = arg.start + region->sizeInPages * sizeof(snapshot_page_t);
+	arg.vec = (uintptr_t)vec;
+	arg.vec_len = sizeof(vec) / sizeof(vec[0]);
+	arg.category_mask = category;
+	arg.return_mask = category;
+
+	while (arg.start < arg.end) {
+		int num = ioctl(mprot_snap->pagemapfd, PAGEMAP_SCAN, &arg);
+		if (num < 0) {
+			perror("PAGEMAP_SCAN");
+			exit(EXIT_FAILURE);
+		}
+		for (int i = 0; i < num; i++)
+			func((void *)vec[i].start, (void *)vec[i].end);
+		arg.start = arg.walk_end;
+	}
+}
+
+/** @brief Save the contents of a run of pages in the backing store */
+static void dirty_tracking_save(void *start, void *end)
+{
+	for (char *addr = (char *)start; addr < (char *)end; addr += PAGESIZE) {
+		unsigned int backingpage = mprot_snap->lastBackingPage++;
+		if (backingpage == mprot_snap->maxBackingPages) {
+			model_print("Out of backing pages at %p\n", addr);
+			exit(EXIT_FAILURE);
+		}
+		memcpy(&mprot_snap->backingStore[backingpage], addr, sizeof(snapshot_page_t));
+		mprot_snap->backingRecords[backingpage].basePtrOfPage = addr;
+		mprot_snap->savedPages.put(addr, backingpage + 1);
+	}
+}
+
+/**
+ * @brief Restore a run of pages to their contents at the last snapshot
+ *
+ * Pages which were not populated at the snapshot are dropped instead, which
+ * re-exposes their original (zero or file-backed) contents.
+ */
+static void dirty_tracking_restore(void *start, void *end)
+{
+	char *zap = NULL;
+	for (char *addr = (char *)start; addr <= (char *)end; addr += PAGESIZE) {
+		unsigned int backingpage = addr < (char *)end ? mprot_snap->savedPages.get(addr) : 0;
+		if (backingpage) {
+			memcpy(addr, &mprot_snap->backingStore[backingpage - 1], sizeof(snapshot_page_t));
+			mprot_snap->numRestoredPages++;
+		}
+		/* Batch runs of unsaved pages into one madvise() */
+		if (zap && (backingpage || addr == (char *)end)) {
+			if (madvise(zap, addr - zap, MADV_DONTNEED) < 0) {
+				perror("madvise");
+				exit(EXIT_FAILURE);
+			}
+			mprot_snap->numZappedPages += (addr - zap) / PAGESIZE;
+			zap = NULL;
+		} else if (!zap && !backingpage && addr < (char *)end) {
+			zap = addr;
+		}
+	}
+	dirty_tracking_protect(start, (char *)end - (char *)start);
+}
+
+/**
+ * @brief Take a snapshot, by saving every populated page of the snapshotted
+ * regions and write-protecting them
+ *
+ * Only the most recent snapshot may be rolled back to.
+ */
+static snapshot_id mprot_take_snapshot()
+{
+	if (mprot_snap->uffd < 0)
+		dirty_tracking_init();
+
+	mprot_snap->lastBackingPage = 0;
+	mprot_snap->savedPages.reset();
+	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++) {
+		struct MemoryRegion *r = &mprot_snap->regionsToSnapShot[region];
+		dirty_tracking_scan(r, PAGE_IS_PRESENT, dirty_tracking_save);
+		dirty_tracking_protect(r->basePtr, r->sizeInPages * sizeof(snapshot_page_t));
+	}
+	mprot_snap->fullRestore = false;
+
+	unsigned int snapshot = mprot_snap->lastSnapShot++;
+	if (snapshot == mprot_snap->maxSnapShots) {
+		model_print("Out of snapshots\n");
+		exit(EXIT_FAILURE);
+	}
+	mprot_snap->snapShots[snapshot].firstBackingPage = 0;
+	return snapshot;
+}
+
+/**
+ * @brief Roll back to the most recent snapshot, restoring only the pages
+ * written since, as collected in a single PAGEMAP_SCAN per region
+ */
+static void mprot_roll_back(snapshot_id theID)
+{
+	ASSERT(theID + 1 == mprot_snap->lastSnapShot);
+	uint64_t start = snapshot_time();
+
+	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++) {
+		struct MemoryRegion *r = &mprot_snap->regionsToSnapShot[region];
+		if (mprot_snap->fullRestore)
+			dirty_tracking_restore(r->basePtr, (char *)r->basePtr + r->sizeInPages * sizeof(snapshot_page_t));
+		else
+			dirty_tracking_scan(r, PAGE_IS_WRITTEN, dirty_tracking_restore);
+	}
+	mprot_snap->fullRestore = false;
+
+	mprot_snap->numRollbacks++;
+	mprot_snap->rollbackTime += snapshot_time() - start;
+}
+
+/**
+ * @brief Resume dirty-page tracking in a forked child
+ *
+ * A child does not inherit our userfaultfd registrations, so we register
+ * afresh; what was written before the fork is unknown, so the next rollback
+ * restores every page.
+ */
+static void mprot_after_fork()
+{
+	dirty_tracking_init();
+	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++) {
+		struct MemoryRegion *r = &mprot_snap->regionsToSnapShot[region];
+		dirty_tracking_protect(r->basePtr, r->sizeInPages * sizeof(snapshot_page_t));
+	}
+	mprot_snap->fullRestore = true;
+}
+
+#elif USE_MPROTECT_SNAPSHOT == 4
+
+/**
+ * @brief Move a region's current contents into a sealed memfd, and map it
+ * back in place as a private (copy-on-write) mapping of that memfd
+ *
+ * Unpopulated pages of anonymous regions are zero, so they are left as holes
+ * in the memfd.
+ */
+static void memfd_capture_region(struct MemoryRegion *region)
+{
+	size_t size = region->sizeInPages * sizeof(snapshot_page_t);
+	int fd = syscall(SYS_memfd_create, "snapshot", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd < 0) {
+		perror("memfd_create");
+		model_print("Snapshot restore by memfd requires memfd_create(); rebuild with USE_MPROTECT_SNAPSHOT=2\n");
+		exit(EXIT_FAILURE);
+	}
+	if (ftruncate(fd, size) < 0) {
+		perror("ftruncate");
+		exit(EXIT_FAILURE);
+	}
+
+	unsigned char *resident = NULL;
+	if (region->anonymous) {
+		resident = (unsigned char *)model_malloc(region->sizeInPages);
+		if (mincore(region->basePtr, size, resident) < 0) {
+			perror("mincore");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (int page = 0; page < region->sizeInPages; page++) {
+		if (resident && !(resident[page] & 1))
+			continue;
+		char *addr = (char *)region->basePtr + page * sizeof(snapshot_page_t);
+		if (pwrite(fd, addr, sizeof(snapshot_page_t), page * sizeof(snapshot_page_t)) != sizeof(snapshot_page_t)) {
+			perror("pwrite");
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (resident)
+		model_free(resident);
+
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL) < 0) {
+		perror("fcntl(F_ADD_SEALS)");
+		exit(EXIT_FAILURE);
+	}
+	if (mmap(region->basePtr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+}
+
+/**
+ * @brief Take a snapshot, by moving every snapshotted region into a sealed
+ * memfd which then backs it copy-on-write
+ *
+ * Only the most recent snapshot may be rolled back to.
+ */
+static snapshot_id mprot_take_snapshot()
+{
+	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++)
+		memfd_capture_region(&mprot_snap->regionsToSnapShot[region]);
+
+	unsigned int snapshot = mprot_snap->lastSnapShot++;
+	if (snapshot == mprot_snap->maxSnapShots) {
+		model_print("Out of snapshots\n");
+		exit(EXIT_FAILURE);
+	}
+	mprot_snap->snapShots[snapshot].firstBackingPage = 0;
+	return snapshot;
+}
+
+/**
+ * @brief Roll back to the most recent snapshot, by dropping every private
+ * copy-on-write page, which re-exposes the sealed contents
+ */
+static void mprot_roll_back(snapshot_id theID)
+{
+	ASSERT(theID + 1 == mprot_snap->lastSnapShot);
+	uint64_t start = snapshot_time();
+
+	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++) {
+		struct MemoryRegion *r = &mprot_snap->regionsToSnapShot[region];
+		if (madvise(r->basePtr, r->sizeInPages * sizeof(snapshot_page_t), MADV_DONTNEED) < 0) {
+			perror("madvise");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	mprot_snap->numRollbacks++;
+	mprot_snap->rollbackTime += snapshot_time() - start;
+}
+
+static void mprot_after_fork()
+{
+	/* The child's private pages are its own; the memfds are shared read-only */
+}
+
+#else /* USE_MPROTECT_SNAPSHOT < 3 */
+
 static snapshot_id mprot_take_snapshot()
 {
 	for (unsigned int region = 0; region < mprot_snap->lastRegion; region++) {
@@ -218,11 +629,15 @@ static snapshot_id mprot_take_snapshot()
 
 static void mprot_roll_back(snapshot_id theID)
 {
+	uint64_t start = snapshot_time();
+	mprot_snap->numRollbacks++;
 #if USE_MPROTECT_SNAPSHOT == 2
 	if (mprot_snap->lastSnapShot == (theID + 1)) {
 		for (unsigned int page = mprot_snap->snapShots[theID].firstBackingPage; page < mprot_snap->lastBackingPage; page++) {
 			memcpy(mprot_snap->backingRecords[page].basePtrOfPage, &mprot_snap->backingStore[page], sizeof(snapshot_page_t));
 		}
+		mprot_snap->numRestoredPages += mprot_snap->lastBackingPage - mprot_snap->snapShots[theID].firstBackingPage;
+		mprot_snap->rollbackTime += snapshot_time() - start;
 		return;
 	}
 #endif
@@ -239,11 +654,32 @@ static void mprot_roll_back(snapshot_id theID)
 		if (!duplicateMap.contains(mprot_snap->backingRecords[page].basePtrOfPage)) {
 			duplicateMap.put(mprot_snap->backingRecords[page].basePtrOfPage, true);
 			memcpy(mprot_snap->backingRecords[page].basePtrOfPage, &mprot_snap->backingStore[page], sizeof(snapshot_page_t));
+			mprot_snap->numRestoredPages++;
 		}
 	}
 	mprot_snap->lastSnapShot = theID;
 	mprot_snap->lastBackingPage = mprot_snap->snapShots[theID].firstBackingPage;
 	mprot_take_snapshot(); //Make sure current snapshot is still good...All later ones are cleared
+	mprot_snap->rollbackTime += snapshot_time() - start;
+}
+
+static void mprot_after_fork()
+{
+	/* Write protection and the backing store are inherited as-is */
+}
+
+#endif /* USE_MPROTECT_SNAPSHOT < 3 */
+
+static void mprot_print_stats()
+{
+	model_print("Snapshot rollbacks: %u\n", mprot_snap->numRollbacks);
+	model_print("Snapshot write faults: %u\n", mprot_snap->numFaults);
+	if (mprot_snap->numRestoredPages || mprot_snap->numZappedPages)
+		model_print("Snapshot pages restored: %" PRIu64 " copied, %" PRIu64 " dropped\n",
+				mprot_snap->numRestoredPages, mprot_snap->numZappedPages);
+	if (mprot_snap->numRollbacks)
+		model_print("Snapshot rollback time: %.2f us/execution\n",
+				mprot_snap->rollbackTime / 1000.0 / mprot_snap->numRollbacks);
 }
 
 #else /* !USE_MPROTECT_SNAPSHOT */
@@ -441,11 +877,15 @@ void snapshot_system_init(unsigned int numbackingpages,
 #endif
 }
 
-/** Assumes that addr is page aligned. */
-void snapshot_add_memory_region(void *addr, unsigned int numPages)
+/**
+ * Assumes that addr is page aligned.
+ * @param anonymous True if the region is private anonymous memory, whose
+ * unpopulated pages read as zero
+ */
+void snapshot_add_memory_region(void *addr, unsigned int numPages, bool anonymous)
 {
 #if USE_MPROTECT_SNAPSHOT
-	mprot_add_to_snapshot(addr, numPages);
+	mprot_add_to_snapshot(addr, numPages, anonymous);
 #else
 	/* not needed for fork-based snapshotting */
 #endif
@@ -474,3 +914,24 @@ void snapshot_roll_back(snapshot_id theID)
 	fork_roll_back(theID);
 #endif
 }
+
+/**
+ * @brief Prepare a forked child to keep using the snapshot
+ *
+ * Must be called in the child after fork()ing a process which continues
+ * model-checking (and rolling back) on its own.
+ */
+void snapshot_after_fork()
+{
+#if USE_MPROTECT_SNAPSHOT
+	mprot_after_fork();
+#endif
+}
+
+/** @brief Print statistics on snapshotting and rollback */
+void snapshot_print_stats()
+{
+#if USE_MPROTECT_SNAPSHOT
+	mprot_print_stats();
+#endif
+}
@@ -9,7 +9,7 @@
 #include "config.h"
 #include "mymemory.h"
 
-void snapshot_add_memory_region(void *ptr, unsigned int numPages);
+void snapshot_add_memory_region(void *ptr, unsigned int numPages, bool anonymous);
 snapshot_id take_snapshot();
 void snapshot_roll_back(snapshot_id theSnapShot);
 
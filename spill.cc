@@ -0,0 +1,209 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+
+#include "spill.h"
+#include "mymemory.h"
+#include "common.h"
+#include "config.h"
+
+/*
+ * The spill file
+ *
+ * With --spill, Nodes and their choice lists and per-thread arrays are
+ * allocated from an mspace laid over a shared mapping of an unlinked temporary
+ * file, rather than from anonymous memory. (Their ModelActions are not: the
+ * current execution keeps looking at earlier actions, so they would only be
+ * faulted straight back in.) Whenever more of the file than the limit is
+ * resident, the NodeStack marks the pages of the Nodes near its head as hot
+ * (spill_mark_hot()), and every other resident page is written back to the
+ * file and dropped from memory (spill_page_out()).
+ * Nothing needs to be read back explicitly: a Node which is needed again --
+ * when replaying a prefix, or when get_next_backtrack() walks back to it --
+ * is simply faulted back in from the file.
+ */
+
+static int spill_fd = -1;
+static char *spill_base;
+static mspace spill_space;
+static size_t spill_limit;
+/** @brief The end of the highest allocation; no page above it is in use */
+static char *spill_top;
+
+/** @brief One mincore() byte per page below spill_top; bit 1 marks hot pages */
+static unsigned char *spill_pages;
+static size_t spill_pages_len;
+
+static struct {
+	uint64_t checks;
+	uint64_t pageouts;
+	uint64_t pages_out;
+	size_t resident;
+} spill_stats;
+
+/**
+ * @brief Start allocating NodeStack memory from a spill file
+ * @param limit The most memory (in bytes) to keep resident
+ * @return True on success; false if the file could not be created, in which
+ * case NodeStack memory stays in model memory
+ */
+bool spill_init(size_t limit)
+{
+	const char *dir = getenv("TMPDIR");
+	char path[256];
+	snprintf(path, sizeof(path), "%s/cdschecker-nodes-XXXXXX", dir ? dir : "/tmp");
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		perror(path);
+		return false;
+	}
+	unlink(path);
+	if (ftruncate(fd, SPILL_FILE_SIZE)) {
+		perror("ftruncate");
+		close(fd);
+		return false;
+	}
+	void *base = mmap(NULL, SPILL_FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+	if (base == MAP_FAILED) {
+		perror("mmap");
+		close(fd);
+		return false;
+	}
+	spill_fd = fd;
+	spill_base = spill_top = (char *)base;
+	spill_space = create_mspace_with_base(base, SPILL_FILE_SIZE, 1);
+	spill_limit = limit;
+	return true;
+}
+
+/** @return True if NodeStack memory comes from the spill file */
+bool spill_enabled()
+{
+	return spill_space != NULL;
+}
+
+/** @brief Allocate NodeStack memory: from the spill file, if spilling */
+void * spill_malloc(size_t size)
+{
+	if (!spill_space)
+		return model_malloc(size);
+	char *p = (char *)mspace_malloc(spill_space, size);
+	if (p && p + size > spill_top)
+		spill_top = p + size;
+	return p;
+}
+
+/** @brief Allocate zeroed NodeStack memory: from the spill file, if spilling */
+void * spill_calloc(size_t count, size_t size)
+{
+	void *p = spill_malloc(count * size);
+	if (p)
+		memset(p, 0, count * size);
+	return p;
+}
+
+/** @brief Free memory from spill_malloc() or spill_calloc() */
+void spill_free(void *ptr)
+{
+	if (spill_space && (char *)ptr >= spill_base && (char *)ptr < spill_base + SPILL_FILE_SIZE)
+		mspace_free(spill_space, ptr);
+	else
+		model_free(ptr);
+}
+
+/**
+ * @brief Check whether more of the spill file is resident than the limit
+ *
+ * If so, the caller should mark its hot memory with spill_mark_hot() and then
+ * call spill_page_out().
+ *
+ * @return True if some memory should be paged out
+ */
+bool spill_over_limit()
+{
+	if (!spill_space)
+		return false;
+	size_t npages = (spill_top - spill_base + PAGESIZE - 1) / PAGESIZE;
+	if (npages > spill_pages_len) {
+		if (spill_pages)
+			model_free(spill_pages);
+		spill_pages_len = npages * 2;
+		spill_pages = (unsigned char *)model_malloc(spill_pages_len);
+	}
+	spill_stats.checks++;
+	if (mincore(spill_base, npages * PAGESIZE, spill_pages)) {
+		perror("mincore");
+		return false;
+	}
+	size_t resident = 0;
+	for (size_t i = 0; i < npages; i++) {
+		spill_pages[i] &= 1;
+		resident += spill_pages[i];
+	}
+	spill_stats.resident = resident * PAGESIZE;
+	return resident * PAGESIZE > spill_limit;
+}
+
+/** @brief Keep the pages holding some memory resident in spill_page_out() */
+void spill_mark_hot(const void *ptr, size_t size)
+{
+	if (!spill_space || (const char *)ptr < spill_base || (const char *)ptr >= spill_top)
+		return;
+	size_t first = ((const char *)ptr - spill_base) / PAGESIZE;
+	size_t last = ((const char *)ptr + size - 1 - spill_base) / PAGESIZE;
+	for (size_t i = first; i <= last; i++)
+		spill_pages[i] |= 2;
+}
+
+/** @brief Write back and drop every resident page not marked hot */
+static void page_out_run(size_t first, size_t end)
+{
+	char *start = spill_base + first * PAGESIZE;
+	size_t len = (end - first) * PAGESIZE;
+	if (msync(start, len, MS_SYNC) || madvise(start, len, MADV_DONTNEED))
+		perror("spill");
+	posix_fadvise(spill_fd, first * PAGESIZE, len, POSIX_FADV_DONTNEED);
+	spill_stats.pages_out += end - first;
+}
+
+/**
+ * @brief Page out the spill file, except for the memory marked hot since the
+ * last spill_over_limit()
+ */
+void spill_page_out()
+{
+	size_t npages = (spill_top - spill_base + PAGESIZE - 1) / PAGESIZE;
+	/* The mspace's own state lives at the base of the file */
+	spill_pages[0] |= 2;
+
+	size_t run = 0;
+	bool in_run = false;
+	for (size_t i = 0; i < npages; i++) {
+		bool cold = spill_pages[i] == 1;
+		if (cold && !in_run) {
+			run = i;
+			in_run = true;
+		} else if (!cold && in_run) {
+			page_out_run(run, i);
+			in_run = false;
+		}
+	}
+	if (in_run)
+		page_out_run(run, npages);
+	spill_stats.pageouts++;
+}
+
+/** @brief Print statistics on the spill file */
+void spill_print_stats()
+{
+	if (!spill_space)
+		return;
+	model_print("Node spill file:   %zu KiB used, %zu KiB resident at last check\n",
+			(size_t)(spill_top - spill_base) >> 10, spill_stats.resident >> 10);
+	model_print("Node spill:        %" PRIu64 " checks, %" PRIu64 " page-outs, %" PRIu64 " KiB paged out\n",
+			spill_stats.checks, spill_stats.pageouts, spill_stats.pages_out * PAGESIZE >> 10);
+}
@@ -0,0 +1,42 @@
+/** @file spill.h
+ *  @brief File-backed memory for the NodeStack, with a bound on how much of
+ *  it stays resident.
+ */
+
+#ifndef __SPILL_H__
+#define __SPILL_H__
+
+#include <stddef.h>
+
+/** SPILLALLOC declares the allocators for a class to allocate memory from
+ *	the spill file, when spilling (see spill_malloc()). */
+#define SPILLALLOC \
+	void * operator new(size_t size) { \
+		return spill_malloc(size); \
+	} \
+	void operator delete(void *p, size_t size) { \
+		spill_free(p); \
+	} \
+	void * operator new[](size_t size) { \
+		return spill_malloc(size); \
+	} \
+	void operator delete[](void *p, size_t size) { \
+		spill_free(p); \
+	} \
+	void * operator new(size_t size, void *p) { /* placement new */ \
+		return p; \
+	}
+
+bool spill_init(size_t limit);
+bool spill_enabled();
+
+void * spill_malloc(size_t size);
+void * spill_calloc(size_t count, size_t size);
+void spill_free(void *ptr);
+
+bool spill_over_limit();
+void spill_mark_hot(const void *ptr, size_t size);
+void spill_page_out();
+void spill_print_stats();
+
+#endif /* __SPILL_H__ */
@@ -0,0 +1,163 @@
+#include "statecache.h"
+#include "common.h"
+#include "config.h"
+
+StateCache::StateCache() :
+	completed(),
+	summaries(),
+	pending(),
+	num_completed(0),
+	num_uncached(0)
+{
+}
+
+StateCache::~StateCache()
+{
+	for (unsigned int i = 0; i < summaries.size(); i++)
+		delete summaries[i];
+	for (unsigned int i = 0; i < pending.size(); i++)
+		delete pending[i].ops;
+}
+
+/**
+ * @brief Record the state reached by the action at a NodeStack index
+ *
+ * On a hit, the operations reached below the completed state also belong
+ * below the states on the current path, so they are added to the summary of
+ * the deepest one.
+ *
+ * @param fingerprint The fingerprint of the state (must be non-zero)
+ * @param index The NodeStack index of the action that reached the state
+ * @return The summary of the operations below the state, if its subtree has
+ * already been explored (so the current execution can stop here); NULL
+ * otherwise
+ */
+const state_summary_t * StateCache::visit(uint64_t fingerprint, int index)
+{
+	/* Replaying a prefix whose states are already recorded */
+	if (!pending.empty() && pending.back().index >= index)
+		return NULL;
+
+	state_summary_t *summary = completed.get(fingerprint);
+	if (summary) {
+		if (!pending.empty())
+			add_ops(&pending.back(), summary);
+		return summary;
+	}
+
+	struct pending_state s = { index, fingerprint, new state_summary_t(), false };
+	pending.push_back(s);
+	return NULL;
+}
+
+/**
+ * @brief Record a newly explored action in the summary of the deepest state
+ * on the current path; the states above it collect it when it completes
+ * @param act The action
+ */
+void StateCache::record(const ModelAction *act)
+{
+	if (pending.empty())
+		return;
+
+	struct state_op op = {
+		act->get_location(), act->get_type(), act->get_mo(), act->get_tid(),
+		act->is_write() ? act->get_write_value() : VALUE_NONE,
+	};
+	/*
+	 * A write after a release fence synchronizes as a release write would,
+	 * and the fence itself may lie in the subtree; err on the side of more
+	 * conflicts
+	 */
+	if (act->is_write() && act->get_last_fence_release() && !act->is_release())
+		op.order = act->is_acquire() ? memory_order_acq_rel : memory_order_release;
+	add_op(&pending.back(), &op);
+}
+
+/**
+ * @brief Note that a Node on the current path was given a new choice by
+ * something other than the backtracking analysis
+ *
+ * The subtrees of the states at or below @a index reached that Node from
+ * below, which a summary cannot replay, so those states are not cached.
+ *
+ * @param index The NodeStack index of the Node
+ */
+void StateCache::touch(int index)
+{
+	for (int i = (int)pending.size() - 1; i >= 0 && pending[i].index >= index; i--)
+		pending[i].touched = true;
+}
+
+/** @brief Add an operation to a pending state's summary, unless present */
+void StateCache::add_op(struct pending_state *state, const struct state_op *op)
+{
+	state_summary_t *ops = state->ops;
+	if (!ops)
+		return;
+	for (unsigned int i = 0; i < ops->size(); i++) {
+		const struct state_op *o = &(*ops)[i];
+		if (o->location == op->location && o->type == op->type &&
+				o->order == op->order && o->tid == op->tid &&
+				o->value == op->value)
+			return;
+	}
+	if (ops->size() >= STATE_SUMMARY_MAX) {
+		delete ops;
+		state->ops = NULL;
+		return;
+	}
+	ops->push_back(*op);
+}
+
+/** @brief Add a summary to a pending state's summary */
+void StateCache::add_ops(struct pending_state *state, const state_summary_t *ops)
+{
+	if (!ops) {
+		/* The states above can't be summarized either */
+		delete state->ops;
+		state->ops = NULL;
+		return;
+	}
+	for (unsigned int i = 0; i < ops->size() && state->ops; i++)
+		add_op(state, &(*ops)[i]);
+}
+
+/**
+ * @brief Note that the model checker diverges at a NodeStack index
+ *
+ * Every execution below the states reached at or after @a index has now been
+ * explored, so they become completed, and their summaries are passed up to
+ * the state above them.
+ *
+ * @param index The NodeStack index of the divergence point
+ */
+void StateCache::diverge(int index)
+{
+	while (!pending.empty() && pending.back().index >= index) {
+		struct pending_state s = pending.back();
+		pending.pop_back();
+		if (!pending.empty())
+			add_ops(&pending.back(), s.ops);
+
+		/* Keep states which a summary can't stand in for out of the
+		 * cache, so that later visits explore them again */
+		if (!s.ops || s.touched) {
+			num_uncached++;
+			delete s.ops;
+		} else if (completed.get(s.fingerprint)) {
+			delete s.ops;
+		} else {
+			completed.put(s.fingerprint, s.ops);
+			summaries.push_back(s.ops);
+			num_completed++;
+		}
+	}
+}
+
+/** @brief Print the cache's statistics */
+void StateCache::print_stats() const
+{
+	model_print("Explored states cached: %u\n", num_completed);
+	model_print("Explored states not cached: %u\n", num_uncached);
+}
@@ -0,0 +1,118 @@
+/** @file statecache.h
+ *  @brief Cache of execution-state fingerprints for pruning converged
+ *  subtrees.
+ */
+
+#ifndef __STATECACHE_H__
+#define __STATECACHE_H__
+
+#include <inttypes.h>
+
+#include "mymemory.h"
+#include "stl-model.h"
+#include "swisstable.h"
+#include "action.h"
+
+/** @brief Mix a 64-bit value (the splitmix64 finalizer) */
+static inline uint64_t state_hash_mix(uint64_t x)
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9ULL;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111ebULL;
+	x ^= x >> 31;
+	return x;
+}
+
+/** @brief Order-sensitively fold the value @a v into the hash @a h */
+static inline uint64_t state_hash_combine(uint64_t h, uint64_t v)
+{
+	return state_hash_mix(h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2)));
+}
+
+/**
+ * @brief A visible operation reached below a cached state: the parts of a
+ * ModelAction which ModelExecution::get_last_conflict() looks at, and the
+ * value of a write, which may be sent to earlier reads as a future value
+ */
+struct state_op {
+	void *location;
+	action_type_t type;
+	memory_order order;
+	thread_id_t tid;
+	/** @brief The value written, for a write */
+	uint64_t value;
+};
+
+/** @brief The distinct visible operations reached below a state */
+typedef ModelVector<struct state_op> state_summary_t;
+
+/**
+ * @brief Remembers which execution states have had their subtrees explored
+ *
+ * A state is identified by a fingerprint (see
+ * ModelExecution::get_state_fingerprint()) taken after each newly-explored
+ * action, and is keyed by the NodeStack index of that action. A state stays
+ * pending while the model checker is still exploring below it; once the
+ * checker diverges at or above its index, every execution below it has been
+ * explored and the fingerprint moves to the set of completed states. An
+ * execution that reaches a completed state can then be cut short, since
+ * continuing would only revisit executions already checked.
+ *
+ * A cut subtree would still have added backtracking points to the Nodes
+ * above it. So, as in stateful DPOR, each completed state keeps a summary of
+ * the visible operations reached anywhere below it, and on a hit the model
+ * checker runs the backtracking analysis for each of them against the
+ * current path (see ModelExecution::backtrack_summary()), sending the
+ * summarized writes' values to the reads on the path as future values too.
+ *
+ * A state whose subtree itself sent a future value to a read above it is
+ * never cached. Nor is a state whose subtree reached more than
+ * STATE_SUMMARY_MAX distinct operations: its summary would be incomplete, so
+ * the state is never marked completed, and a later visit to it is a miss
+ * which explores its subtree again. The same goes for every state above it,
+ * whose summaries would include the incomplete one.
+ */
+class StateCache {
+public:
+	StateCache();
+
+	~StateCache();
+
+	const state_summary_t * visit(uint64_t fingerprint, int index);
+	void record(const ModelAction *act);
+	void touch(int index);
+	void diverge(int index);
+	void print_stats() const;
+
+	MEMALLOC
+private:
+	struct pending_state {
+		int index;
+		uint64_t fingerprint;
+		/** @brief The operations reached below the state so far, or NULL
+		 *  if there were too many to keep (and the state must not be
+		 *  cached) */
+		state_summary_t *ops;
+		/** @brief The state's subtree changed a Node at or above it */
+		bool touched;
+	};
+
+	void add_op(struct pending_state *state, const struct state_op *op);
+	void add_ops(struct pending_state *state, const state_summary_t *ops);
+
+	/** @brief Summaries of the states whose subtrees are fully explored,
+	 *  by fingerprint */
+	SwissTable<uint64_t, state_summary_t *, uint64_t, 0, model_malloc, model_calloc, model_free> completed;
+	/** @brief Every summary in completed, for freeing */
+	ModelVector<state_summary_t *> summaries;
+	/** @brief States on the current path, in NodeStack order */
+	ModelVector<struct pending_state> pending;
+
+	/** @brief Number of states recorded as completed */
+	unsigned int num_completed;
+	/** @brief Number of completed states which could not be cached */
+	unsigned int num_uncached;
+};
+
+#endif /* __STATECACHE_H__ */
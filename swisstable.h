@@ -0,0 +1,353 @@
+/** @file swisstable.h
+ *  @brief Hashtable.  Open-addressing variety with SIMD-probed control bytes.
+ */
+
+#ifndef __SWISSTABLE_H__
+#define __SWISSTABLE_H__
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "mymemory.h"
+#include "common.h"
+#include "config.h"
+#include "hashtable.h"
+
+#ifdef CONFIG_SWISSTABLE_TRACE
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * @brief Append one operation to the trace file named by $SWISSTABLE_TRACE
+ *
+ * Each line is "<op> <table> <key>", in hex, where op is one of n(ew),
+ * d(elete), r(eset), p(ut), g(et), c(ontains) or x (remove), and the key has
+ * already had the table's shift applied. test/hashbench.cc replays these
+ * traces. The file is written without stdio buffering so that the forked
+ * processes of fork-based snapshotting do not duplicate pending output.
+ */
+static inline void swisstable_trace(char op, const void *table, uint64_t key)
+{
+	static int fd = -2;
+	if (fd == -2) {
+		const char *path = getenv("SWISSTABLE_TRACE");
+		fd = path ? open(path, O_WRONLY | O_CREAT | O_APPEND, 0644) : -1;
+	}
+	if (fd < 0)
+		return;
+	char buf[64];
+	int len = snprintf(buf, sizeof(buf), "%c %lx %" PRIx64 "\n", op, (unsigned long)(uintptr_t)table, key);
+	if (write(fd, buf, len) != len)
+		fd = -1;
+}
+#define SWISSTABLE_TRACE(op, key) swisstable_trace(op, this, key)
+#else
+#define SWISSTABLE_TRACE(op, key)
+#endif
+
+/** @brief The number of control bytes examined by one probe */
+#define SWISSTABLE_GROUP 16
+
+/** @brief Control byte of an empty slot; a full slot's has the top bit set */
+#define SWISSTABLE_EMPTY 0
+
+/**
+ * @brief An open-addressing hash table probed a group of slots at a time
+ *
+ * A drop-in alternative to HashTable for hot maps, in the style of Swiss
+ * tables: alongside the slots, each slot has a control byte holding either
+ * SWISSTABLE_EMPTY or the top bit plus 7 bits of the key's hash. A lookup
+ * compares a whole group of control bytes against the hash bits at once
+ * (with SSE2 where available) and only touches the slots that match, so it
+ * can run at a much higher load factor than HashTable.
+ *
+ * Probing is linear, so a key always sits in the first empty slot at or after
+ * its home slot when it was inserted, and removal shifts the following run
+ * of keys back rather than leaving tombstones. The control array has its
+ * first SWISSTABLE_GROUP bytes mirrored past its end, so a group that wraps
+ * around can be loaded with a single unaligned load.
+ *
+ * Unlike HashTable, 0 (NULL) is a valid key.
+ *
+ * @tparam _Key    Type name for the key
+ * @tparam _Val    Type name for the values to be stored
+ * @tparam _KeyInt Integer type that is at least as large as _Key. Used for key
+ *                 manipulation and storage.
+ * @tparam _Shift  Logical shift to apply to all keys before hashing. Default 0.
+ * @tparam _malloc Provide your own 'malloc' for the table, or default to
+ *                 snapshotting.
+ * @tparam _calloc Provide your own 'calloc' for the table, or default to
+ *                 snapshotting.
+ * @tparam _free   Provide your own 'free' for the table, or default to
+ *                 snapshotting.
+ */
+template<typename _Key, typename _Val, typename _KeyInt, int _Shift = 0, void * (* _malloc)(size_t) = snapshot_malloc, void * (* _calloc)(size_t, size_t) = snapshot_calloc, void (*_free)(void *) = snapshot_free>
+class SwissTable {
+ public:
+	/**
+	 * @brief Hash table constructor
+	 * @param initialcapacity Sets the initial capacity of the hash table;
+	 * must be a power of two. Default size 1024.
+	 * @param factor Sets the percentage full before the hashtable is
+	 * resized. Default ratio 0.875.
+	 */
+	SwissTable(unsigned int initialcapacity = 1024, double factor = 0.875) {
+		if (initialcapacity < SWISSTABLE_GROUP)
+			initialcapacity = SWISSTABLE_GROUP;
+		loadfactor = factor;
+		allocate(initialcapacity);
+		SWISSTABLE_TRACE('n', 0);
+	}
+
+	/** @brief Hash table destructor */
+	~SwissTable() {
+		SWISSTABLE_TRACE('d', 0);
+		_free(ctrl);
+		_free(slots);
+	}
+
+	/** Override: new operator */
+	void * operator new(size_t size) {
+		return _malloc(size);
+	}
+
+	/** Override: delete operator */
+	void operator delete(void *p, size_t size) {
+		_free(p);
+	}
+
+	/** Override: new[] operator */
+	void * operator new[](size_t size) {
+		return _malloc(size);
+	}
+
+	/** Override: delete[] operator */
+	void operator delete[](void *p, size_t size) {
+		_free(p);
+	}
+
+	/** @brief Reset the table to its initial state. */
+	void reset() {
+		SWISSTABLE_TRACE('r', 0);
+		memset(ctrl, SWISSTABLE_EMPTY, capacity + SWISSTABLE_GROUP);
+		size = 0;
+	}
+
+	/**
+	 * @brief Put a key/value pair into the table
+	 * @param key The key for the new value
+	 * @param val The value to store in the table
+	 */
+	void put(_Key key, _Val val) {
+		SWISSTABLE_TRACE('p', key_bits(key));
+		uint64_t h = hash(key);
+		int i = find(key, h);
+		if (i >= 0) {
+			slots[i].val = val;
+			return;
+		}
+
+		if (size >= threshold)
+			resize(capacity << 1);
+		i = insert_slot(h);
+		set_ctrl(i, tag(h));
+		slots[i].key = key;
+		slots[i].val = val;
+		size++;
+	}
+
+	/**
+	 * @brief Lookup the corresponding value for the given key
+	 * @param key The key for finding the value
+	 * @return The value in the table, if the key is found; otherwise 0
+	 */
+	_Val get(_Key key) const {
+		SWISSTABLE_TRACE('g', key_bits(key));
+		int i = find(key, hash(key));
+		return i >= 0 ? slots[i].val : (_Val)0;
+	}
+
+	/**
+	 * @brief Check whether the table contains a value for the given key
+	 * @param key The key for finding the value
+	 * @return True, if the key is found; false otherwise
+	 */
+	bool contains(_Key key) const {
+		SWISSTABLE_TRACE('c', key_bits(key));
+		return find(key, hash(key)) >= 0;
+	}
+
+	/**
+	 * @brief Remove a key from the table
+	 *
+	 * The keys in the run after the removed slot are shifted back to fill
+	 * the hole, so no tombstone is left behind.
+	 *
+	 * @param key The key to remove
+	 * @return True, if the key was in the table; false otherwise
+	 */
+	bool remove(_Key key) {
+		SWISSTABLE_TRACE('x', key_bits(key));
+		int i = find(key, hash(key));
+		if (i < 0)
+			return false;
+
+		unsigned int hole = i;
+		unsigned int j = i;
+		while (true) {
+			j = (j + 1) & capacitymask;
+			if (ctrl[j] == SWISSTABLE_EMPTY)
+				break;
+			unsigned int home = (unsigned int)hash(slots[j].key) & capacitymask;
+			/* Leave j alone if its home lies cyclically in (hole, j] */
+			if (hole <= j ? (hole < home && home <= j) : (hole < home || home <= j))
+				continue;
+			slots[hole] = slots[j];
+			set_ctrl(hole, ctrl[j]);
+			hole = j;
+		}
+		set_ctrl(hole, SWISSTABLE_EMPTY);
+		size--;
+		return true;
+	}
+
+	/**
+	 * @brief Resize the table
+	 * @param newsize The new size of the table; must be a power of two
+	 */
+	void resize(unsigned int newsize) {
+		unsigned char *oldctrl = ctrl;
+		struct hashlistnode<_Key, _Val> *oldslots = slots;
+		unsigned int oldcapacity = capacity;
+		unsigned int oldsize = size;
+
+		allocate(newsize);
+		size = oldsize;
+
+		for (unsigned int j = 0; j < oldcapacity; j++) {
+			if (oldctrl[j] == SWISSTABLE_EMPTY)
+				continue;
+			uint64_t h = hash(oldslots[j].key);
+			int i = insert_slot(h);
+			set_ctrl(i, tag(h));
+			slots[i] = oldslots[j];
+		}
+
+		_free(oldctrl);
+		_free(oldslots);
+	}
+
+ private:
+	/** @brief Allocate empty control and slot arrays of a given capacity */
+	void allocate(unsigned int newsize) {
+		ctrl = (unsigned char *)_calloc(newsize + SWISSTABLE_GROUP, 1);
+		slots = (struct hashlistnode<_Key, _Val> *)_malloc(newsize * sizeof(struct hashlistnode<_Key, _Val>));
+		if (!ctrl || !slots) {
+			model_print("calloc error %s %d\n", __FILE__, __LINE__);
+			exit(EXIT_FAILURE);
+		}
+		capacity = newsize;
+		capacitymask = newsize - 1;
+		threshold = (unsigned int)(newsize * loadfactor);
+		if (threshold >= newsize)
+			threshold = newsize - 1;
+		size = 0;
+	}
+
+	static uint64_t key_bits(_Key key) {
+		return (uint64_t)(((_KeyInt)key) >> _Shift);
+	}
+
+	/**
+	 * @brief Hash a key; the low bits pick its home, the top 7 its tag
+	 *
+	 * Like HashTable, the home slot comes straight from the (shifted) key,
+	 * which spreads the model checker's densely allocated pointers with no
+	 * collisions at all; only the tag bits are mixed.
+	 */
+	static uint64_t hash(_Key key) {
+		uint64_t k = key_bits(key);
+		return k ^ ((k * 0x9e3779b97f4a7c15ULL) & (0x7fULL << 57));
+	}
+
+	static unsigned char tag(uint64_t h) {
+		return 0x80 | (unsigned char)(h >> 57);
+	}
+
+	/** @brief Set a slot's control byte, and its mirror past the end */
+	void set_ctrl(unsigned int i, unsigned char c) {
+		ctrl[i] = c;
+		if (i < SWISSTABLE_GROUP)
+			ctrl[capacity + i] = c;
+	}
+
+	/**
+	 * @brief Examine the group of control bytes starting at a slot
+	 * @param pos The first slot of the group
+	 * @param c The control byte to look for
+	 * @param empty Set to the mask of empty slots in the group
+	 * @return The mask of slots in the group whose control byte is @a c
+	 */
+	unsigned int probe_group(unsigned int pos, unsigned char c, unsigned int *empty) const {
+#ifdef __SSE2__
+		__m128i group = _mm_loadu_si128((const __m128i *)(ctrl + pos));
+		*empty = ~_mm_movemask_epi8(group) & 0xffff;
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)c)));
+#else
+		unsigned int match = 0;
+		*empty = 0;
+		for (int k = 0; k < SWISSTABLE_GROUP; k++) {
+			if (ctrl[pos + k] == c)
+				match |= 1u << k;
+			if (ctrl[pos + k] == SWISSTABLE_EMPTY)
+				*empty |= 1u << k;
+		}
+		return match;
+#endif
+	}
+
+	/** @return The slot holding @a key, or -1 if it is not in the table */
+	int find(_Key key, uint64_t h) const {
+		unsigned char t = tag(h);
+		unsigned int pos = (unsigned int)h & capacitymask;
+		while (true) {
+			unsigned int empty;
+			unsigned int match = probe_group(pos, t, &empty);
+			while (match) {
+				unsigned int i = (pos + __builtin_ctz(match)) & capacitymask;
+				if (slots[i].key == key)
+					return i;
+				match &= match - 1;
+			}
+			if (empty)
+				return -1;
+			pos = (pos + SWISSTABLE_GROUP) & capacitymask;
+		}
+	}
+
+	/** @return The first empty slot at or after the home slot of hash @a h */
+	int insert_slot(uint64_t h) const {
+		unsigned int pos = (unsigned int)h & capacitymask;
+		while (true) {
+			unsigned int empty;
+			probe_group(pos, SWISSTABLE_EMPTY, &empty);
+			if (empty)
+				return (pos + __builtin_ctz(empty)) & capacitymask;
+			pos = (pos + SWISSTABLE_GROUP) & capacitymask;
+		}
+	}
+
+	unsigned char *ctrl;
+	struct hashlistnode<_Key, _Val> *slots;
+	unsigned int capacity;
+	unsigned int size;
+	unsigned int capacitymask;
+	unsigned int threshold;
+	double loadfactor;
+};
+
+#endif /* __SWISSTABLE_H__ */
@@ -0,0 +1,130 @@
+/**
+ * @file hashbench.cc
+ * @brief Benchmark: replay a captured hash-table key stream into HashTable
+ * and SwissTable
+ *
+ * Build the model checker with CONFIG_SWISSTABLE_TRACE defined (see config.h)
+ * and run any test with SWISSTABLE_TRACE=<file> in the environment to record
+ * every operation on the checker's internal maps. Then run this program with
+ * the trace file as its argument. Every table in the trace is replayed in
+ * both implementations with the same keys, in the same order, and the time
+ * per operation is printed for each. Snapshot rollbacks are not recorded, so
+ * the replay reproduces the operation stream rather than the exact table
+ * contents.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+#include <map>
+#include <threads.h>
+
+#include "hashtable.h"
+#include "swisstable.h"
+#include "stl-model.h"
+
+struct op {
+	char type;
+	unsigned int table;
+	uint64_t key;
+};
+
+/* The trace is too big for the user heap, so keep it in model memory */
+static ModelVector<struct op> ops;
+static unsigned int num_tables;
+
+static double now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/** @brief Read a trace, giving each table instance its own dense index */
+static bool load_trace(const char *path)
+{
+	FILE *f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return false;
+	}
+
+	std::map<unsigned long, unsigned int> live;
+	char type;
+	unsigned long id;
+	uint64_t key;
+	while (fscanf(f, " %c %lx %" SCNx64, &type, &id, &key) == 3) {
+		if (type == 'n' || !live.count(id))
+			live[id] = num_tables++;
+		struct op o = { type, live[id], key };
+		ops.push_back(o);
+	}
+	fclose(f);
+	return true;
+}
+
+/** @brief Replay the trace into one table implementation */
+template <typename Table>
+static double replay(const char *name)
+{
+	ModelVector<Table *> tables(num_tables, (Table *)NULL);
+	uint64_t checksum = 0;
+	unsigned int count = 0;
+
+	double start = now_ns();
+	for (unsigned int i = 0; i < ops.size(); i++) {
+		const struct op *o = &ops[i];
+		Table *&t = tables[o->table];
+		if (!t)
+			t = new Table();
+		/* HashTable cannot handle 0 as a key */
+		if (o->key == 0 && (o->type == 'p' || o->type == 'g' || o->type == 'c'))
+			continue;
+		count++;
+		switch (o->type) {
+		case 'd':
+			delete t;
+			t = NULL;
+			break;
+		case 'r':
+			t->reset();
+			break;
+		case 'p':
+			t->put(o->key, i + 1);
+			break;
+		case 'g':
+			checksum += t->get(o->key);
+			break;
+		case 'c':
+			checksum += t->contains(o->key);
+			break;
+		default:
+			/* HashTable has no removal; skip it in both */
+			break;
+		}
+	}
+	double elapsed = now_ns() - start;
+
+	for (unsigned int i = 0; i < num_tables; i++)
+		delete tables[i];
+	printf("%-10s %10u ops %8.2f ms %6.2f ns/op (checksum %" PRIx64 ")\n",
+			name, count, elapsed / 1e6, elapsed / count, checksum);
+	return elapsed;
+}
+
+int user_main(int argc, char **argv)
+{
+	if (argc < 2) {
+		printf("Usage: %s <trace file>\n", argv[0]);
+		return 0;
+	}
+	if (!load_trace(argv[1]))
+		return 1;
+	printf("%u operations on %u tables\n", (unsigned int)ops.size(), num_tables);
+
+	double hash = replay< HashTable<uint64_t, uint64_t, uint64_t, 0, model_malloc, model_calloc, model_free> >("HashTable");
+	double swiss = replay< SwissTable<uint64_t, uint64_t, uint64_t, 0, model_malloc, model_calloc, model_free> >("SwissTable");
+	printf("Speedup: %.2fx\n", hash / swiss);
+	return 0;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file longtrace.c
+ * @brief Benchmark: per-action cost over one very long execution
+ *
+ * Two threads each load the same atomic many times without ever
+ * synchronizing, so for every load the model checker has to search the
+ * other thread's (ever-growing) history on that location. Each thread prints
+ * the average cost of its loads over successive chunks; the cost per load
+ * should stay flat as the execution grows. The number of loads per thread
+ * may be given as the program argument (default 50000).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#define CHUNK 10000
+
+atomic_int x;
+int loads = 50000;
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void reader(void *obj)
+{
+	int id = *(int *)obj;
+	double start = now_us();
+	int i;
+
+	for (i = 1; i <= loads; i++) {
+		atomic_load_explicit(&x, memory_order_relaxed);
+		if (i % CHUNK == 0) {
+			double end = now_us();
+			printf("Thread %d: loads %d-%d: %.2f us/load\n",
+					id, i - CHUNK + 1, i, (end - start) / CHUNK);
+			start = end;
+		}
+	}
+}
+
+int user_main(int argc, char **argv)
+{
+	thrd_t t1, t2;
+	int id1 = 1, id2 = 2;
+
+	if (argc > 1)
+		loads = atoi(argv[1]);
+	atomic_init(&x, 0);
+
+	thrd_create(&t1, (thrd_start_t)&reader, &id1);
+	thrd_create(&t2, (thrd_start_t)&reader, &id2);
+
+	thrd_join(t1);
+	thrd_join(t2);
+
+	return 0;
+}
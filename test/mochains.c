@@ -0,0 +1,80 @@
+/**
+ * @file mochains.c
+ * @brief Benchmark: modification-order bookkeeping over long per-location
+ * histories
+ *
+ * A scaled-up version of the mo-satcycle pattern: two threads repeatedly
+ * store to the same pair of atomics while a third repeatedly reads both, so
+ * each location's modification-order graph grows long per-thread chains
+ * joined by coherence edges. The writers print the average cost of their
+ * stores over successive chunks, which shows how the cost grows with the
+ * chains. Run it with -x 1 to time just the first execution. The number of
+ * iterations per thread may be given as the program argument (default 500).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#define CHUNK 100
+
+atomic_int x, y;
+int iterations = 500;
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void writer(void *obj)
+{
+	int id = *(int *)obj;
+	double start = now_us();
+	int i;
+
+	for (i = 1; i <= iterations; i++) {
+		atomic_store_explicit(&y, i, memory_order_relaxed);
+		atomic_store_explicit(&x, i, memory_order_release);
+		if (i % CHUNK == 0) {
+			double end = now_us();
+			printf("Thread %d: iterations %d-%d: %.2f us/store\n",
+					id, i - CHUNK + 1, i, (end - start) / (2 * CHUNK));
+			start = end;
+		}
+	}
+}
+
+static void reader(void *obj)
+{
+	int i;
+
+	for (i = 0; i < iterations; i++) {
+		atomic_load_explicit(&x, memory_order_acquire);
+		atomic_load_explicit(&y, memory_order_relaxed);
+	}
+}
+
+int user_main(int argc, char **argv)
+{
+	thrd_t t1, t2, t3;
+	int id1 = 1, id2 = 2;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	atomic_init(&x, 0);
+	atomic_init(&y, 0);
+
+	thrd_create(&t1, (thrd_start_t)&writer, &id1);
+	thrd_create(&t2, (thrd_start_t)&writer, &id2);
+	thrd_create(&t3, (thrd_start_t)&reader, NULL);
+
+	thrd_join(t1);
+	thrd_join(t2);
+	thrd_join(t3);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file pagetouch.c
+ * @brief Snapshot benchmark: every execution writes a different set of pages
+ *
+ * Each value the reader may observe selects a different window of a large
+ * buffer to write, so over the whole run many pages are dirtied, but each
+ * execution dirties only a few of them. Run with -v to print the snapshot
+ * statistics (faults and rollback time per execution), and compare builds
+ * using different USE_MPROTECT_SNAPSHOT backends.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#define PAGE 4096
+#define WINDOWS 16
+#define WINDOW_PAGES 32
+
+atomic_int x;
+char *buf;
+
+static void writer(void *obj)
+{
+	int i;
+	for (i = 1; i < WINDOWS; i++)
+		atomic_store_explicit(&x, i, memory_order_relaxed);
+}
+
+static void reader(void *obj)
+{
+	int r = atomic_load_explicit(&x, memory_order_relaxed);
+	memset(buf + (size_t)r * WINDOW_PAGES * PAGE, r, WINDOW_PAGES * PAGE);
+}
+
+int user_main(int argc, char **argv)
+{
+	thrd_t t1, t2;
+
+	buf = malloc((size_t)WINDOWS * WINDOW_PAGES * PAGE);
+	atomic_init(&x, 0);
+
+	thrd_create(&t1, (thrd_start_t)&writer, NULL);
+	thrd_create(&t2, (thrd_start_t)&reader, NULL);
+
+	thrd_join(t1);
+	thrd_join(t2);
+
+	return 0;
+}
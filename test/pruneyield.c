@@ -0,0 +1,53 @@
+/**
+ * @file pruneyield.c
+ * @brief A yield between two loads, for checking state pruning (-P)
+ *
+ * The thread which yields is at a different point in its program before the
+ * yield than after it, even though the yield changes no shared state, so -P
+ * must not treat the two states as the same one. Each complete execution
+ * prints its outcome, and a run with -P must print the same set of outcomes
+ * as a run without it (see test/regress.sh).
+ */
+
+#include <stdio.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+atomic_int x;
+
+static int r0[2];
+static int r1[2];
+
+static void a(void *obj)
+{
+	r0[0] = atomic_fetch_add_explicit(&x, 1, memory_order_seq_cst);
+	r0[1] = atomic_fetch_add_explicit(&x, 1, memory_order_acq_rel);
+	atomic_store_explicit(&x, 3, memory_order_seq_cst);
+}
+
+static void b(void *obj)
+{
+	atomic_store_explicit(&x, 2, memory_order_release);
+	r1[0] = atomic_load_explicit(&x, memory_order_seq_cst);
+	atomic_thread_fence(memory_order_seq_cst);
+	thrd_yield();
+	r1[1] = atomic_load_explicit(&x, memory_order_relaxed);
+}
+
+int user_main(int argc, char **argv)
+{
+	thrd_t t1, t2;
+
+	atomic_init(&x, 0);
+
+	thrd_create(&t1, (thrd_start_t)&a, NULL);
+	thrd_create(&t2, (thrd_start_t)&b, NULL);
+
+	thrd_join(t1);
+	thrd_join(t2);
+
+	printf("Outcome: r0=%d,%d r1=%d,%d x=%d\n", r0[0], r0[1], r1[0], r1[1],
+			atomic_load_explicit(&x, memory_order_relaxed));
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file racebench.c
+ * @brief Benchmark: race-check cost and shadow record expansion
+ *
+ * The main thread spawns many short-lived threads, one at a time, and each
+ * of them writes and then reads back a shared buffer through librace. The
+ * threads are joined in turn, so none of the accesses race. Once thread IDs
+ * pass the limit of the compact 64-bit shadow encoding, every shadow word
+ * they touch has to be expanded into a separately allocated record; with
+ * WIDE_SHADOW=1 (see config.h) they still fit inline. The main thread prints
+ * the average cost of the checks for successive groups of threads; run with
+ * -v -x 1 to also see the number of expanded records. The number of threads
+ * may be given as the program argument (default 320).
+ *
+ * Finally, the main thread checks a bulk write to a larger buffer, once a
+ * word at a time with store_64() and once with a single store_range(), and
+ * prints the cost per byte of each. All of the accesses are aligned words,
+ * so with ADAPTIVE_SHADOW the shadow tables never need byte granularity.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <threads.h>
+
+#include "librace.h"
+
+#define BUFWORDS 64
+#define GROUP 64
+#define BULKBYTES (1 << 18)
+
+static uint32_t buf[BUFWORDS];
+static uint64_t bulk[BULKBYTES / 8];
+int num_threads = 320;
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static double check_time;
+
+static void worker(void *obj)
+{
+	uint32_t id = *(int *)obj;
+	double start = now_us();
+	int i;
+
+	for (i = 0; i < BUFWORDS; i++)
+		store_32(&buf[i], id);
+	for (i = 0; i < BUFWORDS; i++)
+		load_32(&buf[i]);
+	check_time += now_us() - start;
+}
+
+int user_main(int argc, char **argv)
+{
+	int i;
+
+	if (argc > 1)
+		num_threads = atoi(argv[1]);
+
+	for (i = 1; i <= num_threads; i++) {
+		thrd_t t;
+		thrd_create(&t, (thrd_start_t)&worker, &i);
+		thrd_join(t);
+		if (i % GROUP == 0) {
+			/* 4 byte-sized checks per access, one store and one load per word */
+			printf("Threads %d-%d: %.3f us/check\n", i - GROUP + 1, i,
+					check_time / (GROUP * BUFWORDS * 2 * 4));
+			check_time = 0;
+		}
+	}
+
+	double start = now_us();
+	for (i = 0; i < BULKBYTES / 8; i++)
+		store_64(&bulk[i], 0);
+	double mid = now_us();
+	store_range(bulk, BULKBYTES);
+	double end = now_us();
+	printf("Bulk write: store_64 %.4f us/byte, store_range %.4f us/byte\n",
+			(mid - start) / BULKBYTES, (end - mid) / BULKBYTES);
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file rangerace.c
+ * @brief A data race between a bulk copy and a single load
+ *
+ * One thread copies into a buffer, checking the copy with store_range(),
+ * while another loads one word from the middle of the buffer with no
+ * synchronization, so the model checker should report a data race. A third
+ * thread only reads the buffer with load_range(), which does not race with
+ * the load.
+ *
+ * Given the argument "word", two threads instead race on one 8-byte store
+ * each. One of them first loads a flag, which it may read from a store that
+ * the other thread has yet to make, so the race may be found before the
+ * execution is known to be feasible and only asserted later. Either way it
+ * must be reported once, at the address of the word (which is printed
+ * first), not once per byte; test/regress.sh checks this.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+#include "librace.h"
+
+#define WORDS 1024
+
+static uint32_t src[WORDS];
+static uint32_t buf[WORDS];
+static uint64_t word;
+static atomic_int flag;
+
+static void copier(void *obj)
+{
+	store_range(buf, sizeof(buf));
+	memcpy(buf, src, sizeof(buf));
+}
+
+static void loader(void *obj)
+{
+	printf("buf[%d] = %u\n", WORDS / 2, load_32(&buf[WORDS / 2]));
+}
+
+static void scanner(void *obj)
+{
+	load_range(buf, sizeof(buf));
+}
+
+static void word_reader_writer(void *obj)
+{
+	atomic_load_explicit(&flag, memory_order_acquire);
+	store_64(&word, 1);
+}
+
+static void flag_writer(void *obj)
+{
+	atomic_store_explicit(&flag, 1, memory_order_relaxed);
+}
+
+static void word_writer(void *obj)
+{
+	store_64(&word, 2);
+	atomic_store_explicit(&flag, 1, memory_order_relaxed);
+}
+
+int user_main(int argc, char **argv)
+{
+	thrd_t t1, t2, t3;
+	int i;
+
+	if (argc > 1 && !strcmp(argv[1], "word")) {
+		printf("word @ %p\n", (void *)&word);
+		atomic_init(&flag, 0);
+		thrd_create(&t1, (thrd_start_t)&word_reader_writer, NULL);
+		thrd_create(&t2, (thrd_start_t)&flag_writer, NULL);
+		thrd_create(&t3, (thrd_start_t)&word_writer, NULL);
+		thrd_join(t1);
+		thrd_join(t2);
+		thrd_join(t3);
+		return 0;
+	}
+
+	for (i = 0; i < WORDS; i++)
+		src[i] = i;
+
+	thrd_create(&t1, (thrd_start_t)&copier, NULL);
+	thrd_create(&t2, (thrd_start_t)&loader, NULL);
+	thrd_create(&t3, (thrd_start_t)&scanner, NULL);
+
+	thrd_join(t1);
+	thrd_join(t2);
+	thrd_join(t3);
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Regression checks which compare the model checker's output between runs,
+# rather than a single run's statistics. Run from the top-level directory:
+#
+#   make && test/regress.sh
+#
+# Prints one line per check and exits non-zero if any of them fails.
+
+export LD_LIBRARY_PATH=.
+status=0
+
+check() {
+	if [ "$2" = "$3" ]; then
+		echo "PASS $1"
+	else
+		echo "FAIL $1: expected '$2', got '$3'"
+		status=1
+	fi
+}
+
+# State pruning (-P) must not lose any outcome of a full run
+outcomes() {
+	$1 -v $2 2>&1 | grep '^Outcome:' | sort -u
+}
+for t in test/pruneyield.o; do
+	check "$t -P outcomes" "$(outcomes $t)" "$(outcomes $t -P)"
+done
+
+# A race on a multi-byte access is reported once, at the access's address,
+# even when it is only asserted once the execution is known to be feasible
+out=$(test/rangerace.o -- word 2>&1)
+addr=$(echo "$out" | sed -n 's/^word @ //p' | head -n 1)
+check "test/rangerace.o word race reports" "Bug report: 1 bug detected" \
+	"$(echo "$out" | grep '^Bug report' | sort -u)"
+check "test/rangerace.o word race address" "$addr" \
+	"$(echo "$out" | sed -n 's/.*Data race detected @ address \([^:]*\):.*/\1/p' | sort -u)"
+
+exit $status
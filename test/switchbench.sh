@@ -0,0 +1,25 @@
+#!/bin/sh
+#
+# Benchmark: count the context switches between the model checker and its
+# user threads over the litmus tests, and their rate.
+#
+# Run from the top-level directory, once with each context switch built in:
+#
+#   make clean && make && test/switchbench.sh
+#   make clean && make CXX="g++ -DFAST_CONTEXT_SWITCH=0" && test/switchbench.sh
+#
+# The rate is over the whole run (snapshotting included), so compare it
+# between the two builds rather than reading it as the cost of one switch.
+
+ROUNDS=${ROUNDS:-20}
+
+export LD_LIBRARY_PATH=.
+for t in test/litmus/*.o; do
+	i=0
+	while [ $i -lt $ROUNDS ]; do
+		$t -v
+		i=$((i + 1))
+	done 2>&1 | awk -v test=$t '
+		/^Context switches:/ { r = substr($4, 2); n += $3; if (r > 0) s += $3 / r }
+		END { printf "%-32s %10d switches %12.0f per second\n", test, n, (s > 0 ? n / s : 0) }'
+done
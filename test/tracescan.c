@@ -0,0 +1,59 @@
+/**
+ * @file tracescan.c
+ * @brief Benchmark: backward scans of a long action trace
+ *
+ * The main thread issues a release fence and then a long run of relaxed
+ * stores. For each store the model checker looks for fence-related conflicts,
+ * which starts by finding the thread's last fence-release in the action trace,
+ * so without help from the trace's layout the checks cost time quadratic in
+ * the number of stores. A second thread then issues relaxed loads and a final
+ * acquire fence, whose processing scans back over the loads. The main thread
+ * prints the average cost of each store; the number of stores may be given as
+ * the program argument (default 20000). Run with -x 1.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <threads.h>
+#include <stdatomic.h>
+
+atomic_int x;
+int num_stores = 20000;
+
+static double now_us(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void reader(void *obj)
+{
+	int i;
+	for (i = 0; i < num_stores / 16; i++)
+		atomic_load_explicit(&x, memory_order_relaxed);
+	atomic_thread_fence(memory_order_acquire);
+}
+
+int user_main(int argc, char **argv)
+{
+	thrd_t t;
+	int i;
+
+	if (argc > 1)
+		num_stores = atoi(argv[1]);
+
+	atomic_init(&x, 0);
+	atomic_thread_fence(memory_order_release);
+
+	double start = now_us();
+	for (i = 0; i < num_stores; i++)
+		atomic_store_explicit(&x, i, memory_order_relaxed);
+	printf("Stores: %.3f us/store\n", (now_us() - start) / num_stores);
+
+	thrd_create(&t, (thrd_start_t)&reader, NULL);
+	thrd_join(t);
+
+	return 0;
+}
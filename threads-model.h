@@ -45,8 +45,9 @@ public:
 	~Thread();
 	void complete();
 
-	static int swap(ucontext_t *ctxt, Thread *t);
-	static int swap(Thread *t, ucontext_t *ctxt);
+	static int swap(model_context_t *ctxt, Thread *t);
+	static int swap(Thread *t, model_context_t *ctxt);
+	static void print_swap_stats(double seconds);
 
 	thread_state get_state() const { return state; }
 	void set_state(thread_state s);
@@ -132,7 +133,7 @@ private:
 
 	void (*start_routine)(void *);
 	void *arg;
-	ucontext_t context;
+	model_context_t context;
 	void *stack;
 	thrd_t *user_thread;
 	thread_id_t id;
@@ -3,6 +3,7 @@
  */
 
 #include <string.h>
+#include <inttypes.h>
 
 #include <threads.h>
 #include <mutex>
@@ -13,16 +14,21 @@
 /* global "model" object */
 #include "model.h"
 
-/** Allocate a stack for a new thread. */
-static void * stack_allocate(size_t size)
+/**
+ * Allocate a stack for a new thread: its stack from the stack pool, if its
+ * ID has one.
+ */
+static void * stack_allocate(thread_id_t tid, size_t size)
 {
-	return Thread_malloc(size);
+	void *stack = stack_pool_get(id_to_int(tid));
+	return stack ? stack : Thread_malloc(size);
 }
 
-/** Free a stack for a terminated thread. */
+/** Free a stack for a terminated thread. Pooled stacks are kept. */
 static void stack_free(void *stack)
 {
-	Thread_free(stack);
+	if (!stack_pool_contains(stack))
+		Thread_free(stack);
 }
 
 /**
@@ -59,28 +65,19 @@ void thread_startup()
 
 /**
  * Create a thread context for a new thread so we can use
- * setcontext/getcontext/swapcontext to swap it out.
+ * model_switchcontext() to swap it out.
  * @return 0 on success; otherwise, non-zero error condition
  */
 int Thread::create_context()
 {
-	int ret;
-
-	ret = getcontext(&context);
-	if (ret)
-		return ret;
-
 	/* Initialize new managed context */
-	stack = stack_allocate(STACK_SIZE);
-	context.uc_stack.ss_sp = stack;
-	context.uc_stack.ss_size = STACK_SIZE;
-	context.uc_stack.ss_flags = 0;
-	context.uc_link = model->get_system_context();
-	makecontext(&context, thread_startup, 0);
-
-	return 0;
+	stack = stack_allocate(id, STACK_SIZE);
+	return model_makecontext(&context, stack, STACK_SIZE, thread_startup, model->get_system_context());
 }
 
+/** @brief The number of context switches between threads, in all executions */
+static uint64_t num_swaps;
+
 /**
  * Swaps the current context to another thread of execution. This form switches
  * from a user Thread to a system context.
@@ -88,12 +85,13 @@ int Thread::create_context()
  * context is saved here.
  * @param ctxt Context to which we will swap. Must hold a valid system context.
  * @return Does not return, unless we return to Thread t's context. See
- * swapcontext(3) (returns 0 for success, -1 for failure).
+ * model_switchcontext() (returns 0 for success, -1 for failure).
  */
-int Thread::swap(Thread *t, ucontext_t *ctxt)
+int Thread::swap(Thread *t, model_context_t *ctxt)
 {
 	t->set_state(THREAD_READY);
-	return model_swapcontext(&t->context, ctxt);
+	num_swaps++;
+	return model_switchcontext(&t->context, ctxt);
 }
 
 /**
@@ -102,12 +100,24 @@ int Thread::swap(Thread *t, ucontext_t *ctxt)
  * @param ctxt System context variable to which to save the current context.
  * @param t Thread to which we will swap. Must hold a valid user context.
  * @return Does not return, unless we return to the system context (ctxt). See
- * swapcontext(3) (returns 0 for success, -1 for failure).
+ * model_switchcontext() (returns 0 for success, -1 for failure).
  */
-int Thread::swap(ucontext_t *ctxt, Thread *t)
+int Thread::swap(model_context_t *ctxt, Thread *t)
 {
 	t->set_state(THREAD_RUNNING);
-	return model_swapcontext(ctxt, &t->context);
+	num_swaps++;
+	return model_switchcontext(ctxt, &t->context);
+}
+
+/**
+ * @brief Print the number of context switches and their rate
+ * @param seconds The time spent model checking
+ */
+void Thread::print_swap_stats(double seconds)
+{
+	model_print("Context switches:  %" PRIu64 " (%.0f per second, %s)\n", num_swaps,
+			seconds > 0 ? num_swaps / seconds : 0.0,
+			FAST_CONTEXT_SWITCH ? "hand-written" : "swapcontext");
 }
 
 
@@ -2,6 +2,8 @@
 #define TRACE_ANALYSIS_H
 #include "model.h"
 
+class CheckpointWriter;
+class CheckpointReader;
 
 class TraceAnalysis {
  public:
@@ -45,6 +47,16 @@ class TraceAnalysis {
 	 * restart the model checker. */
 	virtual void actionAtModelCheckingFinish() {}
 
+	/** This method is called when the model checker writes a checkpoint
+	 * (see --checkpoint). It should write whatever state the analysis
+	 * keeps across executions, and return false if the analysis cannot
+	 * be checkpointed, which turns checkpointing off. */
+	virtual bool checkpoint(CheckpointWriter *writer) { return false; }
+
+	/** This method is called before the first execution of a run resumed
+	 * from a checkpoint, to read back the state written by checkpoint. */
+	virtual void resume(CheckpointReader *reader) {}
+
 	SNAPSHOTALLOC
 };
 #endif
@@ -0,0 +1,209 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "tracewriter.h"
+#include "action.h"
+#include "common.h"
+#include "config.h"
+#include "execution.h"
+#include "threads-model.h"
+
+/** @brief Number of action types in the string table */
+#define TRACE_NUM_TYPES (ATOMIC_ANNOTATION + 1)
+/** @brief Number of memory orders in the string table */
+#define TRACE_NUM_ORDERS (std::memory_order_seq_cst + 1)
+
+/** @brief Append an unsigned LEB128 varint to a buffer */
+static void put_varint(ModelVector<uint8_t> *buf, uint64_t value)
+{
+	while (value >= 0x80) {
+		buf->push_back((uint8_t)value | 0x80);
+		value >>= 7;
+	}
+	buf->push_back((uint8_t)value);
+}
+
+/** @brief Append a string table entry to a buffer */
+static void put_string(ModelVector<uint8_t> *buf, const char *str)
+{
+	size_t len = strlen(str);
+	put_varint(buf, len);
+	buf->insert(buf->end(), str, str + len);
+}
+
+/** @brief Round a size up to the alignment of a frame's length field */
+static uint64_t frame_align(uint64_t size)
+{
+	return (size + sizeof(uint32_t) - 1) & ~(uint64_t)(sizeof(uint32_t) - 1);
+}
+
+/**
+ * @brief Create the trace file and write its header and string table
+ * @param filename The file to create (or truncate)
+ */
+TraceWriter::TraceWriter(const char *filename) :
+	fd(open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644)),
+	map(NULL),
+	allocated(0),
+	head(),
+	body(),
+	locations(),
+	location_ids(64)
+{
+	if (fd < 0) {
+		perror(filename);
+		exit(EXIT_FAILURE);
+	}
+	map = (char *)mmap(NULL, TRACE_MAX_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, fd, 0);
+	if (map == MAP_FAILED) {
+		perror("mmap");
+		exit(EXIT_FAILURE);
+	}
+
+	put_varint(&head, TRACE_NUM_TYPES + TRACE_NUM_ORDERS);
+	for (int i = 0; i < TRACE_NUM_TYPES; i++)
+		put_string(&head, ModelAction::get_type_str((action_type)i));
+	for (int i = 0; i < TRACE_NUM_ORDERS; i++)
+		put_string(&head, ModelAction::get_mo_str((memory_order)i));
+
+	uint64_t frames = frame_align(sizeof(struct trace_file_header) + head.size());
+	if (!extend(frames)) {
+		model_print("Cannot allocate trace file %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	struct trace_file_header *header = (struct trace_file_header *)map;
+	memcpy(header->magic, TRACE_MAGIC, sizeof(header->magic));
+	header->version = TRACE_VERSION;
+	header->frames = frames;
+	header->tail = frames;
+	memcpy(map + sizeof(*header), &head[0], head.size());
+}
+
+/**
+ * @brief Trim the preallocated space off the end of the trace file
+ *
+ * Only the process which created the writer gets here; forked workers exit
+ * without destroying the model checker, but they may have extended the file.
+ */
+TraceWriter::~TraceWriter()
+{
+	struct trace_file_header *header = (struct trace_file_header *)map;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && header->tail < (uint64_t)st.st_size &&
+			ftruncate(fd, header->tail))
+		perror("ftruncate");
+	munmap(map, TRACE_MAX_SIZE);
+	close(fd);
+}
+
+/**
+ * @brief Make sure the file is allocated up to a given offset
+ *
+ * The file only ever grows: posix_fallocate() never shrinks it, even if a
+ * process with a stale idea of its size races with another one.
+ *
+ * @param end The offset
+ * @return False if the file could not be extended
+ */
+bool TraceWriter::extend(uint64_t end)
+{
+	if (end <= allocated)
+		return true;
+	if (end > TRACE_MAX_SIZE)
+		return false;
+	uint64_t size = (end + TRACE_GROW_SIZE - 1) / TRACE_GROW_SIZE * TRACE_GROW_SIZE;
+	if (size > TRACE_MAX_SIZE)
+		size = TRACE_MAX_SIZE;
+	if (posix_fallocate(fd, allocated, size - allocated))
+		return false;
+	allocated = size;
+	return true;
+}
+
+/** @return The index of a location in the current frame, 0 for none */
+unsigned int TraceWriter::location_id(const void *location)
+{
+	if (!location)
+		return 0;
+	unsigned int id = location_ids.get(location);
+	if (!id) {
+		locations.push_back(location);
+		id = locations.size();
+		location_ids.put(location, id);
+	}
+	return id;
+}
+
+/**
+ * @brief Append a frame for a finished execution to the trace
+ * @param number The execution number
+ * @param execution The execution, which must not have been reset yet
+ */
+void TraceWriter::write_execution(int number, ModelExecution *execution)
+{
+	enum trace_status status;
+	if (!execution->isfeasibleprefix())
+		status = TRACE_INFEASIBLE;
+	else if (execution->have_bug_reports())
+		status = TRACE_BUGGY;
+	else if (execution->is_complete_execution())
+		status = TRACE_COMPLETE;
+	else
+		status = TRACE_REDUNDANT;
+
+	head.clear();
+	body.clear();
+	locations.clear();
+	location_ids.reset();
+
+	const action_list_t *trace = execution->get_action_trace();
+	put_varint(&body, trace->size());
+	for (action_list_t::const_iterator it = trace->begin(); it != trace->end(); it++) {
+		const ModelAction *act = *it;
+		const ModelAction *rf = act->is_read() ? act->get_reads_from() : NULL;
+		put_varint(&body, act->get_seq_number());
+		put_varint(&body, id_to_int(act->get_tid()));
+		put_varint(&body, act->get_type());
+		put_varint(&body, TRACE_NUM_TYPES + act->get_mo());
+		put_varint(&body, location_id(act->get_location()));
+		put_varint(&body, act->get_return_value());
+		put_varint(&body, rf ? rf->get_seq_number() + 1 : 0);
+	}
+
+	put_varint(&head, getpid());
+	put_varint(&head, number);
+	put_varint(&head, status);
+	put_varint(&head, locations.size());
+	for (unsigned int i = 0; i < locations.size(); i++)
+		put_varint(&head, (uintptr_t)locations[i]);
+
+	uint32_t length = head.size() + body.size();
+	uint64_t size = frame_align(sizeof(length) + length);
+	struct trace_file_header *header = (struct trace_file_header *)map;
+	uint64_t offset = __sync_fetch_and_add(&header->tail, size);
+	if (!extend(offset + size)) {
+		static bool warned = false;
+		if (!warned)
+			model_print("Trace file is full; dropping the remaining executions\n");
+		warned = true;
+		return;
+	}
+
+	char *frame = map + offset;
+	memcpy(frame + sizeof(length), &head[0], head.size());
+	memcpy(frame + sizeof(length) + head.size(), &body[0], body.size());
+	/* Publish the frame only once its payload is in place */
+	__atomic_store_n((uint32_t *)frame, length, __ATOMIC_RELEASE);
+}
+
+/** @brief Print the size of the trace written so far */
+void TraceWriter::print_stats() const
+{
+	const struct trace_file_header *header = (const struct trace_file_header *)map;
+	model_print("Trace file: %" PRIu64 " bytes\n", header->tail);
+}
@@ -0,0 +1,98 @@
+/** @file tracewriter.h
+ *  @brief Binary trace of every explored execution.
+ */
+
+#ifndef __TRACEWRITER_H__
+#define __TRACEWRITER_H__
+
+#include <inttypes.h>
+
+#include "mymemory.h"
+#include "stl-model.h"
+#include "swisstable.h"
+
+class ModelExecution;
+
+/** @brief The first eight bytes of a trace file */
+#define TRACE_MAGIC "C11TRACE"
+#define TRACE_VERSION 1
+
+/**
+ * @brief The fixed header at the start of a trace file
+ *
+ * The header is followed by the string table (a varint count, then each
+ * string as a varint length and its bytes) and then, from offset frames, by
+ * one frame per execution, up to offset tail.
+ */
+struct trace_file_header {
+	char magic[8];
+	uint32_t version;
+	/** @brief Offset of the first frame */
+	uint32_t frames;
+	/** @brief Offset of the end of the last frame reserved so far */
+	uint64_t tail;
+};
+
+/** @brief How an execution ended, as recorded in its trace frame */
+enum trace_status {
+	TRACE_COMPLETE,
+	TRACE_BUGGY,
+	TRACE_REDUNDANT,
+	TRACE_INFEASIBLE
+};
+
+/**
+ * @brief Appends a compact binary record of each execution to a file
+ *
+ * The file is mapped shared and written through the mapping, so the
+ * checker never makes a write() call: the kernel writes the pages back in
+ * the background, and everything already copied in survives a crash of the
+ * checker. Each frame is a 32-bit payload length followed by the payload,
+ * padded to a multiple of four bytes:
+ *
+ *   process ID, execution number, trace_status, number of locations,
+ *   the address of each location, number of actions,
+ *   and per action: seq, tid, type, order, location, value, rf
+ *
+ * where every field is an unsigned LEB128 varint. An action's type and order
+ * are indexes into the string table: the action types come first (in
+ * action_type order) and then the memory orders. Its location is an index
+ * into the frame's table of locations, or 0 if it has none (so the table
+ * starts at 1), and rf is 1 + the sequence number of the write it reads
+ * from, or 0 if it is not a read or reads from a promise.
+ *
+ * A frame's space is reserved by atomically advancing the header's tail, so
+ * the forked workers of a parallel exploration, which inherit the mapping,
+ * can all append to the same file; each of them numbers its executions
+ * separately, hence the process ID in each frame. The length is stored last: a reader stops
+ * at a zero length, which marks a frame whose writer did not finish.
+ */
+class TraceWriter {
+public:
+	TraceWriter(const char *filename);
+	~TraceWriter();
+
+	void write_execution(int number, ModelExecution *execution);
+	void print_stats() const;
+
+	MEMALLOC
+private:
+	bool extend(uint64_t end);
+	unsigned int location_id(const void *location);
+
+	int fd;
+	/** @brief The mapping of the whole file, starting with the header */
+	char *map;
+	/** @brief The file size this process knows to be allocated */
+	uint64_t allocated;
+
+	/** @brief The frame being encoded, up to its table of locations */
+	ModelVector<uint8_t> head;
+	/** @brief The actions of the frame being encoded */
+	ModelVector<uint8_t> body;
+	/** @brief The locations seen by the frame being encoded */
+	ModelVector<const void *> locations;
+	SwissTable<const void *, unsigned int, uintptr_t, 4, model_malloc, model_calloc, model_free> location_ids;
+};
+
+#endif /* __TRACEWRITER_H__ */